@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+namespace coldwind {
+	// operator new calls of all threads since startup, debug builds replace the global operators
+	// to count them, release builds always return 0
+	[[nodiscard]] uint64_t getHeapAllocationCount() noexcept;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace coldwind {
+	// w is unused, vec4 keeps both corners 16 byte aligned for SIMD loads
+	struct Aabb {
+		glm::vec4 min = glm::vec4(0.0f);
+		glm::vec4 max = glm::vec4(0.0f);
+
+		[[nodiscard]] glm::vec4 getCenter() const noexcept { return (min + max) * 0.5f; }
+		[[nodiscard]] glm::vec4 getExtent() const noexcept { return (max - min) * 0.5f; }
+	};
+}
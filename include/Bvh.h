@@ -0,0 +1,115 @@
+#pragma once
+#include "Bounds.h"
+#include "JobSystem.h"
+
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace coldwind {
+	struct Frustum {
+		// xyz is the inward facing normal, w the distance, inside when dot(n, p) + w >= 0
+		glm::vec4 planes[6];
+
+		[[nodiscard]] static Frustum fromViewProjection(const glm::mat4& viewProjection) noexcept;
+	};
+
+	struct Ray {
+		glm::vec3 origin = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	};
+
+	struct RayHit {
+		uint32_t object = UINT32_MAX;
+		float distance = 0.0f;
+
+		[[nodiscard]] bool isHit() const noexcept { return object != UINT32_MAX; }
+	};
+
+	/// Bounding volume hierarchy over object AABBs with 4 wide nodes.
+	/// Each node stores the boxes of its four children as separate x/y/z arrays so one SSE
+	/// instruction tests all children. build() bins centroids for a SAH split and builds large
+	/// subtrees on the job system, moving objects are handled by updateObject() + refit()
+	/// which only touches the paths from the moved leaves to the root.
+	class Bvh {
+	public:
+		Bvh() = default;
+		Bvh(const Bvh&) = delete;
+		Bvh& operator=(const Bvh&) = delete;
+		~Bvh() = default;
+
+		// object ids are the indices into objectBounds
+		void build(std::span<const Aabb> objectBounds, JobSystem& jobSystem);
+		void updateObject(uint32_t object, const Aabb& bounds);
+		void refit();
+		// refitted trees lose quality, rebuild after a large part of the objects moved
+		[[nodiscard]] bool isRebuildRecommended() const noexcept { return m_movedSinceBuild * 2 > getObjectCount(); }
+
+		// the queries append object ids to result
+		void cullFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+		void queryAabb(const Aabb& bounds, std::vector<uint32_t>& result) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+		// intersect refines a box hit to the exact distance, returns false when the object is missed
+		[[nodiscard]] RayHit raycast(const Ray& ray, float maxDistance,
+			const std::function<bool(uint32_t object, float& distance)>& intersect = {}) const;
+
+		[[nodiscard]] uint32_t getObjectCount() const noexcept { return static_cast<uint32_t>(m_objectBounds.size()); }
+		[[nodiscard]] uint32_t getNodeCount() const noexcept { return m_nodeCount; }
+
+	private:
+		static constexpr uint32_t EMPTY_CHILD = UINT32_MAX;
+		static constexpr uint32_t LEAF_FLAG = 0x80000000u;
+		static constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+		// SAH splits may peel a few objects off per level, deeper nodes split at the median
+		static constexpr uint32_t MAX_SAH_DEPTH = 48;
+		// median splits quarter the objects per level, 16 levels bring 2^32 objects down to leaves
+		static constexpr uint32_t MAX_TREE_DEPTH = MAX_SAH_DEPTH + 16;
+		// a traversal keeps at most three siblings per level on its stack, plus the children of the deepest node
+		static constexpr uint32_t MAX_STACK_DEPTH = 3 * MAX_TREE_DEPTH + 1;
+
+		struct alignas(16) Node {
+			float minX[4];
+			float minY[4];
+			float minZ[4];
+			float maxX[4];
+			float maxY[4];
+			float maxZ[4];
+			// node index, LEAF_FLAG | first object of the leaf, or EMPTY_CHILD
+			uint32_t children[4];
+			uint32_t objectCounts[4];
+			uint32_t parent;
+			uint32_t parentSlot;
+		};
+
+		struct BuildRange {
+			uint32_t begin;
+			uint32_t end;
+			Aabb bounds;
+		};
+
+		std::vector<Node> m_nodes;
+		uint32_t m_nodeCount = 0;
+		std::atomic<uint32_t> m_nodeAllocator{ 0 };
+
+		std::vector<Aabb> m_objectBounds;
+		std::vector<glm::vec4> m_objectCentroids;
+		// objects in leaf order, leaves reference ranges of it
+		std::vector<uint32_t> m_leafObjects;
+		// node << 2 | slot of the leaf holding each object
+		std::vector<uint32_t> m_objectLeaves;
+
+		std::vector<uint32_t> m_dirtyObjects;
+		std::vector<uint32_t> m_refitHeap;
+		std::vector<uint32_t> m_refitStamps;
+		uint32_t m_refitStamp = 0;
+		uint32_t m_movedSinceBuild = 0;
+
+		void buildNode(uint32_t nodeIndex, uint32_t parent, uint32_t parentSlot, uint32_t depth, const BuildRange& range,
+			JobSystem& jobSystem, JobCounter& counter);
+		[[nodiscard]] bool splitRange(const BuildRange& range, bool isMedianSplit, BuildRange& left, BuildRange& right);
+		[[nodiscard]] Aabb computeRangeBounds(uint32_t begin, uint32_t end) const noexcept;
+		[[nodiscard]] Aabb getNodeBounds(uint32_t nodeIndex) const noexcept;
+		static void setChildBounds(Node& node, uint32_t slot, const Aabb& bounds) noexcept;
+		void markRefit(uint32_t nodeIndex);
+	};
+}
@@ -1,27 +1,159 @@
 ﻿#pragma once
 #include "Swapchain.h"
+#include "FrameContext.h"
+#include "FrameCapture.h"
+#include "FrameRecorder.h"
+#include "DynamicResolution.h"
+#include "TextureLoader.h"
+#include "Scene.h"
+#include "Bvh.h"
+#include "Input.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace coldwind
 {
+	/// The thread that creates the engine owns GLFW: run() only pumps window events there and queues them
+	/// to a render thread, which owns the swapchains and draws the frames. A long frame no longer delays
+	/// input handling and a blocking OS window drag no longer stalls rendering.
 	class ColdWindEngine
 	{
 	public:
+		// render thread, runs once per frame before the scene update, input holds what happened since the previous frame
+		using FrameUpdate = std::function<void(const FrameInput& input, Scene& scene)>;
+
 		explicit ColdWindEngine(const std::string& appName, uint32_t width, uint32_t height);
 		ColdWindEngine(const ColdWindEngine&) = delete;
 		ColdWindEngine& operator=(const ColdWindEngine&) = delete;
 		~ColdWindEngine();
 
-		inline void run() { mainLoop(); }
+		// returns once the main window closed, rethrows what stopped the render thread
+		void run();
+
+		// main thread, opens another window rendered by the same device, it is destroyed once the user closes it
+		void openWindow(const std::string& title, uint32_t width, uint32_t height);
+		// main thread, counts windows until the render thread released them
+		[[nodiscard]] uint32_t getWindowCount() const noexcept { return static_cast<uint32_t>(m_windows.size()); }
+		// the following are queued to the render thread and apply before its next frame
+		// captures the next frameCount frames for ColdWindCaptureReplay
+		void captureFrames(const std::string& path, uint32_t frameCount);
+		// records the main window to a video file or stream until stopRecording()
+		void startRecording(const RecordingSettings& settings);
+		void stopRecording();
+		// the game logic of every following frame, the input and the scene are only valid during the call
+		void setFrameUpdate(FrameUpdate update);
 
 	private:
+		// every window has its own swapchain and resize state, the GLFW user pointer points here
+		struct EngineWindow {
+			ColdWindEngine* engine = nullptr;
+			std::unique_ptr<Window> window;
+			// the swapchain and resize state belong to the render thread
+			std::unique_ptr<SwapChain> swapChain;
+			uint32_t imageIndex = 0;
+			bool isResized = false;
+			// main thread, no event follows the window's Closed event
+			bool isClosing = false;
+			// set by the render thread once the swapchain is gone, the main thread destroys the window then
+			std::atomic<bool> isReleased{ false };
+		};
+
+		// what the GLFW callbacks saw, the window's extent itself is read from the window
+		struct WindowEvent {
+			enum class Type : uint8_t {
+				Opened,
+				Resized,
+				Closed,
+				Key,
+				MouseButton,
+				CursorMoved,
+				Scrolled
+			};
+
+			Type type = Type::Opened;
+			EngineWindow* window = nullptr;
+			// key or mouse button and GLFW action
+			int32_t code = 0;
+			int32_t action = 0;
+			// cursor position or scroll offset
+			double x = 0.0;
+			double y = 0.0;
+		};
+
 		Instance m_instance;
-		Window m_window;
+		// the first window is the main window, the device is selected for its surface
+		std::vector<std::unique_ptr<EngineWindow>> m_windows;
 		VKContext m_context;
-		SwapChain m_swapChain;
+		ResourceRegistry m_resources;
+		FrameContext m_frameContext;
+		// the frame's GPU work, executed into the frame's command buffer and captured from there
+		CommandStream m_commandStream;
+		FrameCapture m_capture;
+		std::string m_capturePath;
+		uint32_t m_captureFrameCount = 0;
+		std::unique_ptr<FrameRecorder> m_recorder;
+		JobSystem m_jobSystem;
+		PipelineCache m_pipelineCache;
+		// the main window renders at a scale that holds the GPU frame time budget
+		DynamicResolution m_dynamicResolution;
+		TextureStreamer m_textureStreamer;
+		TextureLoader m_textureLoader;
+		Scene m_scene;
+		Bvh m_sceneBvh;
+
+		// main thread to render thread, a frame of events fits easily, the main thread only waits on a stalled render thread
+		SpscQueue<WindowEvent, 1024> m_events;
+		// bumped after every push, the idle render thread waits on it
+		std::atomic<uint32_t> m_eventSignal{ 0 };
+		// the windows that have a swapchain, in opening order, render thread only
+		std::vector<EngineWindow*> m_renderWindows;
+		// collects events until a frame consumed it, idle loop iterations do not flip it
+		FrameInput m_input;
+		FrameUpdate m_frameUpdate;
+		std::mutex m_renderCommandMutex;
+		std::vector<std::function<void()>> m_renderCommands;
+		// swapped with m_renderCommands under the lock, so running the commands allocates nothing
+		std::vector<std::function<void()>> m_runningCommands;
+		std::thread m_renderThread;
+		std::atomic<bool> m_isStopRequested{ false };
+		std::atomic<bool> m_isRenderThreadDone{ false };
+		std::exception_ptr m_renderThreadError;
+#ifndef NDEBUG
+		uint64_t m_lastFrameAllocations = 0;
+#endif
+
+		void renderLoop();
+		// false once the main window closed or the engine is shutting down
+		[[nodiscard]] bool processEvents();
+		void runRenderCommands();
+		void postRenderCommand(std::function<void()> command);
+		void drawFrame();
+		void recordClear(ImageHandle image, vk::ImageLayout finalLayout);
+		void updateSceneBvh();
 
-		void mainLoop();
+		// render thread, waits for the device and drops the window's swapchain
+		void releaseWindow(EngineWindow& engineWindow);
+		// main thread, destroys the windows the render thread released
+		void destroyReleasedWindows();
 
-		void onWindowResize();
-		static void windowResizeCallback(GLFWwindow* window, int width, int height);
+		[[nodiscard]] static std::vector<std::unique_ptr<EngineWindow>> createMainWindow(Instance& instance,
+			uint32_t width, uint32_t height, const std::string& title);
+		// main thread, the render thread creates the swapchain when it receives the Opened event
+		void addWindow(EngineWindow& engineWindow);
+		void attachSwapChain(EngineWindow& engineWindow);
+		void pushEvent(const WindowEvent& event);
+		static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+		static void windowCloseCallback(GLFWwindow* window);
+		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+		static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+		static void cursorPosCallback(GLFWwindow* window, double x, double y);
+		static void scrollCallback(GLFWwindow* window, double x, double y);
 	};
 }
@@ -0,0 +1,91 @@
+#pragma once
+#include "ResourceRegistry.h"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace coldwind {
+	enum class CommandType : uint32_t {
+		BeginPass,
+		EndPass,
+		ImageBarrier,
+		ClearColorImage,
+		CopyBuffer,
+		CopyBufferToImage,
+		FillBuffer,
+		Count
+	};
+
+	/// Engine level GPU commands recorded into a flat byte stream, resources are referenced by registry handle.
+	/// A frame is recorded once and then executed into a Vulkan command buffer, the same bytes can be written
+	/// to a capture file and replayed on another device. clear() keeps the capacity, so a steady frame
+	/// records without allocating.
+	class CommandStream {
+	public:
+		static constexpr size_t MAX_PASS_NAME_LENGTH = 47;
+
+		CommandStream() = default;
+		CommandStream(const CommandStream&) = delete;
+		CommandStream& operator=(const CommandStream&) = delete;
+		CommandStream(CommandStream&&) noexcept = default;
+		CommandStream& operator=(CommandStream&&) noexcept = default;
+		~CommandStream() = default;
+
+		void clear() noexcept;
+
+		// passes are the unit of replay timing, they can not nest, longer names are truncated
+		void beginPass(std::string_view name);
+		void endPass();
+
+		// covers every mip level and array layer
+		void imageBarrier(ImageHandle image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+			vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+		void clearColorImage(ImageHandle image, const std::array<float, 4>& color);
+		void copyBuffer(BufferHandle source, BufferHandle destination, const vk::BufferCopy& region);
+		void copyBufferToImage(BufferHandle source, ImageHandle destination, const vk::BufferImageCopy& region);
+		void fillBuffer(BufferHandle destination, vk::DeviceSize offset, vk::DeviceSize size, uint32_t data);
+
+		// resolves the handles through registry and records the Vulkan commands, the registry's image layouts
+		// follow the barriers. With a timestamp pool of queryCount queries pass i writes queries firstQuery + 2 * i
+		// and + 2 * i + 1, throws when those do not fit or a pass is still open
+		void execute(vk::CommandBuffer commandBuffer, ResourceRegistry& registry, vk::QueryPool timestampPool = {},
+			uint32_t firstQuery = 0, uint32_t queryCount = 0) const;
+
+		// replaces a stream with bytes read from a capture, throws when they are not a valid stream,
+		// including passes that nest or are never ended
+		void assign(std::span<const std::byte> data);
+		// rewrites handles recorded against another registry
+		void remapHandles(const std::function<BufferHandle(BufferHandle)>& remapBuffer, const std::function<ImageHandle(ImageHandle)>& remapImage);
+		// e.g. present layouts on a headless device
+		void replaceLayout(vk::ImageLayout from, vk::ImageLayout to);
+
+		[[nodiscard]] std::span<const std::byte> getData() const noexcept { return m_data; }
+		[[nodiscard]] uint32_t getCommandCount() const noexcept { return m_commandCount; }
+		[[nodiscard]] uint32_t getPassCount() const noexcept { return m_passCount; }
+		[[nodiscard]] std::vector<std::string> getPassNames() const;
+
+	private:
+		struct CommandHeader {
+			CommandType type;
+			// payload bytes, a multiple of 8
+			uint32_t size;
+		};
+
+		std::vector<std::byte> m_data;
+		uint32_t m_commandCount = 0;
+		uint32_t m_passCount = 0;
+		bool m_isInPass = false;
+
+		template<typename T>
+		void push(CommandType type, const T& payload);
+		template<typename Visitor>
+		void forEachCommand(Visitor&& visitor) const;
+		template<typename Visitor>
+		void forEachCommand(Visitor&& visitor);
+	};
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "ResourceRegistry.h"
+#include "PipelineCache.h"
+
+#include <array>
+
+namespace coldwind {
+	struct DynamicResolutionSettings {
+		// GPU time budget of a frame, 16.6 ms holds 60 fps
+		float targetMilliseconds = 1000.0f / 60.0f;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		// the scale only grows while the GPU time stays below (1 - headroom) of the budget
+		float headroom = 0.15f;
+		vk::Format format = vk::Format::eR16G16B16A16Sfloat;
+	};
+
+	struct DynamicResolutionStats {
+		float scale = 1.0f;
+		vk::Extent2D renderExtent;
+		float gpuMilliseconds = 0.0f;
+		float smoothedMilliseconds = 0.0f;
+		uint32_t scaleChanges = 0;
+	};
+
+	/// Renders the scene into an offscreen target at a scale that follows the measured GPU frame time.
+	/// The target is allocated once at the largest output size seen times maxScale, scale changes only move
+	/// the render extent, passes set their viewport and scissor to getRenderExtent(). GPU time is measured
+	/// with timestamps around the frames that render the main window and read once the frame slot fence signaled,
+	/// the controller then waits for the frames in flight to show the new scale before adjusting again.
+	/// recordUpscale() resamples the rendered rect to the output with a Catmull-Rom filter in compute,
+	/// falling back to a linear blit until the upscale pipeline compiled.
+	class DynamicResolution {
+	public:
+		DynamicResolution(VKContext& context, ResourceRegistry& registry, PipelineCache& pipelineCache, const DynamicResolutionSettings& settings = {});
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+		~DynamicResolution();
+
+		// call after the frame slot fence wait and the registry's beginFrame(), before recording the scene,
+		// only for frames that render the main window
+		void update(uint32_t frameSlot, vk::Extent2D outputExtent);
+		// bracket the frame's command buffer, the first command and the last one, only in frames update() ran for.
+		// The start is written at the transfer stage, after the frame's acquire semaphore waits, which wait there too
+		void beginTiming(vk::CommandBuffer commandBuffer, uint32_t frameSlot);
+		void endTiming(vk::CommandBuffer commandBuffer, uint32_t frameSlot);
+		// the output, e.g. a swapchain image, is left in finalLayout. Recorded straight into the command buffer,
+		// a compute dispatch has no command stream equivalent, so frame captures do not contain the upscale
+		void recordUpscale(vk::CommandBuffer commandBuffer, uint32_t frameSlot, ImageHandle output, vk::ImageLayout finalLayout);
+
+		void setSettings(const DynamicResolutionSettings& settings) noexcept { m_settings = settings; }
+		[[nodiscard]] ImageHandle getSceneTarget() const noexcept { return m_sceneTarget; }
+		[[nodiscard]] vk::Extent2D getRenderExtent() const noexcept { return m_stats.renderExtent; }
+		[[nodiscard]] const DynamicResolutionStats& getStats() const noexcept { return m_stats; }
+
+	private:
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		PipelineCache& m_pipelineCache;
+		DynamicResolutionSettings m_settings;
+
+		// allocated extents only grow, smaller outputs use the top left rect
+		vk::Extent2D m_targetExtent;
+		vk::Extent2D m_upscaledExtent;
+		vk::Extent2D m_outputExtent;
+		ImageHandle m_sceneTarget;
+		ImageViewHandle m_sceneView;
+		ImageHandle m_upscaled;
+		ImageViewHandle m_upscaledView;
+		// bumped on reallocation, a frame slot rewrites its descriptor set when it is behind
+		uint32_t m_targetGeneration = 0;
+
+		// owned by the pipeline cache
+		vk::DescriptorSetLayout m_descriptorSetLayout;
+		vk::PipelineLayout m_pipelineLayout;
+		vk::ShaderModule m_shaderModule;
+		vk::Sampler m_sampler;
+		vk::UniqueDescriptorPool m_descriptorPool;
+		std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> m_descriptorSets;
+		std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> m_descriptorGenerations{};
+
+		// two timestamps per frame slot
+		vk::UniqueQueryPool m_queryPool;
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> m_isTimingWritten{};
+		double m_timestampPeriod = 0.0;
+		uint64_t m_timestampMask = 0;
+		uint32_t m_cooldownFrames = 0;
+
+		DynamicResolutionStats m_stats;
+
+		void createPipeline();
+		void createTargets(vk::Extent2D outputExtent);
+		void writeDescriptorSet(uint32_t frameSlot);
+		void readTiming(uint32_t frameSlot);
+		void updateScale(float gpuMilliseconds);
+		void updateRenderExtent() noexcept;
+		[[nodiscard]] vk::Pipeline getPipeline();
+	};
+}
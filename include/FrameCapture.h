@@ -0,0 +1,96 @@
+#pragma once
+#include "CommandStream.h"
+
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace coldwind {
+	/// Writes frames of the engine's command stream to a binary capture file.
+	/// begin() records every live registry buffer and image together with its contents, each captured frame
+	/// then adds the resources created since, the writes noted to the registry during the frame, i.e. the bytes
+	/// the CPU wrote to mapped buffers and images written outside the command streams, and the frame's command
+	/// stream. Contents are only captured for resources the GPU can copy from (eTransferSrc usage) or the CPU
+	/// wrote (mapped buffers), imported images and images in an undefined layout are recreated empty.
+	/// Writes to mapped buffers that are not noted are not captured, neither is GPU work recorded straight into the
+	/// frame's command buffer, i.e. the dynamic resolution upscale and the frame recorder's copies.
+	class FrameCapture {
+	public:
+		FrameCapture(VKContext& context, ResourceRegistry& registry);
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+		~FrameCapture();
+
+		// waits for the device, call between frames so the tracked image layouts are the real ones
+		void begin(const std::string& path, uint32_t frameCount);
+		// the stream as executed into the frame's command buffer, call once the frame's CPU writes are done
+		void recordFrame(const CommandStream& stream);
+
+		[[nodiscard]] bool isCapturing() const noexcept { return m_stream.is_open(); }
+
+	private:
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		std::string m_path;
+		std::ofstream m_stream;
+		uint32_t m_frameCount = 0;
+		uint32_t m_capturedFrames = 0;
+		// packed index and generation of every resource already in the file
+		std::unordered_set<uint64_t> m_writtenBuffers;
+		std::unordered_set<uint64_t> m_writtenImages;
+
+		void writeChunk(uint32_t type, const void* header, size_t headerSize, const void* data = nullptr, size_t dataSize = 0);
+		void writeNewResources();
+		// images must be in eGeneral unless the device is idle
+		void writeContents(std::span<const BufferHandle> buffers, std::span<const ImageHandle> images);
+		void end();
+	};
+
+	struct ReplayFrame {
+		CommandStream commands;
+		// bytes the CPU wrote to mapped buffers before the frame's commands, copied from the replayer's staging buffer
+		struct StagedWrite {
+			BufferHandle buffer;
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint64_t stagingOffset = 0;
+		};
+		std::vector<StagedWrite> stagedWrites;
+	};
+
+	/// Loads a capture into a registry of its own, on any device including headless ones, and re-executes its frames.
+	/// Every captured resource is recreated with its captured contents and layout, handles in the frames' command
+	/// streams are remapped to the new resources.
+	class CaptureReplayer {
+	public:
+		CaptureReplayer(VKContext& context, ResourceRegistry& registry, const std::string& path);
+		CaptureReplayer(const CaptureReplayer&) = delete;
+		CaptureReplayer& operator=(const CaptureReplayer&) = delete;
+		~CaptureReplayer() = default;
+
+		[[nodiscard]] uint32_t getFrameCount() const noexcept { return static_cast<uint32_t>(m_frames.size()); }
+		[[nodiscard]] const ReplayFrame& getFrame(uint32_t frame) const noexcept { return m_frames[frame]; }
+
+		// records the copies of the frame's buffer writes and then its commands, nothing is written by the CPU,
+		// so any number of frames can be recorded into one command buffer
+		void recordFrame(uint32_t frame, vk::CommandBuffer commandBuffer, vk::QueryPool timestampPool = {}, uint32_t firstQuery = 0,
+			uint32_t queryCount = 0);
+		// transitions every image back to its captured layout, so a loop starts from the same state each time
+		void recordRestoreLayouts(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct ReplayImage {
+			ImageHandle image;
+			vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+		};
+
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		std::vector<ReplayFrame> m_frames;
+		std::vector<ReplayImage> m_images;
+		// the buffer writes of every frame, filled once on load
+		BufferHandle m_frameStaging;
+	};
+}
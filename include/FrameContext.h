@@ -0,0 +1,60 @@
+#pragma once
+#include "VKContext.h"
+#include "LinearAllocator.h"
+#include "GpuLinearAllocator.h"
+
+#include <array>
+#include <span>
+#include <utility>
+
+namespace coldwind {
+	/// Owns everything a frame in flight uses: command pool and buffer, fence and the frame
+	/// scoped CPU and GPU linear allocators. Acquire semaphores belong to the swapchains.
+	/// beginFrame() waits for the fence of the frame that last used the slot, after that all of the
+	/// slot's memory is reused without any allocation. With timeline semaphore support every submit
+	/// also signals the frame timeline with frame number + 1.
+	class FrameContext {
+	public:
+		FrameContext(VKContext& context, ResourceRegistry& registry, size_t scratchSize = 1 << 20, vk::DeviceSize uploadSize = 4ull << 20);
+		FrameContext(const FrameContext&) = delete;
+		FrameContext& operator=(const FrameContext&) = delete;
+		~FrameContext() = default;
+
+		// may be called again for the same frame when it was abandoned before submit()
+		void beginFrame();
+		// resets the slot's command pool and begins its command buffer
+		[[nodiscard]] vk::CommandBuffer beginCommands();
+		// ends the command buffer and submits it to the graphics queue, signaling the frame fence
+		void submit(std::span<const vk::Semaphore> waitSemaphores, std::span<const vk::PipelineStageFlags> waitStages,
+			std::span<const vk::Semaphore> signalSemaphores);
+
+		[[nodiscard]] uint64_t getFrameNumber() const noexcept { return m_frameNumber; }
+		[[nodiscard]] uint32_t getFrameSlot() const noexcept { return static_cast<uint32_t>(m_frameNumber % MAX_FRAMES_IN_FLIGHT); }
+		[[nodiscard]] LinearAllocator& getScratchAllocator() noexcept { return m_frames[getFrameSlot()].scratch; }
+		[[nodiscard]] GpuLinearAllocator& getGpuAllocator() noexcept { return m_gpuAllocator; }
+		// null without DeviceCapabilities::timelineSemaphore
+		[[nodiscard]] vk::Semaphore getTimelineSemaphore() const noexcept { return m_timeline.get(); }
+
+	private:
+		struct Frame {
+			vk::UniqueCommandPool commandPool;
+			vk::CommandBuffer commandBuffer;
+			vk::UniqueFence inFlight;
+			LinearAllocator scratch;
+
+			explicit Frame(size_t scratchSize) : scratch(scratchSize) {}
+		};
+
+		VKContext& m_context;
+		std::array<Frame, MAX_FRAMES_IN_FLIGHT> m_frames;
+		GpuLinearAllocator m_gpuAllocator;
+		vk::UniqueSemaphore m_timeline;
+		uint64_t m_frameNumber = 0;
+
+		template<size_t... Slots>
+		static std::array<Frame, sizeof...(Slots)> createFrames(size_t scratchSize, std::index_sequence<Slots...>)
+		{
+			return { Frame((static_cast<void>(Slots), scratchSize))... };
+		}
+	};
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "ResourceRegistry.h"
+#include "PipelineCache.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+
+namespace coldwind {
+	struct RecordingSettings {
+		// a file or a streaming URL, e.g. recording.mp4 or rtmp://host/app/key
+		std::string path;
+		// avformat muxer name, guessed from the path when empty
+		std::string container;
+		// falls back to any H.264 encoder when not available
+		std::string codec = "libx264";
+		// width a multiple of 8, height even, sources of another size are scaled
+		uint32_t width = 1920;
+		uint32_t height = 1080;
+		uint32_t frameRate = 60;
+		int64_t bitRate = 8'000'000;
+	};
+
+	/// Records a registry image to a video file or stream without stalling the render loop.
+	/// record() blits the image into an encode sized RGBA image and converts it to YUV 4:2:0 in a compute
+	/// shader that writes straight into a slot of a host visible readback ring. collect() hands the slots of
+	/// completed frames to the encoder thread, so the CPU only reads a frame once its fence has signaled.
+	/// The render thread never waits for the GPU or the encoder, a frame is dropped when every slot is busy.
+	class FrameRecorder {
+	public:
+		static constexpr uint32_t RING_SIZE = MAX_FRAMES_IN_FLIGHT + 2;
+
+		// sourceFormat is the format of the images passed to record(), sRGB sources keep their encoding
+		FrameRecorder(VKContext& context, ResourceRegistry& registry, PipelineCache& pipelineCache, vk::Format sourceFormat,
+			const RecordingSettings& settings);
+		FrameRecorder(const FrameRecorder&) = delete;
+		FrameRecorder& operator=(const FrameRecorder&) = delete;
+		// waits for the device and the encoder, then finishes the file
+		~FrameRecorder();
+
+		// call after the frame slot fence wait, every frame recorded up to completedFrameNumber goes to the encoder
+		void collect(uint64_t completedFrameNumber);
+		// the source is returned to its tracked layout
+		void record(vk::CommandBuffer commandBuffer, ImageHandle source, uint64_t frameNumber);
+
+		[[nodiscard]] uint64_t getEncodedFrameCount() const noexcept { return m_encodedFrames.load(std::memory_order_relaxed); }
+		[[nodiscard]] uint64_t getDroppedFrameCount() const noexcept { return m_droppedFrames; }
+
+	private:
+		enum class SlotState : uint8_t {
+			Free,
+			InFlight,
+			Encoding
+		};
+
+		struct Slot {
+			SlotState state = SlotState::Free;
+			uint64_t frameNumber = 0;
+			int64_t pts = 0;
+		};
+
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		PipelineCache& m_pipelineCache;
+		RecordingSettings m_settings;
+		bool m_isSourceSrgb = false;
+
+		vk::DeviceSize m_slotSize = 0;
+		BufferHandle m_readbackBuffer;
+		// cached at creation, the encoder thread must not touch the registry
+		VmaAllocation m_readbackAllocation = nullptr;
+		uint8_t* m_readbackMapped = nullptr;
+		ImageHandle m_colorImage;
+		ImageViewHandle m_colorView;
+		// owned by the pipeline cache
+		vk::DescriptorSetLayout m_descriptorSetLayout;
+		vk::PipelineLayout m_pipelineLayout;
+		vk::ShaderModule m_shaderModule;
+		vk::UniqueDescriptorPool m_descriptorPool;
+		vk::DescriptorSet m_descriptorSet;
+
+		// slots and the encode queue are shared with the encoder thread under m_mutex
+		std::array<Slot, RING_SIZE> m_slots;
+		uint32_t m_nextSlot = 0;
+		std::array<uint32_t, RING_SIZE> m_encodeQueue{};
+		uint32_t m_encodeHead = 0;
+		uint32_t m_encodeCount = 0;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop = false;
+		std::thread m_encoder;
+
+		std::chrono::steady_clock::time_point m_startTime;
+		int64_t m_lastPts = -1;
+		uint64_t m_droppedFrames = 0;
+		std::atomic<uint64_t> m_encodedFrames{ 0 };
+		// render thread cost of record() and collect()
+		std::chrono::steady_clock::duration m_renderThreadTime{};
+		uint64_t m_recordedFrames = 0;
+
+		// FFmpeg state, only the encoder thread touches it once the constructor returned
+		AVFormatContext* m_formatContext = nullptr;
+		AVCodecContext* m_codecContext = nullptr;
+		AVStream* m_stream = nullptr;
+		AVFrame* m_frame = nullptr;
+		AVPacket* m_packet = nullptr;
+		bool m_isEncoderFailed = false;
+
+		void createTargets(vk::Format sourceFormat);
+		void createPipeline();
+		[[nodiscard]] vk::Pipeline getPipeline();
+		void openEncoder();
+		void closeEncoder();
+
+		void encoderLoop();
+		void encodeSlot(uint32_t slot);
+		bool writePackets();
+	};
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "ResourceRegistry.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace coldwind {
+	struct GpuAllocation {
+		vk::Buffer buffer;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		void* data = nullptr;
+	};
+
+	/// Persistently mapped buffer for data written once per frame: uniforms, dynamic vertices and indices.
+	/// The buffer holds one region per frame in flight, allocations bump through the region of the
+	/// current frame and are bound with dynamic offsets into the same buffer. A region is reused once
+	/// the fence of the frame that wrote it has signaled. An allocation that does not fit goes to an
+	/// overflow buffer, so bind GpuAllocation::buffer; the slot's next beginFrame() grows the regions to
+	/// the peak usage. The buffers live in the resource registry and every allocation is noted as a write
+	/// to them, so frame captures store the bytes a frame wrote.
+	class GpuLinearAllocator {
+	public:
+		GpuLinearAllocator(VKContext& context, ResourceRegistry& registry, vk::DeviceSize frameSize = 4ull << 20);
+		GpuLinearAllocator(const GpuLinearAllocator&) = delete;
+		GpuLinearAllocator& operator=(const GpuLinearAllocator&) = delete;
+		~GpuLinearAllocator();
+
+		// frameSlot's fence must have signaled, replaced buffers are retired to the registry
+		void beginFrame(uint32_t frameSlot);
+		// makes the writes of the frame visible to the device, call before submitting
+		void flush();
+
+		[[nodiscard]] GpuAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+		[[nodiscard]] GpuAllocation allocateUniform(vk::DeviceSize size) { return allocate(size, m_uniformAlignment); }
+		[[nodiscard]] GpuAllocation allocateStorage(vk::DeviceSize size) { return allocate(size, m_storageAlignment); }
+		[[nodiscard]] GpuAllocation allocateVertices(vk::DeviceSize size) { return allocate(size, 16); }
+
+		template<typename T>
+		[[nodiscard]] GpuAllocation uploadUniform(const T& value)
+		{
+			GpuAllocation allocation = allocateUniform(sizeof(T));
+			std::memcpy(allocation.data, &value, sizeof(T));
+			return allocation;
+		}
+
+		// the buffer holding the frame regions, changes when beginFrame() grows them
+		[[nodiscard]] vk::Buffer getBuffer() const noexcept { return m_block.buffer; }
+		[[nodiscard]] BufferHandle getBufferHandle() const noexcept { return m_block.handle; }
+		[[nodiscard]] vk::DeviceSize getUniformAlignment() const noexcept { return m_uniformAlignment; }
+		[[nodiscard]] vk::DeviceSize getUsed() const noexcept { return m_offset - m_frameBegin + m_overflowUsed; }
+		[[nodiscard]] vk::DeviceSize getFrameSize() const noexcept { return m_frameSize; }
+		[[nodiscard]] vk::DeviceSize getPeak() const noexcept { return m_peak; }
+
+	private:
+		struct Block {
+			BufferHandle handle;
+			vk::Buffer buffer;
+			VmaAllocation allocation = nullptr;
+			uint8_t* mapped = nullptr;
+			bool isCoherent = false;
+			vk::DeviceSize size = 0;
+			// overflow blocks only, the frame regions use m_offset
+			vk::DeviceSize used = 0;
+		};
+
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		// one region of m_frameSize per frame in flight
+		Block m_block;
+		// per frame slot, released by the slot's next beginFrame()
+		std::array<std::vector<Block>, MAX_FRAMES_IN_FLIGHT> m_overflowBlocks;
+
+		uint32_t m_frameSlot = 0;
+		vk::DeviceSize m_frameSize = 0;
+		vk::DeviceSize m_frameBegin = 0;
+		vk::DeviceSize m_offset = 0;
+		vk::DeviceSize m_overflowUsed = 0;
+		vk::DeviceSize m_peak = 0;
+		vk::DeviceSize m_uniformAlignment = 0;
+		vk::DeviceSize m_storageAlignment = 0;
+
+		[[nodiscard]] Block createBlock(vk::DeviceSize size);
+		void flushBlock(const Block& block, vk::DeviceSize offset, vk::DeviceSize size);
+	};
+}
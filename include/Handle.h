@@ -0,0 +1,146 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace coldwind {
+	/// Generational handle, stays detectably stale after its slot is reused.
+	template<typename Tag>
+	struct Handle {
+		uint32_t index = UINT32_MAX;
+		uint32_t generation = 0;
+
+		[[nodiscard]] bool isValid() const noexcept { return index != UINT32_MAX; }
+		bool operator==(const Handle&) const = default;
+	};
+
+	/// Maps stable handles to dense indices.
+	/// Dense indices stay packed in [0, size()), releasing a handle moves the last dense
+	/// element into the hole, owners of dense arrays mirror that move.
+	template<typename Tag>
+	class HandlePool {
+	public:
+		using HandleType = Handle<Tag>;
+
+		void reserve(uint32_t capacity)
+		{
+			m_slotToDense.reserve(capacity);
+			m_generations.reserve(capacity);
+			m_denseToSlot.reserve(capacity);
+		}
+
+		// the new handle's dense index is size() - 1
+		[[nodiscard]] HandleType allocate()
+		{
+			uint32_t slot;
+			if (!m_freeSlots.empty()) {
+				slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+			}
+			else {
+				slot = static_cast<uint32_t>(m_slotToDense.size());
+				m_slotToDense.push_back(UINT32_MAX);
+				m_generations.push_back(0);
+			}
+			m_slotToDense[slot] = static_cast<uint32_t>(m_denseToSlot.size());
+			m_denseToSlot.push_back(slot);
+			return HandleType{ slot, m_generations[slot] };
+		}
+
+		// returns the freed dense index, the former last dense element now lives there
+		uint32_t release(HandleType handle) noexcept
+		{
+			const uint32_t dense = getDenseIndex(handle);
+			if (dense == UINT32_MAX) return UINT32_MAX;
+
+			const uint32_t lastSlot = m_denseToSlot.back();
+			m_denseToSlot[dense] = lastSlot;
+			m_slotToDense[lastSlot] = dense;
+			m_denseToSlot.pop_back();
+
+			m_slotToDense[handle.index] = UINT32_MAX;
+			++m_generations[handle.index];
+			m_freeSlots.push_back(handle.index);
+			return dense;
+		}
+
+		[[nodiscard]] bool isAlive(HandleType handle) const noexcept { return getDenseIndex(handle) != UINT32_MAX; }
+
+		[[nodiscard]] uint32_t getDenseIndex(HandleType handle) const noexcept
+		{
+			if (handle.index >= m_slotToDense.size() || m_generations[handle.index] != handle.generation) return UINT32_MAX;
+			return m_slotToDense[handle.index];
+		}
+
+		// slots are stable for a handle's lifetime, cheaper to store than full handles for internal links
+		[[nodiscard]] uint32_t getDenseIndexFromSlot(uint32_t slot) const noexcept { return m_slotToDense[slot]; }
+		[[nodiscard]] uint32_t getSlot(uint32_t dense) const noexcept { return m_denseToSlot[dense]; }
+		[[nodiscard]] HandleType getHandle(uint32_t dense) const noexcept
+		{
+			const uint32_t slot = m_denseToSlot[dense];
+			return HandleType{ slot, m_generations[slot] };
+		}
+
+		[[nodiscard]] uint32_t size() const noexcept { return static_cast<uint32_t>(m_denseToSlot.size()); }
+
+	private:
+		std::vector<uint32_t> m_slotToDense;
+		std::vector<uint32_t> m_generations;
+		std::vector<uint32_t> m_denseToSlot;
+		std::vector<uint32_t> m_freeSlots;
+	};
+
+	/// Dense array of values addressed by generational handles.
+	/// Values stay packed for iteration, erase() moves the last value into the hole.
+	template<typename Tag, typename T>
+	class SlotMap {
+	public:
+		using HandleType = Handle<Tag>;
+
+		void reserve(uint32_t capacity)
+		{
+			m_pool.reserve(capacity);
+			m_values.reserve(capacity);
+		}
+
+		[[nodiscard]] HandleType insert(T value)
+		{
+			const HandleType handle = m_pool.allocate();
+			m_values.push_back(std::move(value));
+			return handle;
+		}
+
+		// returns false for stale handles
+		bool erase(HandleType handle, T* erased = nullptr)
+		{
+			const uint32_t dense = m_pool.release(handle);
+			if (dense == UINT32_MAX) return false;
+			if (erased != nullptr) *erased = std::move(m_values[dense]);
+			if (dense + 1 != m_values.size()) m_values[dense] = std::move(m_values.back());
+			m_values.pop_back();
+			return true;
+		}
+
+		[[nodiscard]] T* get(HandleType handle) noexcept
+		{
+			const uint32_t dense = m_pool.getDenseIndex(handle);
+			return dense == UINT32_MAX ? nullptr : &m_values[dense];
+		}
+		[[nodiscard]] const T* get(HandleType handle) const noexcept
+		{
+			const uint32_t dense = m_pool.getDenseIndex(handle);
+			return dense == UINT32_MAX ? nullptr : &m_values[dense];
+		}
+
+		[[nodiscard]] bool isAlive(HandleType handle) const noexcept { return m_pool.isAlive(handle); }
+		[[nodiscard]] HandleType getHandle(uint32_t dense) const noexcept { return m_pool.getHandle(dense); }
+		[[nodiscard]] std::span<T> getValues() noexcept { return m_values; }
+		[[nodiscard]] std::span<const T> getValues() const noexcept { return m_values; }
+		[[nodiscard]] uint32_t size() const noexcept { return m_pool.size(); }
+
+	private:
+		HandlePool<Tag> m_pool;
+		std::vector<T> m_values;
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <glfw/glfw3.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+namespace coldwind {
+	struct InputState {
+		std::bitset<GLFW_KEY_LAST + 1> keysDown;
+		std::bitset<GLFW_MOUSE_BUTTON_LAST + 1> mouseButtonsDown;
+		// set by a press since the previous frame, even when the key was released again
+		std::bitset<GLFW_KEY_LAST + 1> keysPressed;
+		std::bitset<GLFW_MOUSE_BUTTON_LAST + 1> mouseButtonsPressed;
+		double cursorX = 0.0;
+		double cursorY = 0.0;
+		// scrolled during the frame
+		double scrollX = 0.0;
+		double scrollY = 0.0;
+	};
+
+	/// Input of the frame being simulated and rendered, folded from the window events queued since the previous frame.
+	/// The previous frame's state is kept beside it, beginFrame() flips the two, so deltas need no extra bookkeeping.
+	class FrameInput {
+	public:
+		// carries held keys and the cursor over, clears the per frame transitions and scrolling
+		void beginFrame() noexcept;
+
+		void onKey(int key, int action) noexcept;
+		void onMouseButton(int button, int action) noexcept;
+		void onCursorMoved(double x, double y) noexcept;
+		void onScrolled(double x, double y) noexcept;
+
+		[[nodiscard]] const InputState& getState() const noexcept { return m_states[m_current]; }
+		[[nodiscard]] const InputState& getPreviousState() const noexcept { return m_states[m_current ^ 1]; }
+		[[nodiscard]] bool isKeyDown(int key) const noexcept { return isKeyValid(key) && getState().keysDown[key]; }
+		[[nodiscard]] bool wasKeyPressed(int key) const noexcept { return isKeyValid(key) && getState().keysPressed[key]; }
+		[[nodiscard]] bool isMouseButtonDown(int button) const noexcept { return isButtonValid(button) && getState().mouseButtonsDown[button]; }
+		[[nodiscard]] bool wasMouseButtonPressed(int button) const noexcept { return isButtonValid(button) && getState().mouseButtonsPressed[button]; }
+		[[nodiscard]] double getCursorDeltaX() const noexcept { return getState().cursorX - getPreviousState().cursorX; }
+		[[nodiscard]] double getCursorDeltaY() const noexcept { return getState().cursorY - getPreviousState().cursorY; }
+
+	private:
+		std::array<InputState, 2> m_states;
+		uint32_t m_current = 0;
+
+		// GLFW_KEY_UNKNOWN is -1
+		[[nodiscard]] static bool isKeyValid(int key) noexcept { return key >= 0 && key <= GLFW_KEY_LAST; }
+		[[nodiscard]] static bool isButtonValid(int button) noexcept { return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST; }
+		[[nodiscard]] InputState& getWritableState() noexcept { return m_states[m_current]; }
+	};
+}
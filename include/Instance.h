@@ -9,6 +9,7 @@ namespace coldwind
 	static const uint32_t ENGINE_VERION = VK_MAKE_VERSION(1, 0, 0);
 	static const char* ENGINE_NAME = "ColdWind Engine";
 	static const uint32_t USING_VK_API_VERSION = VK_API_VERSION_1_3;
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 
 	enum class RequirementType : uint8_t {
 		Required = 2,
@@ -18,15 +19,22 @@ namespace coldwind
 		Supported = 0,
 		Unsupported = 1
 	};
+	// headless instances enable no surface extensions, used by offline tools without a display
+	enum class InstanceMode : uint8_t {
+		Windowed,
+		Headless
+	};
 
 	class Instance {
 	public:
-		Instance(const std::string& appName, uint8_t versionMajor = 1, uint8_t versionMinor = 0, uint8_t versionPatch = 0);
+		Instance(const std::string& appName, InstanceMode mode = InstanceMode::Windowed,
+			uint8_t versionMajor = 1, uint8_t versionMinor = 0, uint8_t versionPatch = 0);
 		Instance(const Instance&) = delete;
 		Instance& operator=(const Instance&) = delete;
 		~Instance() = default;
 
 		[[nodiscard]] vk::UniqueInstance& getVKInstance() noexcept { return m_instance; }
+		[[nodiscard]] bool isHeadless() const noexcept { return m_mode == InstanceMode::Headless; }
 
 #ifdef NDEBUG
 		bool m_validationLayersEnabled = false;
@@ -45,5 +53,6 @@ namespace coldwind
 		vk::UniqueHandle<vk::DebugUtilsMessengerEXT, vk::detail::DispatchLoaderDynamic> m_debugMessenger;
 		std::string m_AppName;
 		uint32_t m_AppVersion;
+		InstanceMode m_mode;
 	};
 }
\ No newline at end of file
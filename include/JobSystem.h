@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace coldwind {
+	struct JobCounter {
+		std::atomic<uint32_t> pending{ 0 };
+
+		[[nodiscard]] bool isBusy() const noexcept { return pending.load(std::memory_order_acquire) != 0; }
+	};
+
+	/// Fixed pool of worker threads pulling jobs from a shared queue.
+	/// Waiting threads run queued jobs themselves instead of blocking, so nested waits cannot deadlock.
+	/// Background jobs, e.g. pipeline compiles or file reads, have a queue of their own that only the
+	/// workers take from, a wait() on the frame thread never ends up running one of them.
+	class JobSystem {
+	public:
+		// threadCount 0 uses every hardware thread but the calling one
+		explicit JobSystem(uint32_t threadCount = 0);
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		void execute(std::function<void()> job, JobCounter* counter = nullptr);
+		// workers run these once the regular queue is empty
+		void executeBackground(std::function<void()> job, JobCounter* counter = nullptr);
+		// runs regular jobs while waiting, background jobs finish on the workers
+		void wait(JobCounter& counter);
+
+		// splits [0, count) into batches of batchSize and blocks until all of them ran
+		void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& job);
+
+		[[nodiscard]] uint32_t getThreadCount() const noexcept { return static_cast<uint32_t>(m_workers.size()); }
+
+	private:
+		struct Job {
+			std::function<void()> function;
+			JobCounter* counter = nullptr;
+		};
+
+		// ring buffer, only grows so a steady job load does not allocate
+		struct JobQueue {
+			std::vector<Job> jobs;
+			size_t head = 0;
+			size_t count = 0;
+
+			void push(Job&& job);
+			[[nodiscard]] Job pop() noexcept;
+		};
+
+		std::vector<std::thread> m_workers;
+		JobQueue m_jobs;
+		JobQueue m_backgroundJobs;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop = false;
+
+		void workerLoop();
+		bool runPendingJob();
+		void enqueue(JobQueue& queue, std::function<void()>&& job, JobCounter* counter);
+		static void runJob(Job& job);
+	};
+}
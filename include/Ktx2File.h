@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace coldwind {
+	/// Reader/writer for single layer 2D KTX2 containers.
+	/// The level index is parsed on open, level data is read on demand so large
+	/// textures never have to be fully resident in system memory.
+	class Ktx2File {
+	public:
+		explicit Ktx2File(const std::string& path);
+		Ktx2File(const Ktx2File&) = delete;
+		Ktx2File& operator=(const Ktx2File&) = delete;
+		~Ktx2File() = default;
+
+		[[nodiscard]] vk::Format getFormat() const noexcept { return m_format; }
+		[[nodiscard]] uint32_t getWidth() const noexcept { return m_width; }
+		[[nodiscard]] uint32_t getHeight() const noexcept { return m_height; }
+		[[nodiscard]] uint32_t getMipLevels() const noexcept { return static_cast<uint32_t>(m_levels.size()); }
+		[[nodiscard]] vk::DeviceSize getLevelSize(uint32_t mipLevel) const noexcept { return m_levels[mipLevel].byteLength; }
+		// whether the base level uses alpha, as recorded by the baker, empty for files written by other tools
+		[[nodiscard]] std::optional<bool> hasAlpha() const noexcept { return m_hasAlpha; }
+
+		bool readLevel(uint32_t mipLevel, void* dst, vk::DeviceSize size);
+
+		// levels[0] is the base level, every level is tightly packed, hasAlpha is stored in the key/value data
+		static void write(const std::string& path, vk::Format format, uint32_t width, uint32_t height,
+			const std::vector<std::vector<uint8_t>>& levels, std::optional<bool> hasAlpha = std::nullopt);
+
+	private:
+		struct LevelIndex {
+			uint64_t byteOffset = 0;
+			uint64_t byteLength = 0;
+			uint64_t uncompressedByteLength = 0;
+		};
+
+		std::string m_path;
+		std::ifstream m_stream;
+		vk::Format m_format = vk::Format::eUndefined;
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		std::vector<LevelIndex> m_levels;
+		std::optional<bool> m_hasAlpha;
+
+		void readKeyValueData(uint32_t offset, uint32_t length);
+	};
+}
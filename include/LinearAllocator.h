@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace coldwind {
+	/// Bump allocator for transient CPU data, everything is released at once by reset().
+	/// An allocation that does not fit goes to an overflow block, the next reset() grows the
+	/// main block to the peak usage so a steady workload stops allocating after a few frames.
+	class LinearAllocator {
+	public:
+		explicit LinearAllocator(size_t capacity = 1 << 20);
+		LinearAllocator(const LinearAllocator&) = delete;
+		LinearAllocator& operator=(const LinearAllocator&) = delete;
+		~LinearAllocator() = default;
+
+		[[nodiscard]] void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		// objects are default initialized and never destroyed
+		template<typename T>
+		[[nodiscard]] T* allocateArray(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "LinearAllocator never runs destructors");
+			T* values = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+			std::uninitialized_default_construct_n(values, count);
+			return values;
+		}
+
+		void reset();
+
+		[[nodiscard]] size_t getUsed() const noexcept { return m_overflowUsed + m_offset; }
+		[[nodiscard]] size_t getCapacity() const noexcept { return m_capacity; }
+		[[nodiscard]] size_t getPeak() const noexcept { return m_peak; }
+
+	private:
+		std::unique_ptr<std::byte[]> m_buffer;
+		size_t m_capacity = 0;
+		size_t m_offset = 0;
+
+		// current block is m_buffer until the first overflow
+		std::byte* m_block = nullptr;
+		size_t m_blockSize = 0;
+		std::vector<std::unique_ptr<std::byte[]>> m_overflowBlocks;
+		size_t m_overflowUsed = 0;
+		size_t m_peak = 0;
+	};
+
+	/// Standard allocator over a LinearAllocator, for containers that only live during a frame.
+	template<typename T>
+	class LinearStlAllocator {
+	public:
+		using value_type = T;
+
+		explicit LinearStlAllocator(LinearAllocator& allocator) noexcept : m_allocator(&allocator) {}
+		template<typename U>
+		LinearStlAllocator(const LinearStlAllocator<U>& other) noexcept : m_allocator(other.getAllocator()) {}
+
+		[[nodiscard]] T* allocate(size_t count) { return static_cast<T*>(m_allocator->allocate(sizeof(T) * count, alignof(T))); }
+		void deallocate(T*, size_t) noexcept {}
+
+		[[nodiscard]] LinearAllocator* getAllocator() const noexcept { return m_allocator; }
+
+		template<typename U>
+		bool operator==(const LinearStlAllocator<U>& other) const noexcept { return m_allocator == other.getAllocator(); }
+
+	private:
+		LinearAllocator* m_allocator;
+	};
+
+	template<typename T>
+	using FrameVector = std::vector<T, LinearStlAllocator<T>>;
+}
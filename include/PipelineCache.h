@@ -0,0 +1,103 @@
+#pragma once
+#include "VKContext.h"
+#include "JobSystem.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace coldwind {
+	struct PipelineCacheStats {
+		uint32_t shaderModules = 0;
+		uint32_t samplers = 0;
+		uint32_t descriptorSetLayouts = 0;
+		uint32_t pipelineLayouts = 0;
+		uint32_t pipelines = 0;
+		uint32_t pendingCompiles = 0;
+		uint32_t failedCompiles = 0;
+		uint64_t lookups = 0;
+		uint64_t hits = 0;
+		// pipeline requests answered with the fallback instead of compiling on the calling thread
+		uint64_t compileStallsAvoided = 0;
+
+		[[nodiscard]] double getHitRate() const noexcept { return lookups != 0 ? static_cast<double>(hits) / lookups : 0.0; }
+	};
+
+	/// Deduplicates shader modules, samplers, layouts and pipelines by their full create info state.
+	/// Every object is keyed by a byte serialization of its create info with a fast hash in front, equal
+	/// state returns the same object for the cache's lifetime. Children are interned first, so a parent's
+	/// key can use the child handles: equal handles mean equal state. Lookups of existing objects are lock
+	/// free, only creating an object takes a lock. Pipelines compile as background jobs, until a compile
+	/// finished getPipeline() returns the caller's fallback, a null fallback means skipping the draw.
+	/// Create infos may chain vk::DescriptorSetLayoutBindingFlagsCreateInfo and vk::PipelineRenderingCreateInfo.
+	class PipelineCache {
+	public:
+		PipelineCache(VKContext& context, JobSystem& jobSystem);
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+		// waits for the compiles in flight and destroys every object
+		~PipelineCache();
+
+		// modules are keyed by their SPIR-V, create pipelines with these so equal shaders share a key
+		[[nodiscard]] vk::ShaderModule getShaderModule(std::span<const uint32_t> spirv);
+		[[nodiscard]] vk::Sampler getSampler(const vk::SamplerCreateInfo& createInfo);
+		// immutable samplers should come from getSampler()
+		[[nodiscard]] vk::DescriptorSetLayout getDescriptorSetLayout(const vk::DescriptorSetLayoutCreateInfo& createInfo);
+		[[nodiscard]] vk::PipelineLayout getPipelineLayout(const vk::PipelineLayoutCreateInfo& createInfo);
+
+		// never blocks, the first request queues the compile, basePipeline is not part of the key
+		[[nodiscard]] vk::Pipeline getPipeline(const vk::GraphicsPipelineCreateInfo& createInfo, vk::Pipeline fallback = {});
+		[[nodiscard]] vk::Pipeline getPipeline(const vk::ComputePipelineCreateInfo& createInfo, vk::Pipeline fallback = {});
+		// blocks until every queued compile finished, e.g. behind a loading screen
+		void waitForCompiles();
+
+		[[nodiscard]] PipelineCacheStats getStats() const noexcept;
+
+	private:
+		enum class ObjectKind : uint32_t {
+			ShaderModule,
+			Sampler,
+			DescriptorSetLayout,
+			PipelineLayout,
+			Pipeline,
+			Count
+		};
+
+		struct Entry;
+		struct Table;
+		struct PipelineState;
+
+		VKContext& m_context;
+		JobSystem& m_jobSystem;
+		// driver side cache, shares compiled shader code between pipelines that differ in state only
+		vk::UniquePipelineCache m_driverCache;
+
+		// readers load the current table and probe it without a lock, the mutex serializes inserts and growth
+		std::atomic<Table*> m_table{ nullptr };
+		// replaced tables stay alive, readers may still probe them
+		std::vector<std::unique_ptr<Table>> m_tables;
+		std::vector<std::unique_ptr<Entry>> m_entries;
+		std::mutex m_mutex;
+
+		JobCounter m_compiles;
+		std::array<std::atomic<uint32_t>, static_cast<size_t>(ObjectKind::Count)> m_objectCounts{};
+		std::atomic<uint32_t> m_failedCompiles{ 0 };
+		std::atomic<uint64_t> m_lookups{ 0 };
+		std::atomic<uint64_t> m_hits{ 0 };
+		std::atomic<uint64_t> m_compileStallsAvoided{ 0 };
+
+		[[nodiscard]] const Entry* find(std::span<const std::byte> key, uint64_t hash) const noexcept;
+		Entry& insert(ObjectKind kind, std::span<const std::byte> key, uint64_t hash, uint64_t object,
+			std::unique_ptr<PipelineState> state = nullptr);
+		template<typename Create>
+		[[nodiscard]] uint64_t getObject(ObjectKind kind, std::span<const std::byte> key, Create&& create);
+		// exactly one of graphics and compute is set
+		[[nodiscard]] vk::Pipeline requestPipeline(std::span<const std::byte> key, const vk::GraphicsPipelineCreateInfo* graphics,
+			const vk::ComputePipelineCreateInfo* compute, vk::Pipeline fallback);
+		void compile(Entry& entry);
+	};
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "VKContext.h"
+#include "Handle.h"
+
+#include <span>
+#include <vector>
+
+namespace coldwind {
+	struct BufferTag;
+	struct ImageTag;
+	struct ImageViewTag;
+	struct SamplerTag;
+	struct PipelineTag;
+	using BufferHandle = Handle<BufferTag>;
+	using ImageHandle = Handle<ImageTag>;
+	using ImageViewHandle = Handle<ImageViewTag>;
+	using SamplerHandle = Handle<SamplerTag>;
+	using PipelineHandle = Handle<PipelineTag>;
+
+	struct BufferResource {
+		vk::Buffer buffer;
+		VmaAllocation allocation = nullptr;
+		vk::DeviceSize size = 0;
+		vk::BufferUsageFlags usage;
+		// null unless created with VMA_ALLOCATION_CREATE_MAPPED_BIT
+		void* mapped = nullptr;
+	};
+
+	struct ImageResource {
+		vk::Image image;
+		// null for imported images, those are owned elsewhere
+		VmaAllocation allocation = nullptr;
+		vk::Format format = vk::Format::eUndefined;
+		vk::Extent3D extent;
+		uint32_t mipLevels = 1;
+		uint32_t arrayLayers = 1;
+		vk::ImageUsageFlags usage;
+		// layout after the last recorded command stream, tracked at record time
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+
+	struct ImageViewResource {
+		vk::ImageView view;
+		ImageHandle image;
+	};
+
+	struct SamplerResource {
+		vk::Sampler sampler;
+	};
+
+	struct PipelineResource {
+		vk::Pipeline pipeline;
+		vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+	};
+
+	// bytes the CPU wrote to a mapped buffer
+	struct BufferWrite {
+		BufferHandle buffer;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+	};
+
+	struct ResourceRegistryStats {
+		uint32_t buffers = 0;
+		uint32_t images = 0;
+		uint32_t imageViews = 0;
+		uint32_t samplers = 0;
+		uint32_t pipelines = 0;
+		uint32_t pendingDestructions = 0;
+	};
+
+	/// Owns GPU objects behind generational handles and destroys them only once the GPU is done.
+	/// Destroying a handle makes it stale right away and moves the object to a retire list keyed
+	/// with the current retire value, the frame number. collect() destroys everything retired up to
+	/// the frame the GPU has completed, so resources can be replaced without waiting for the device.
+	/// Objects owned elsewhere can be retired the same way. Retired objects a present may still
+	/// use must be drained from the present queue first, presents signal nothing on completion.
+	class ResourceRegistry {
+	public:
+		explicit ResourceRegistry(VKContext& context);
+		ResourceRegistry(const ResourceRegistry&) = delete;
+		ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+		~ResourceRegistry();
+
+		[[nodiscard]] BufferHandle createBuffer(const vk::BufferCreateInfo& createInfo, const VmaAllocationCreateInfo& allocationCreateInfo);
+		[[nodiscard]] ImageHandle createImage(const vk::ImageCreateInfo& createInfo, const VmaAllocationCreateInfo& allocationCreateInfo);
+		// viewInfo.image is taken from image
+		[[nodiscard]] ImageViewHandle createImageView(ImageHandle image, vk::ImageViewCreateInfo viewInfo);
+		[[nodiscard]] SamplerHandle createSampler(const vk::SamplerCreateInfo& createInfo);
+		// takes ownership of a pipeline created elsewhere
+		[[nodiscard]] PipelineHandle addPipeline(vk::Pipeline pipeline, vk::PipelineBindPoint bindPoint);
+		// takes ownership of an image allocated elsewhere, for owners that handle allocation failure themselves
+		[[nodiscard]] ImageHandle addImage(vk::Image image, VmaAllocation allocation, const vk::ImageCreateInfo& createInfo);
+		// registers an image owned elsewhere, e.g. a swapchain image, destroy() only releases the handle
+		[[nodiscard]] ImageHandle importImage(vk::Image image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage);
+
+		void destroy(BufferHandle handle);
+		void destroy(ImageHandle handle);
+		void destroy(ImageViewHandle handle);
+		void destroy(SamplerHandle handle);
+		void destroy(PipelineHandle handle);
+
+		template<typename T, typename Dispatch>
+		void retire(vk::UniqueHandle<T, Dispatch>&& object)
+		{
+			retire(object.release());
+		}
+		// any device child object, destroyed with vkDestroy*
+		template<typename T>
+		void retire(T object)
+		{
+			if (!object) return;
+			retireObject(toRaw(object), nullptr, [](VKContext& context, uint64_t raw, VmaAllocation) {
+				context.getDevice()->destroy(T(reinterpret_cast<typename T::CType>(raw)));
+			});
+		}
+		void retireBuffer(vk::Buffer buffer, VmaAllocation allocation);
+		void retireImage(vk::Image image, VmaAllocation allocation);
+
+		// objects retired from now on are destroyed once value is completed
+		void setRetireValue(uint64_t value) noexcept { m_retireValue = value; }
+		// destroys every object retired at or before completedValue
+		void collect(uint64_t completedValue);
+		// completed frames read from a timeline semaphore signaled with frame number + 1 by every submit
+		void collect(vk::Semaphore timelineSemaphore);
+		// frame numbers as retire values, call after frameNumber's frame slot fence has signaled,
+		// also forgets the previous frame's noted writes. With the frame timeline semaphore objects
+		// are destroyed as soon as their frame completed instead of MAX_FRAMES_IN_FLIGHT frames later.
+		void beginFrame(uint64_t frameNumber, vk::Semaphore timelineSemaphore = {});
+
+		[[nodiscard]] const BufferResource* get(BufferHandle handle) const noexcept { return m_buffers.get(handle); }
+		[[nodiscard]] const ImageResource* get(ImageHandle handle) const noexcept { return m_images.get(handle); }
+		[[nodiscard]] const ImageViewResource* get(ImageViewHandle handle) const noexcept { return m_imageViews.get(handle); }
+		[[nodiscard]] const SamplerResource* get(SamplerHandle handle) const noexcept { return m_samplers.get(handle); }
+		[[nodiscard]] const PipelineResource* get(PipelineHandle handle) const noexcept { return m_pipelines.get(handle); }
+		void setImageLayout(ImageHandle handle, vk::ImageLayout layout) noexcept;
+
+		// contents written outside of command streams during the frame, frame captures store exactly these.
+		// Adjacent buffer writes are merged, image writes must leave the image in eGeneral
+		void noteBufferWrite(BufferHandle handle, vk::DeviceSize offset, vk::DeviceSize size);
+		void noteImageWrite(ImageHandle handle);
+		[[nodiscard]] std::span<const BufferWrite> getBufferWrites() const noexcept { return m_bufferWrites; }
+		[[nodiscard]] std::span<const ImageHandle> getImageWrites() const noexcept { return m_imageWrites; }
+
+		[[nodiscard]] const SlotMap<BufferTag, BufferResource>& getBuffers() const noexcept { return m_buffers; }
+		[[nodiscard]] const SlotMap<ImageTag, ImageResource>& getImages() const noexcept { return m_images; }
+
+		[[nodiscard]] ResourceRegistryStats getStats() const noexcept;
+
+	private:
+		using DestroyFunction = void(*)(VKContext& context, uint64_t raw, VmaAllocation allocation);
+
+		struct RetiredObject {
+			uint64_t retireValue = 0;
+			uint64_t raw = 0;
+			VmaAllocation allocation = nullptr;
+			DestroyFunction destroy = nullptr;
+		};
+
+		VKContext& m_context;
+		SlotMap<BufferTag, BufferResource> m_buffers;
+		SlotMap<ImageTag, ImageResource> m_images;
+		SlotMap<ImageViewTag, ImageViewResource> m_imageViews;
+		SlotMap<SamplerTag, SamplerResource> m_samplers;
+		SlotMap<PipelineTag, PipelineResource> m_pipelines;
+
+		// ordered by retire value
+		std::vector<RetiredObject> m_retired;
+		uint64_t m_retireValue = 0;
+
+		// cleared every frame, the capacity is kept
+		std::vector<BufferWrite> m_bufferWrites;
+		std::vector<ImageHandle> m_imageWrites;
+
+		template<typename T>
+		[[nodiscard]] static uint64_t toRaw(T object) noexcept
+		{
+			return reinterpret_cast<uint64_t>(static_cast<typename T::CType>(object));
+		}
+		void retireObject(uint64_t raw, VmaAllocation allocation, DestroyFunction destroy);
+	};
+}
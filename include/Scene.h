@@ -0,0 +1,105 @@
+#pragma once
+#include "Bounds.h"
+#include "Handle.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <span>
+#include <vector>
+
+namespace coldwind {
+	struct SceneNodeTag;
+	using SceneNode = Handle<SceneNodeTag>;
+
+	// layout matches the per instance storage buffer consumed by shaders
+	struct InstanceData {
+		glm::mat4 model = glm::mat4(1.0f);
+		uint32_t meshIndex = UINT32_MAX;
+		uint32_t materialIndex = UINT32_MAX;
+		uint32_t padding[2] = {};
+	};
+	static_assert(sizeof(InstanceData) == 80, "InstanceData must stay tightly packed for upload");
+
+	/// Data oriented scene store.
+	/// Every per node attribute lives in its own dense array indexed by the node's dense index,
+	/// the world matrices double as the instance buffer. Hierarchy links store stable slots.
+	/// update() only recomputes the subtrees of nodes changed since the last update, one depth
+	/// level at a time, each level split over the job system.
+	class Scene {
+	public:
+		explicit Scene(uint32_t capacity = 1024);
+		Scene(const Scene&) = delete;
+		Scene& operator=(const Scene&) = delete;
+		~Scene() = default;
+
+		[[nodiscard]] SceneNode createNode(SceneNode parent = SceneNode{});
+		// destroys the node and its whole subtree
+		void destroyNode(SceneNode node);
+		void setParent(SceneNode node, SceneNode parent);
+
+		void setLocalTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+		void setLocalPosition(SceneNode node, const glm::vec3& position);
+		void setLocalBounds(SceneNode node, const glm::vec3& min, const glm::vec3& max);
+		void setRenderData(SceneNode node, uint32_t meshIndex, uint32_t materialIndex);
+
+		void update(JobSystem& jobSystem);
+
+		[[nodiscard]] bool isAlive(SceneNode node) const noexcept { return m_pool.isAlive(node); }
+		[[nodiscard]] uint32_t getNodeCount() const noexcept { return m_pool.size(); }
+		[[nodiscard]] SceneNode getNode(uint32_t instanceIndex) const noexcept { return m_pool.getHandle(instanceIndex); }
+		[[nodiscard]] const glm::mat4& getWorldMatrix(SceneNode node) const { return m_instances[m_pool.getDenseIndex(node)].model; }
+		[[nodiscard]] const Aabb& getWorldBounds(SceneNode node) const { return m_worldBounds[m_pool.getDenseIndex(node)]; }
+
+		// indexed by instance index, valid until the next structural change
+		[[nodiscard]] std::span<const InstanceData> getInstanceData() const noexcept { return m_instances; }
+		[[nodiscard]] std::span<const Aabb> getWorldBounds() const noexcept { return m_worldBounds; }
+		// instance indices written by the last update(), for partial uploads
+		[[nodiscard]] std::span<const uint32_t> getChangedInstances() const noexcept { return m_changedInstances; }
+
+	private:
+		static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+		HandlePool<SceneNodeTag> m_pool;
+
+		// local state
+		std::vector<glm::vec3> m_localPositions;
+		std::vector<glm::quat> m_localRotations;
+		std::vector<glm::vec3> m_localScales;
+		std::vector<glm::vec4> m_localBoundsCenters;
+		std::vector<glm::vec4> m_localBoundsExtents;
+
+		// hierarchy, stored as slots
+		std::vector<uint32_t> m_parents;
+		std::vector<uint32_t> m_firstChildren;
+		std::vector<uint32_t> m_nextSiblings;
+		std::vector<uint32_t> m_previousSiblings;
+		std::vector<uint32_t> m_depths;
+
+		// derived state
+		std::vector<InstanceData> m_instances;
+		std::vector<Aabb> m_worldBounds;
+
+		std::vector<uint8_t> m_dirtyFlags;
+		std::vector<uint32_t> m_updateStamps;
+		uint32_t m_updateStamp = 0;
+
+		std::vector<SceneNode> m_dirtyNodes;
+		std::vector<uint32_t> m_modifiedInstances;
+		std::vector<std::vector<uint32_t>> m_depthBuckets;
+		std::vector<uint32_t> m_changedInstances;
+		std::vector<uint32_t> m_traversalStack;
+
+		[[nodiscard]] uint32_t getDenseChecked(SceneNode node) const;
+		[[nodiscard]] uint32_t denseOf(uint32_t slot) const noexcept { return m_pool.getDenseIndexFromSlot(slot); }
+
+		void markDirty(uint32_t dense);
+		void link(uint32_t dense, uint32_t parentSlot) noexcept;
+		void unlink(uint32_t dense) noexcept;
+		void updateDepths(uint32_t slot);
+		void collectSubtree(uint32_t slot);
+		void removeDense(uint32_t dense);
+		void updateNode(uint32_t dense) noexcept;
+	};
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace coldwind {
+	// compiles GLSL with glslang for the device's Vulkan version and the newest SPIR-V it must accept,
+	// errors are logged with the shader's name and thrown
+	[[nodiscard]] std::vector<uint32_t> compileShader(vk::ShaderStageFlagBits stage, std::string_view source, const std::string& name,
+		uint32_t apiVersion);
+}
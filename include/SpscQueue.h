@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace coldwind {
+	/// Bounded lock free queue between exactly one producer and one consumer thread.
+	/// Each side writes only its own index and caches the other one, so a push or pop touches the
+	/// shared cache line only when the cached index says the queue looks full or empty.
+	template<typename T, size_t Capacity>
+	class SpscQueue {
+		static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+		static_assert(std::is_trivially_copyable_v<T>, "SpscQueue copies values without running destructors");
+
+	public:
+		SpscQueue() = default;
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+		~SpscQueue() = default;
+
+		// producer thread, fails instead of waiting when the queue is full
+		[[nodiscard]] bool push(const T& value) noexcept
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_cachedHead == Capacity) {
+				m_cachedHead = m_head.load(std::memory_order_acquire);
+				if (tail - m_cachedHead == Capacity) return false;
+			}
+			m_values[tail & (Capacity - 1)] = value;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer thread
+		[[nodiscard]] bool pop(T& value) noexcept
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_cachedTail) {
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				if (head == m_cachedTail) return false;
+			}
+			value = m_values[head & (Capacity - 1)];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		// the indices only grow, each side's index and cache share a line the other side only reads
+		alignas(64) std::atomic<size_t> m_head{ 0 };
+		size_t m_cachedTail = 0;
+		alignas(64) std::atomic<size_t> m_tail{ 0 };
+		size_t m_cachedHead = 0;
+		alignas(64) std::array<T, Capacity> m_values{};
+	};
+}
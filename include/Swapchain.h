@@ -1,28 +1,55 @@
 #pragma once
-#include "VKContext.h"
+#include "ResourceRegistry.h"
+#include "LinearAllocator.h"
+
+#include <array>
+#include <span>
 
 namespace coldwind {
 	class SwapChain {
 	public:
-		explicit SwapChain(VKContext& context, Window& window);
+		explicit SwapChain(VKContext& context, Window& window, ResourceRegistry& registry);
 		SwapChain(const SwapChain&) = delete;
 		SwapChain& operator=(const SwapChain&) = delete;
-		~SwapChain() = default;
+		~SwapChain();
 
+		// the previous swapchain and its views are retired to the registry, recreation only waits for the present queue
 		void createSwapchain(VKContext& context, Window& window);
 
+		// eErrorOutOfDateKHR and eSuboptimalKHR mark the swapchain for recreation,
+		// signals the frame slot's image available semaphore
+		[[nodiscard]] vk::Result acquireNextImage(VKContext& context, uint32_t frameSlot, uint32_t& imageIndex);
+		// presents the images of all swapchains with a single vkQueuePresentKHR
+		static void present(VKContext& context, std::span<SwapChain* const> swapChains, std::span<const uint32_t> imageIndices,
+			LinearAllocator& scratch);
+		[[nodiscard]] bool isOutOfDate() const noexcept { return m_isOutOfDate; }
+		void markOutOfDate() noexcept { m_isOutOfDate = true; }
+
 		[[nodiscard]] vk::Extent2D getSwapchainExtent2D() const noexcept { return m_swapChainExtent2D; }
 		[[nodiscard]] vk::SurfaceFormatKHR getSurfaceFormat() const noexcept { return m_surfaceFormat; }
 		[[nodiscard]] vk::PresentModeKHR getPresentMode() const noexcept { return m_presentMode; }
+		// eTransferSrc only when the surface supports reading its images back
+		[[nodiscard]] vk::ImageUsageFlags getImageUsage() const noexcept { return m_imageUsage; }
 		[[nodiscard]] auto& getSwapchainImageList() noexcept { return m_swapChainImages; }
 		[[nodiscard]] auto& getSwapchainImageViewList() noexcept { return m_swapChainImageViews; }
+		// the images imported into the registry, so command streams can reference them
+		[[nodiscard]] ImageHandle getSwapchainImageHandle(uint32_t imageIndex) const noexcept { return m_swapChainImageHandles[imageIndex]; }
+		[[nodiscard]] vk::Semaphore getImageAvailableSemaphore(uint32_t frameSlot) const noexcept { return m_imageAvailableSemaphores[frameSlot].get(); }
+		// per image, an image is only acquired again after its previous present consumed the semaphore
+		[[nodiscard]] vk::Semaphore getRenderFinishedSemaphore(uint32_t imageIndex) const noexcept { return m_renderFinishedSemaphores[imageIndex].get(); }
 
 	private:
+		ResourceRegistry& m_registry;
 		vk::Extent2D m_swapChainExtent2D;
 		vk::SurfaceFormatKHR m_surfaceFormat;
+		vk::ImageUsageFlags m_imageUsage;
 		vk::UniqueSwapchainKHR m_swapChain;
 		std::vector<vk::Image> m_swapChainImages;
+		std::vector<ImageHandle> m_swapChainImageHandles;
 		std::vector<vk::UniqueImageView> m_swapChainImageViews;
+		std::vector<vk::UniqueSemaphore> m_renderFinishedSemaphores;
+		std::array<vk::UniqueSemaphore, MAX_FRAMES_IN_FLIGHT> m_imageAvailableSemaphores;
 		vk::PresentModeKHR m_presentMode;
+		bool m_isOutOfDate = false;
 	};
 }
\ No newline at end of file
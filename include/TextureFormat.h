@@ -0,0 +1,77 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+
+namespace coldwind {
+	struct FormatBlockInfo {
+		uint32_t blockWidth = 1;
+		uint32_t blockHeight = 1;
+		uint32_t blockBytes = 4;
+	};
+
+	[[nodiscard]] inline FormatBlockInfo getFormatBlockInfo(vk::Format format) noexcept
+	{
+		switch (format) {
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbSrgbBlock:
+		case vk::Format::eBc1RgbaUnormBlock:
+		case vk::Format::eBc1RgbaSrgbBlock:
+		case vk::Format::eBc4UnormBlock:
+		case vk::Format::eBc4SnormBlock:
+			return { 4, 4, 8 };
+		case vk::Format::eBc2UnormBlock:
+		case vk::Format::eBc2SrgbBlock:
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+		case vk::Format::eBc5UnormBlock:
+		case vk::Format::eBc5SnormBlock:
+		case vk::Format::eBc6HUfloatBlock:
+		case vk::Format::eBc6HSfloatBlock:
+		case vk::Format::eBc7UnormBlock:
+		case vk::Format::eBc7SrgbBlock:
+		case vk::Format::eAstc4x4UnormBlock:
+		case vk::Format::eAstc4x4SrgbBlock:
+			return { 4, 4, 16 };
+		case vk::Format::eEtc2R8G8B8UnormBlock:
+		case vk::Format::eEtc2R8G8B8SrgbBlock:
+			return { 4, 4, 8 };
+		case vk::Format::eEtc2R8G8B8A8UnormBlock:
+		case vk::Format::eEtc2R8G8B8A8SrgbBlock:
+			return { 4, 4, 16 };
+		case vk::Format::eR8Unorm:
+			return { 1, 1, 1 };
+		case vk::Format::eR8G8Unorm:
+			return { 1, 1, 2 };
+		case vk::Format::eR16G16B16A16Sfloat:
+			return { 1, 1, 8 };
+		default:
+			return { 1, 1, 4 };
+		}
+	}
+
+	[[nodiscard]] inline bool isBlockCompressedFormat(vk::Format format) noexcept
+	{
+		return getFormatBlockInfo(format).blockWidth > 1;
+	}
+
+	[[nodiscard]] inline uint32_t getMipExtent(uint32_t extent, uint32_t mipLevel) noexcept
+	{
+		return std::max(1u, extent >> mipLevel);
+	}
+
+	[[nodiscard]] inline uint32_t getMipLevelCount(uint32_t width, uint32_t height) noexcept
+	{
+		uint32_t levels = 1;
+		for (uint32_t extent = std::max(width, height); extent > 1; extent >>= 1) ++levels;
+		return levels;
+	}
+
+	[[nodiscard]] inline vk::DeviceSize getMipByteSize(vk::Format format, uint32_t width, uint32_t height) noexcept
+	{
+		const FormatBlockInfo block = getFormatBlockInfo(format);
+		const vk::DeviceSize blocksX = (width + block.blockWidth - 1) / block.blockWidth;
+		const vk::DeviceSize blocksY = (height + block.blockHeight - 1) / block.blockHeight;
+		return blocksX * blocksY * block.blockBytes;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "TextureStreamer.h"
+#include "TextureTranscoder.h"
+
+#include <string>
+
+namespace coldwind {
+	/// Opens KTX2 textures and registers them with the streamer.
+	/// The device format is chosen once per texture, mips are read and transcoded
+	/// on demand when the streamer asks for them.
+	class TextureLoader {
+	public:
+		explicit TextureLoader(VKContext& context, JobSystem& jobSystem, TextureStreamer& streamer);
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+		~TextureLoader() = default;
+
+		[[nodiscard]] StreamedTextureId loadKtx2(const std::string& path, uint32_t baseResidentMips = 4);
+
+		[[nodiscard]] TextureTranscoder& getTranscoder() noexcept { return m_transcoder; }
+
+	private:
+		VKContext& m_context;
+		TextureStreamer& m_streamer;
+		TextureTranscoder m_transcoder;
+	};
+}
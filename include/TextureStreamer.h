@@ -0,0 +1,169 @@
+#pragma once
+#include "ResourceRegistry.h"
+#include "TextureFormat.h"
+#include "JobSystem.h"
+
+#include <array>
+#include <functional>
+#include <list>
+
+namespace coldwind {
+	using StreamedTextureId = uint32_t;
+	static const StreamedTextureId INVALID_STREAMED_TEXTURE = UINT32_MAX;
+
+	struct StreamedTextureCreateInfo {
+		vk::Format format = vk::Format::eR8G8B8A8Unorm;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		// count of the smallest mips uploaded on creation, they are never evicted
+		uint32_t baseResidentMips = 4;
+		// writes the texels of mipLevel to dst, dst holds exactly getMipByteSize() bytes,
+		// called on a job system worker, never concurrently for the same texture
+		std::function<bool(uint32_t mipLevel, void* dst, vk::DeviceSize size)> loadMip;
+	};
+
+	struct TextureStreamerStats {
+		vk::DeviceSize committedBytes = 0;
+		vk::DeviceSize budgetBytes = 0;
+		uint32_t residentTextures = 0;
+		uint32_t uploadsThisFrame = 0;
+		uint32_t evictionsThisFrame = 0;
+		vk::DeviceSize uploadedBytesThisFrame = 0;
+	};
+
+	/// Streams mip levels of large textures on demand.
+	/// Only the base (smallest) mips are uploaded on creation, finer mips are uploaded once the
+	/// renderer reports it samples them, either through the GPU feedback buffer or requestMip().
+	/// Every residency change reallocates the image with exactly the resident mip range on the transfer
+	/// queue: levels both images share are copied from the old image on the GPU, only newly added levels
+	/// are read from disk, on background jobs, and uploaded once a later update() finds them loaded.
+	/// The old image is released once no frame in flight can sample it through the resource registry.
+	/// Under memory pressure the least recently used textures lose their finest mip, which needs no disk access.
+	/// Images stay in vk::ImageLayout::eGeneral, so the transfer queue can read them while frames sample them.
+	/// They live in the resource registry and a completed upload is noted as a write, so frame captures include them.
+	class TextureStreamer {
+	public:
+		explicit TextureStreamer(VKContext& context, ResourceRegistry& registry, JobSystem& jobSystem,
+			uint32_t maxTextures = 4096, vk::DeviceSize stagingSize = 64ull << 20);
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		~TextureStreamer();
+
+		[[nodiscard]] StreamedTextureId createTexture(StreamedTextureCreateInfo createInfo);
+		void destroyTexture(StreamedTextureId id);
+
+		// screen space estimate path, the finest request of a frame wins
+		void requestMip(StreamedTextureId id, uint32_t mipLevel) noexcept;
+		[[nodiscard]] static uint32_t estimateMipLevel(uint32_t width, uint32_t height, float screenWidth, float screenHeight) noexcept;
+
+		// must be called once per frame after the fence of frameNumber's frame slot has signaled
+		// and the registry's beginFrame(), replaced images are retired with the current frame
+		void update(uint64_t frameNumber);
+
+		// null until the base mips are uploaded, the view covers mips [getResidentMip(), mipLevels), sampled in eGeneral
+		[[nodiscard]] vk::ImageView getImageView(StreamedTextureId id) const noexcept;
+		[[nodiscard]] uint32_t getResidentMip(StreamedTextureId id) const noexcept;
+
+		// one uint per texture id, shaders atomicMin() the sampled full-chain mip level into it
+		[[nodiscard]] vk::Buffer getFeedbackBuffer(uint32_t frameSlot) const noexcept { return m_feedback[frameSlot].buffer; }
+		[[nodiscard]] vk::DeviceSize getFeedbackBufferSize() const noexcept { return m_maxTextures * sizeof(uint32_t); }
+
+		void setMemoryBudget(vk::DeviceSize budget) noexcept { m_stats.budgetBytes = budget; }
+		[[nodiscard]] const TextureStreamerStats& getStats() const noexcept { return m_stats; }
+
+	private:
+		struct TextureImage {
+			ImageHandle image;
+			vk::UniqueImageView view;
+			vk::DeviceSize bytes = 0;
+			uint32_t topMip = 0;
+		};
+
+		struct StreamedTexture {
+			StreamedTextureCreateInfo info;
+			TextureImage resident;
+			TextureImage pending;
+			bool hasPending = false;
+			bool alive = false;
+			uint32_t baseMip = 0;
+			uint32_t requestedMip = UINT32_MAX;
+			uint64_t lastRequestedFrame = 0;
+			std::list<StreamedTextureId>::iterator lruIter;
+		};
+
+		struct HostBuffer {
+			vk::Buffer buffer;
+			VmaAllocation allocation = nullptr;
+			uint8_t* mapped = nullptr;
+		};
+
+		// one texture moving from its resident image to its pending one
+		struct Upload {
+			StreamedTextureId id = INVALID_STREAMED_TEXTURE;
+			// mips [loadBegin, loadEnd) are read from disk, the rest is copied from the resident image
+			uint32_t loadBegin = 0;
+			uint32_t loadEnd = 0;
+			vk::DeviceSize stagingOffset = 0;
+			// written by the load job, read once the batch's load counter dropped to zero
+			bool isLoaded = false;
+		};
+
+		struct TransferBatch {
+			vk::CommandBuffer commandBuffer;
+			vk::UniqueFence fence;
+			vk::DeviceSize stagingBegin = 0;
+			vk::DeviceSize stagingOffset = 0;
+			// the load jobs of the batch are running, it is recorded and submitted once they finished
+			bool isLoading = false;
+			bool submitted = false;
+			JobCounter loads;
+			// reserved for every texture, the load jobs point into it
+			std::vector<Upload> uploads;
+		};
+
+		VKContext& m_context;
+		ResourceRegistry& m_registry;
+		JobSystem& m_jobSystem;
+		uint32_t m_maxTextures;
+		vk::DeviceSize m_stagingSlotSize;
+		uint64_t m_frameNumber = 0;
+
+		std::vector<StreamedTexture> m_textures;
+		std::vector<StreamedTextureId> m_freeIds;
+		// front is most recently requested
+		std::list<StreamedTextureId> m_lru;
+
+		HostBuffer m_staging;
+		std::array<HostBuffer, MAX_FRAMES_IN_FLIGHT> m_feedback;
+		vk::UniqueCommandPool m_commandPool;
+		std::array<TransferBatch, MAX_FRAMES_IN_FLIGHT> m_batches;
+		uint32_t m_batchIndex = 0;
+		std::vector<StreamedTextureId> m_candidates;
+
+		TextureStreamerStats m_stats;
+
+		void createHostBuffer(HostBuffer& hostBuffer, vk::DeviceSize size, vk::BufferUsageFlags usage);
+		void destroyHostBuffer(HostBuffer& hostBuffer) noexcept;
+		void destroyImage(TextureImage& image);
+		void retireImage(TextureImage& image);
+
+		void readFeedback(uint32_t frameSlot);
+		void completeUploads();
+		[[nodiscard]] TransferBatch* acquireBatch();
+		// records and submits the loading batch once its load jobs finished
+		void submitLoadedBatch();
+		void recordUpload(TransferBatch& batch, const Upload& upload);
+		// drops the pending image of an upload that can not complete
+		void abandonUpload(const Upload& upload);
+
+		// staging and memory size of mips [beginMip, endMip)
+		[[nodiscard]] vk::DeviceSize getLevelBytes(const StreamedTextureCreateInfo& info, uint32_t beginMip, uint32_t endMip) const noexcept;
+		[[nodiscard]] vk::DeviceSize getImageBytes(const StreamedTextureCreateInfo& info, uint32_t topMip) const noexcept
+		{
+			return getLevelBytes(info, topMip, info.mipLevels);
+		}
+		[[nodiscard]] bool scheduleReallocation(StreamedTextureId id, uint32_t topMip, TransferBatch& batch);
+		bool evictFor(vk::DeviceSize bytesNeeded, StreamedTextureId requester, TransferBatch& batch);
+	};
+}
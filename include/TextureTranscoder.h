@@ -0,0 +1,34 @@
+#pragma once
+#include "JobSystem.h"
+#include "TextureFormat.h"
+
+namespace coldwind {
+	/// Converts texture levels between RGBA8 and the BC1/BC3 block formats.
+	/// RGBA8 -> BC encoding is used at load time when the device samples BC but the texture
+	/// was shipped uncompressed, and offline by the texture baker. BC -> RGBA8 decoding is the
+	/// fallback for devices without BC support. Block rows are spread over the job system.
+	class TextureTranscoder {
+	public:
+		explicit TextureTranscoder(JobSystem& jobSystem);
+		TextureTranscoder(const TextureTranscoder&) = delete;
+		TextureTranscoder& operator=(const TextureTranscoder&) = delete;
+		~TextureTranscoder() = default;
+
+		// best format the device can sample for data stored as sourceFormat, eUndefined if none
+		[[nodiscard]] static vk::Format selectTargetFormat(vk::PhysicalDevice physicalDevice, vk::Format sourceFormat, bool hasAlpha);
+		[[nodiscard]] static bool canTranscode(vk::Format sourceFormat, vk::Format targetFormat) noexcept;
+		[[nodiscard]] static bool hasAlpha(const uint8_t* rgba, size_t pixelCount) noexcept;
+		[[nodiscard]] static bool isSimdSupported() noexcept;
+
+		bool transcode(const uint8_t* src, vk::Format sourceFormat, uint8_t* dst, vk::Format targetFormat,
+			uint32_t width, uint32_t height);
+
+		// the scalar kernels produce identical blocks, disabling SIMD is only useful for benchmarks
+		void setSimdEnabled(bool enabled) noexcept { m_simdEnabled = enabled && isSimdSupported(); }
+		[[nodiscard]] bool isSimdEnabled() const noexcept { return m_simdEnabled; }
+
+	private:
+		JobSystem& m_jobSystem;
+		bool m_simdEnabled;
+	};
+}
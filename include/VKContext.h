@@ -9,10 +9,30 @@
 
 namespace coldwind
 {
+	/// Optional device features negotiated through the PhysicalDeviceFeatures2 chain, every one that is true
+	/// is enabled on the device. Subsystems check these at runtime to pick their fast paths.
+	struct DeviceCapabilities {
+		// the device's version capped to the instance's
+		uint32_t apiVersion = 0;
+		bool timelineSemaphore = false;
+		bool synchronization2 = false;
+		bool dynamicRendering = false;
+		bool bufferDeviceAddress = false;
+		// runtime sized, partially bound and update after bind sampled image arrays with non-uniform indexing
+		bool descriptorIndexing = false;
+		bool memoryBudget = false;
+		bool memoryPriority = false;
+		// the driver may page device local memory out under pressure instead of failing allocations
+		bool pageableDeviceLocalMemory = false;
+		bool samplerAnisotropy = false;
+	};
+
 	class VKContext
 	{
 	public:
 		VKContext(Instance& instance, Window& window);
+		// headless device without swapchain support, the present queue is the graphics queue
+		explicit VKContext(Instance& instance);
 		VKContext(const VKContext&) = delete;
 		VKContext& operator=(const VKContext&) = delete;
 		~VKContext();
@@ -22,10 +42,22 @@ namespace coldwind
 
 		[[nodiscard]] uint32_t getGraphicQueueFamilyIndex() const noexcept { return m_graphicsAndComputeQueueFamilyIndex; }
 		[[nodiscard]] uint32_t getPresentQueueFamilyIndex() const noexcept { return m_presentQueueFamilyIndex; }
+		[[nodiscard]] uint32_t getTransferQueueFamilyIndex() const noexcept { return m_transferQueueFamilyIndex; }
+		[[nodiscard]] vk::Queue getGraphicsQueue() const noexcept { return m_graphicsAndComputeQueue; }
+		[[nodiscard]] vk::Queue getPresentQueue() const noexcept { return m_presentQueue; }
+		[[nodiscard]] vk::Queue getTransferQueue() const noexcept { return m_transferQueue; }
 		[[nodiscard]] VmaAllocator& getVmaAllocator() noexcept { return m_vmaAllocator; }
+		[[nodiscard]] bool isHeadless() const noexcept { return m_isHeadless; }
+		[[nodiscard]] const DeviceCapabilities& getCapabilities() const noexcept { return m_capabilities; }
+		// through the core or the KHR entry point, only with DeviceCapabilities::timelineSemaphore
+		[[nodiscard]] uint64_t getSemaphoreCounterValue(vk::Semaphore semaphore) const;
+
+		// sum of budget/usage over all device local heaps, as reported by VMA
+		[[nodiscard]] vk::DeviceSize getDeviceLocalBudget() const noexcept;
+		[[nodiscard]] vk::DeviceSize getDeviceLocalUsage() const noexcept;
 
 	private:
-		void init(Instance& instance, Window& window)
+		void init(Instance& instance, Window* window)
 		{
 			selectPhysicalDevice(instance, window);
 			createDevice();
@@ -34,11 +66,14 @@ namespace coldwind
 
 	private:
 
+		bool m_isHeadless = false;
 		vk::PhysicalDevice m_physicalDevice;
 		uint32_t m_graphicsAndComputeQueueFamilyIndex = 0;
 		uint32_t m_presentQueueFamilyIndex = 0;
-		void selectPhysicalDevice(Instance& instance, Window& window);
-		void checkDeviceExtensionSupport(vk::PhysicalDevice, std::map<const char*, uint8_t>&);
+		uint32_t m_transferQueueFamilyIndex = 0;
+		DeviceCapabilities m_capabilities;
+		std::vector<const char*> m_deviceExtensions;
+		void selectPhysicalDevice(Instance& instance, Window* window);
 		const char* getDeviceTypeString(vk::PhysicalDeviceType deviceType) const noexcept
 		{
 			if (deviceType == vk::PhysicalDeviceType::eDiscreteGpu) return "Discrete GPU";
@@ -47,11 +82,14 @@ namespace coldwind
 			if (deviceType == vk::PhysicalDeviceType::eCpu) return "CPU";
 			return "unknow device type";
 		}
-		uint64_t getDeviceScore(const vk::PhysicalDeviceProperties& deviceProperties) const noexcept;
+		uint64_t getDeviceScore(const vk::PhysicalDeviceProperties& deviceProperties, const DeviceCapabilities& capabilities,
+			const vk::PhysicalDeviceMemoryProperties& memoryProperties) const noexcept;
 
 		vk::UniqueDevice m_device;
 		vk::Queue m_graphicsAndComputeQueue;
 		vk::Queue m_presentQueue;
+		vk::Queue m_transferQueue;
+		PFN_vkGetSemaphoreCounterValue m_getSemaphoreCounterValue = nullptr;
 		void createDevice();
 
 		VmaAllocator m_vmaAllocator;
@@ -3,6 +3,8 @@
 
 #include <glfw/glfw3.h>
 
+#include <atomic>
+
 namespace coldwind {
 	class Window {
 	public:
@@ -23,12 +25,17 @@ namespace coldwind {
 		[[nodiscard]] inline GLFWwindow* getWindowPtr() const noexcept { return m_window; }
 		[[nodiscard]] vk::UniqueSurfaceKHR& getSurface() noexcept { return m_surface; }
 
+		// the framebuffer extent is cached, so the render thread can read it while the main thread owns GLFW
 		[[nodiscard]] vk::Extent2D getWindowExtent2D() const noexcept;
 		[[nodiscard]] bool isMinimized() const noexcept;
+		// main thread, from the framebuffer size callback
+		void setFramebufferExtent(uint32_t width, uint32_t height) noexcept;
 
 	private:
 		std::string m_title;
 		GLFWwindow* m_window = nullptr;
+		// width in the high half, height in the low half
+		std::atomic<uint64_t> m_framebufferExtent{ 0 };
 
 		void initWindow(uint32_t width, uint32_t height);
 		void destroyWindow();
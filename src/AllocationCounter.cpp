@@ -0,0 +1,94 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace coldwind {
+	namespace {
+		std::atomic<uint64_t> g_heapAllocationCount{ 0 };
+	}
+
+	uint64_t getHeapAllocationCount() noexcept
+	{
+		return g_heapAllocationCount.load(std::memory_order_relaxed);
+	}
+}
+
+#ifndef NDEBUG
+namespace {
+	void* countedAllocate(std::size_t size) noexcept
+	{
+		coldwind::g_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+	void* countedAllocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+	{
+		coldwind::g_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		const auto align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+		return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+		// aligned_alloc requires the size to be a multiple of the alignment, a zero size may return null
+		return std::aligned_alloc(align, size == 0 ? align : (size + align - 1) / align * align);
+#endif
+	}
+
+	void freeAligned(void* pointer) noexcept
+	{
+#ifdef _WIN32
+		_aligned_free(pointer);
+#else
+		std::free(pointer);
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	void* pointer = countedAllocate(size);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+	void* pointer = countedAllocate(size);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* pointer = countedAllocateAligned(size, alignment);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	void* pointer = countedAllocateAligned(size, alignment);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocateAligned(size, alignment); }
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(pointer); }
+#endif
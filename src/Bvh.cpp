@@ -0,0 +1,616 @@
+#include "Bvh.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLDWIND_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace coldwind {
+	namespace {
+		constexpr uint32_t BIN_COUNT = 16;
+		constexpr uint32_t PARALLEL_BUILD_THRESHOLD = 4096;
+
+		inline Aabb makeEmptyAabb() noexcept
+		{
+			return Aabb{ glm::vec4(FLT_MAX), glm::vec4(-FLT_MAX) };
+		}
+
+		inline void grow(Aabb& bounds, const Aabb& other) noexcept
+		{
+			bounds.min = glm::min(bounds.min, other.min);
+			bounds.max = glm::max(bounds.max, other.max);
+		}
+
+		inline void grow(Aabb& bounds, const glm::vec4& point) noexcept
+		{
+			bounds.min = glm::min(bounds.min, point);
+			bounds.max = glm::max(bounds.max, point);
+		}
+
+		inline float halfSurfaceArea(const Aabb& bounds) noexcept
+		{
+			const glm::vec4 extent = bounds.max - bounds.min;
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+
+		inline bool isOutside(const Frustum& frustum, const Aabb& bounds) noexcept
+		{
+			for (const auto& plane : frustum.planes) {
+				const float x = plane.x >= 0.0f ? bounds.max.x : bounds.min.x;
+				const float y = plane.y >= 0.0f ? bounds.max.y : bounds.min.y;
+				const float z = plane.z >= 0.0f ? bounds.max.z : bounds.min.z;
+				if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) return true;
+			}
+			return false;
+		}
+
+		inline bool overlaps(const Aabb& a, const Aabb& b) noexcept
+		{
+			return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+				a.min.y <= b.max.y && a.max.y >= b.min.y &&
+				a.min.z <= b.max.z && a.max.z >= b.min.z;
+		}
+
+		inline float squaredDistance(const Aabb& bounds, const glm::vec3& point) noexcept
+		{
+			const float dx = std::max(std::max(bounds.min.x - point.x, point.x - bounds.max.x), 0.0f);
+			const float dy = std::max(std::max(bounds.min.y - point.y, point.y - bounds.max.y), 0.0f);
+			const float dz = std::max(std::max(bounds.min.z - point.z, point.z - bounds.max.z), 0.0f);
+			return dx * dx + dy * dy + dz * dz;
+		}
+
+		inline bool intersectRay(const Aabb& bounds, const glm::vec3& origin, const glm::vec3& inverseDirection,
+			float maxDistance, float& distance) noexcept
+		{
+			float tMin = 0.0f;
+			float tMax = maxDistance;
+			for (int axis = 0; axis < 3; ++axis) {
+				const float t1 = (bounds.min[axis] - origin[axis]) * inverseDirection[axis];
+				const float t2 = (bounds.max[axis] - origin[axis]) * inverseDirection[axis];
+				tMin = std::max(tMin, std::min(t1, t2));
+				tMax = std::min(tMax, std::max(t1, t2));
+			}
+			distance = tMin;
+			return tMin <= tMax;
+		}
+	}
+
+	Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection) noexcept
+	{
+		// Gribb/Hartmann plane extraction, Vulkan clip space depth is [0, w]
+		const auto row = [&viewProjection](int i) {
+			return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		};
+
+		Frustum frustum;
+		frustum.planes[0] = row(3) + row(0);
+		frustum.planes[1] = row(3) - row(0);
+		frustum.planes[2] = row(3) + row(1);
+		frustum.planes[3] = row(3) - row(1);
+		frustum.planes[4] = row(2);
+		frustum.planes[5] = row(3) - row(2);
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	void Bvh::build(std::span<const Aabb> objectBounds, JobSystem& jobSystem)
+	{
+		const uint32_t objectCount = static_cast<uint32_t>(objectBounds.size());
+		m_objectBounds.assign(objectBounds.begin(), objectBounds.end());
+		m_objectCentroids.resize(objectCount);
+		m_leafObjects.resize(objectCount);
+		m_objectLeaves.assign(objectCount, EMPTY_CHILD);
+		m_dirtyObjects.clear();
+		m_movedSinceBuild = 0;
+
+		jobSystem.parallelFor(objectCount, 16384, [this](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				m_objectCentroids[i] = m_objectBounds[i].getCenter();
+				m_leafObjects[i] = i;
+			}
+		});
+
+		// every inner node splits its range at least once, so there are fewer inner nodes than objects
+		m_nodes.resize(static_cast<size_t>(objectCount) + 1);
+		m_nodeAllocator.store(1, std::memory_order_relaxed);
+		m_nodeCount = 0;
+		if (objectCount == 0) return;
+
+		JobCounter counter;
+		const BuildRange root{ 0, objectCount, computeRangeBounds(0, objectCount) };
+		buildNode(0, EMPTY_CHILD, 0, 0, root, jobSystem, counter);
+		jobSystem.wait(counter);
+
+		m_nodeCount = m_nodeAllocator.load(std::memory_order_acquire);
+		m_refitStamps.assign(m_nodeCount, 0);
+		m_refitStamp = 0;
+		spdlog::debug("Built BVH over {} objects with {} nodes", objectCount, m_nodeCount);
+	}
+
+	void Bvh::updateObject(uint32_t object, const Aabb& bounds)
+	{
+		if (object >= m_objectBounds.size()) return;
+		m_objectBounds[object] = bounds;
+		m_dirtyObjects.push_back(object);
+	}
+
+	void Bvh::refit()
+	{
+		if (m_dirtyObjects.empty()) return;
+
+		++m_refitStamp;
+		m_refitHeap.clear();
+		for (const uint32_t object : m_dirtyObjects) {
+			const uint32_t leaf = m_objectLeaves[object];
+			Node& node = m_nodes[leaf >> 2];
+			const uint32_t slot = leaf & 3;
+			const uint32_t first = node.children[slot] & ~LEAF_FLAG;
+			setChildBounds(node, slot, computeRangeBounds(first, first + node.objectCounts[slot]));
+			markRefit(leaf >> 2);
+		}
+		m_movedSinceBuild += static_cast<uint32_t>(m_dirtyObjects.size());
+		m_dirtyObjects.clear();
+
+		// children always have larger indices than their parent, highest index first is bottom up
+		while (!m_refitHeap.empty()) {
+			std::pop_heap(m_refitHeap.begin(), m_refitHeap.end());
+			const uint32_t nodeIndex = m_refitHeap.back();
+			m_refitHeap.pop_back();
+
+			const Node& node = m_nodes[nodeIndex];
+			if (node.parent == EMPTY_CHILD) continue;
+			setChildBounds(m_nodes[node.parent], node.parentSlot, getNodeBounds(nodeIndex));
+			markRefit(node.parent);
+		}
+	}
+
+	void Bvh::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+	{
+		if (m_nodeCount == 0) return;
+
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		// nodes fully inside the frustum are flagged and their subtree is appended without tests
+		constexpr uint32_t INSIDE_FLAG = 0x80000000u;
+
+		while (stackSize > 0) {
+			const uint32_t entry = stack[--stackSize];
+			const Node& node = m_nodes[entry & ~INSIDE_FLAG];
+			const bool parentInside = (entry & INSIDE_FLAG) != 0;
+
+			uint32_t outsideMask = 0;
+			uint32_t intersectMask = 0;
+			if (!parentInside) {
+#ifdef COLDWIND_SSE2
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 minX = _mm_load_ps(node.minX);
+				const __m128 minY = _mm_load_ps(node.minY);
+				const __m128 minZ = _mm_load_ps(node.minZ);
+				const __m128 maxX = _mm_load_ps(node.maxX);
+				const __m128 maxY = _mm_load_ps(node.maxY);
+				const __m128 maxZ = _mm_load_ps(node.maxZ);
+				__m128 outside = zero;
+				__m128 intersect = zero;
+				for (const auto& plane : frustum.planes) {
+					// the corner farthest along the normal decides outside, the nearest decides fully inside
+					const __m128 farDistance = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(plane.x), plane.x >= 0.0f ? maxX : minX),
+						_mm_mul_ps(_mm_set1_ps(plane.y), plane.y >= 0.0f ? maxY : minY)), _mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(plane.z), plane.z >= 0.0f ? maxZ : minZ), _mm_set1_ps(plane.w)));
+					const __m128 nearDistance = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(plane.x), plane.x >= 0.0f ? minX : maxX),
+						_mm_mul_ps(_mm_set1_ps(plane.y), plane.y >= 0.0f ? minY : maxY)), _mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(plane.z), plane.z >= 0.0f ? minZ : maxZ), _mm_set1_ps(plane.w)));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+					intersect = _mm_or_ps(intersect, _mm_cmplt_ps(nearDistance, zero));
+				}
+				outsideMask = static_cast<uint32_t>(_mm_movemask_ps(outside));
+				intersectMask = static_cast<uint32_t>(_mm_movemask_ps(intersect));
+#else
+				for (uint32_t slot = 0; slot < 4; ++slot) {
+					for (const auto& plane : frustum.planes) {
+						const float farDistance = plane.x * (plane.x >= 0.0f ? node.maxX[slot] : node.minX[slot]) +
+							plane.y * (plane.y >= 0.0f ? node.maxY[slot] : node.minY[slot]) +
+							plane.z * (plane.z >= 0.0f ? node.maxZ[slot] : node.minZ[slot]) + plane.w;
+						const float nearDistance = plane.x * (plane.x >= 0.0f ? node.minX[slot] : node.maxX[slot]) +
+							plane.y * (plane.y >= 0.0f ? node.minY[slot] : node.maxY[slot]) +
+							plane.z * (plane.z >= 0.0f ? node.minZ[slot] : node.maxZ[slot]) + plane.w;
+						if (farDistance < 0.0f) outsideMask |= 1u << slot;
+						if (nearDistance < 0.0f) intersectMask |= 1u << slot;
+					}
+				}
+#endif
+			}
+
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const uint32_t child = node.children[slot];
+				if (child == EMPTY_CHILD || (outsideMask & (1u << slot))) continue;
+
+				const bool inside = parentInside || !(intersectMask & (1u << slot));
+				if (child & LEAF_FLAG) {
+					const uint32_t first = child & ~LEAF_FLAG;
+					for (uint32_t i = first; i < first + node.objectCounts[slot]; ++i) {
+						const uint32_t object = m_leafObjects[i];
+						if (inside || !isOutside(frustum, m_objectBounds[object])) result.push_back(object);
+					}
+				}
+				else {
+					assert(stackSize < MAX_STACK_DEPTH);
+					stack[stackSize++] = inside ? (child | INSIDE_FLAG) : child;
+				}
+			}
+		}
+	}
+
+	void Bvh::queryAabb(const Aabb& bounds, std::vector<uint32_t>& result) const
+	{
+		if (m_nodeCount == 0) return;
+
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const Node& node = m_nodes[stack[--stackSize]];
+
+#ifdef COLDWIND_SSE2
+			__m128 separated = _mm_or_ps(
+				_mm_cmpgt_ps(_mm_load_ps(node.minX), _mm_set1_ps(bounds.max.x)),
+				_mm_cmplt_ps(_mm_load_ps(node.maxX), _mm_set1_ps(bounds.min.x)));
+			separated = _mm_or_ps(separated, _mm_or_ps(
+				_mm_cmpgt_ps(_mm_load_ps(node.minY), _mm_set1_ps(bounds.max.y)),
+				_mm_cmplt_ps(_mm_load_ps(node.maxY), _mm_set1_ps(bounds.min.y))));
+			separated = _mm_or_ps(separated, _mm_or_ps(
+				_mm_cmpgt_ps(_mm_load_ps(node.minZ), _mm_set1_ps(bounds.max.z)),
+				_mm_cmplt_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(bounds.min.z))));
+			const uint32_t hitMask = ~static_cast<uint32_t>(_mm_movemask_ps(separated)) & 0xF;
+#else
+			uint32_t hitMask = 0;
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				if (node.minX[slot] <= bounds.max.x && node.maxX[slot] >= bounds.min.x &&
+					node.minY[slot] <= bounds.max.y && node.maxY[slot] >= bounds.min.y &&
+					node.minZ[slot] <= bounds.max.z && node.maxZ[slot] >= bounds.min.z) {
+					hitMask |= 1u << slot;
+				}
+			}
+#endif
+
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const uint32_t child = node.children[slot];
+				if (child == EMPTY_CHILD || !(hitMask & (1u << slot))) continue;
+				if (child & LEAF_FLAG) {
+					const uint32_t first = child & ~LEAF_FLAG;
+					for (uint32_t i = first; i < first + node.objectCounts[slot]; ++i) {
+						if (overlaps(m_objectBounds[m_leafObjects[i]], bounds)) result.push_back(m_leafObjects[i]);
+					}
+				}
+				else {
+					assert(stackSize < MAX_STACK_DEPTH);
+					stack[stackSize++] = child;
+				}
+			}
+		}
+	}
+
+	void Bvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const
+	{
+		if (m_nodeCount == 0) return;
+
+		const float radiusSquared = radius * radius;
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const Node& node = m_nodes[stack[--stackSize]];
+
+#ifdef COLDWIND_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 centerX = _mm_set1_ps(center.x);
+			const __m128 centerY = _mm_set1_ps(center.y);
+			const __m128 centerZ = _mm_set1_ps(center.z);
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minX), centerX), _mm_sub_ps(centerX, _mm_load_ps(node.maxX))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minY), centerY), _mm_sub_ps(centerY, _mm_load_ps(node.maxY))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minZ), centerZ), _mm_sub_ps(centerZ, _mm_load_ps(node.maxZ))), zero);
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			const uint32_t hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radiusSquared))));
+#else
+			uint32_t hitMask = 0;
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const float dx = std::max(std::max(node.minX[slot] - center.x, center.x - node.maxX[slot]), 0.0f);
+				const float dy = std::max(std::max(node.minY[slot] - center.y, center.y - node.maxY[slot]), 0.0f);
+				const float dz = std::max(std::max(node.minZ[slot] - center.z, center.z - node.maxZ[slot]), 0.0f);
+				if (dx * dx + dy * dy + dz * dz <= radiusSquared) hitMask |= 1u << slot;
+			}
+#endif
+
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const uint32_t child = node.children[slot];
+				if (child == EMPTY_CHILD || !(hitMask & (1u << slot))) continue;
+				if (child & LEAF_FLAG) {
+					const uint32_t first = child & ~LEAF_FLAG;
+					for (uint32_t i = first; i < first + node.objectCounts[slot]; ++i) {
+						if (squaredDistance(m_objectBounds[m_leafObjects[i]], center) <= radiusSquared) result.push_back(m_leafObjects[i]);
+					}
+				}
+				else {
+					assert(stackSize < MAX_STACK_DEPTH);
+					stack[stackSize++] = child;
+				}
+			}
+		}
+	}
+
+	RayHit Bvh::raycast(const Ray& ray, float maxDistance, const std::function<bool(uint32_t object, float& distance)>& intersect) const
+	{
+		RayHit hit;
+		hit.distance = maxDistance;
+		if (m_nodeCount == 0) return hit;
+
+		const glm::vec3 inverseDirection = 1.0f / ray.direction;
+		struct StackEntry {
+			uint32_t node;
+			float distance;
+		};
+		StackEntry stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+
+		while (stackSize > 0) {
+			const StackEntry entry = stack[--stackSize];
+			if (entry.distance > hit.distance) continue;
+			const Node& node = m_nodes[entry.node];
+
+			alignas(16) float nearDistances[4];
+			uint32_t hitMask = 0;
+#ifdef COLDWIND_SSE2
+			const __m128 originX = _mm_set1_ps(ray.origin.x);
+			const __m128 originY = _mm_set1_ps(ray.origin.y);
+			const __m128 originZ = _mm_set1_ps(ray.origin.z);
+			const __m128 inverseX = _mm_set1_ps(inverseDirection.x);
+			const __m128 inverseY = _mm_set1_ps(inverseDirection.y);
+			const __m128 inverseZ = _mm_set1_ps(inverseDirection.z);
+			const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), originX), inverseX);
+			const __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), originX), inverseX);
+			const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), originY), inverseY);
+			const __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), originY), inverseY);
+			const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), originZ), inverseZ);
+			const __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), originZ), inverseZ);
+			const __m128 tMin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)),
+				_mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+			const __m128 tMax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)),
+				_mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(hit.distance)));
+			hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tMin, tMax)));
+			_mm_store_ps(nearDistances, tMin);
+#else
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const Aabb bounds{ glm::vec4(node.minX[slot], node.minY[slot], node.minZ[slot], 0.0f),
+					glm::vec4(node.maxX[slot], node.maxY[slot], node.maxZ[slot], 0.0f) };
+				if (intersectRay(bounds, ray.origin, inverseDirection, hit.distance, nearDistances[slot])) hitMask |= 1u << slot;
+			}
+#endif
+
+			// push far children first so the nearest one is traversed next
+			uint32_t order[4];
+			uint32_t orderCount = 0;
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				const uint32_t child = node.children[slot];
+				if (child == EMPTY_CHILD || !(hitMask & (1u << slot))) continue;
+
+				if (child & LEAF_FLAG) {
+					const uint32_t first = child & ~LEAF_FLAG;
+					for (uint32_t i = first; i < first + node.objectCounts[slot]; ++i) {
+						const uint32_t object = m_leafObjects[i];
+						float distance;
+						if (!intersectRay(m_objectBounds[object], ray.origin, inverseDirection, hit.distance, distance)) continue;
+						if (intersect && (!intersect(object, distance) || distance > hit.distance)) continue;
+						hit.object = object;
+						hit.distance = distance;
+					}
+				}
+				else {
+					order[orderCount++] = slot;
+				}
+			}
+			for (uint32_t i = 1; i < orderCount; ++i) {
+				for (uint32_t j = i; j > 0 && nearDistances[order[j - 1]] < nearDistances[order[j]]; --j) {
+					std::swap(order[j - 1], order[j]);
+				}
+			}
+			for (uint32_t i = 0; i < orderCount; ++i) {
+				assert(stackSize < MAX_STACK_DEPTH);
+				stack[stackSize++] = { node.children[order[i]], nearDistances[order[i]] };
+			}
+		}
+		return hit;
+	}
+
+	void Bvh::buildNode(uint32_t nodeIndex, uint32_t parent, uint32_t parentSlot, uint32_t depth, const BuildRange& range,
+		JobSystem& jobSystem, JobCounter& counter)
+	{
+		// the traversal stacks are sized for this depth and never drop subtrees
+		assert(depth < MAX_TREE_DEPTH);
+		Node& node = m_nodes[nodeIndex];
+		node.parent = parent;
+		node.parentSlot = parentSlot;
+
+		// two levels of binary SAH splits give up to four children
+		const bool isMedianSplit = depth >= MAX_SAH_DEPTH;
+		BuildRange ranges[4];
+		uint32_t rangeCount = 1;
+		ranges[0] = range;
+		while (rangeCount < 4) {
+			uint32_t largest = rangeCount;
+			uint32_t largestCount = MAX_LEAF_OBJECTS;
+			for (uint32_t i = 0; i < rangeCount; ++i) {
+				const uint32_t count = ranges[i].end - ranges[i].begin;
+				if (count > largestCount) {
+					largest = i;
+					largestCount = count;
+				}
+			}
+			if (largest == rangeCount) break;
+
+			BuildRange left;
+			BuildRange right;
+			if (!splitRange(ranges[largest], isMedianSplit, left, right)) break;
+			ranges[largest] = left;
+			ranges[rangeCount++] = right;
+		}
+
+		for (uint32_t slot = 0; slot < 4; ++slot) {
+			if (slot >= rangeCount) {
+				setChildBounds(node, slot, makeEmptyAabb());
+				node.children[slot] = EMPTY_CHILD;
+				node.objectCounts[slot] = 0;
+				continue;
+			}
+
+			const BuildRange& child = ranges[slot];
+			const uint32_t count = child.end - child.begin;
+			setChildBounds(node, slot, child.bounds);
+			if (count <= MAX_LEAF_OBJECTS) {
+				node.children[slot] = LEAF_FLAG | child.begin;
+				node.objectCounts[slot] = count;
+				for (uint32_t i = child.begin; i < child.end; ++i) {
+					m_objectLeaves[m_leafObjects[i]] = (nodeIndex << 2) | slot;
+				}
+				continue;
+			}
+
+			const uint32_t childIndex = m_nodeAllocator.fetch_add(1, std::memory_order_relaxed);
+			node.children[slot] = childIndex;
+			node.objectCounts[slot] = 0;
+			if (count >= PARALLEL_BUILD_THRESHOLD) {
+				jobSystem.execute([this, childIndex, nodeIndex, slot, depth, child, &jobSystem, &counter]() {
+					buildNode(childIndex, nodeIndex, slot, depth + 1, child, jobSystem, counter);
+				}, &counter);
+			}
+			else {
+				buildNode(childIndex, nodeIndex, slot, depth + 1, child, jobSystem, counter);
+			}
+		}
+	}
+
+	bool Bvh::splitRange(const BuildRange& range, bool isMedianSplit, BuildRange& left, BuildRange& right)
+	{
+		Aabb centroidBounds = makeEmptyAabb();
+		for (uint32_t i = range.begin; i < range.end; ++i) {
+			grow(centroidBounds, m_objectCentroids[m_leafObjects[i]]);
+		}
+		const glm::vec4 extent = centroidBounds.max - centroidBounds.min;
+		const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		const float axisMin = centroidBounds.min[axis];
+		const float axisExtent = extent[axis];
+
+		auto* const begin = m_leafObjects.data() + range.begin;
+		auto* const end = m_leafObjects.data() + range.end;
+		auto* middle = begin;
+
+		if (axisExtent > 0.0f && !isMedianSplit) {
+			const float binScale = static_cast<float>(BIN_COUNT) / axisExtent;
+			const auto getBin = [this, axis, axisMin, binScale](uint32_t object) {
+				const auto bin = static_cast<uint32_t>((m_objectCentroids[object][axis] - axisMin) * binScale);
+				return std::min(bin, BIN_COUNT - 1);
+			};
+
+			Aabb binBounds[BIN_COUNT];
+			uint32_t binCounts[BIN_COUNT] = {};
+			for (auto& bounds : binBounds) bounds = makeEmptyAabb();
+			for (auto* object = begin; object != end; ++object) {
+				const uint32_t bin = getBin(*object);
+				++binCounts[bin];
+				grow(binBounds[bin], m_objectBounds[*object]);
+			}
+
+			// sweep from the left, then evaluate every plane sweeping from the right
+			float leftAreas[BIN_COUNT - 1];
+			uint32_t leftCounts[BIN_COUNT - 1];
+			Aabb accumulated = makeEmptyAabb();
+			uint32_t accumulatedCount = 0;
+			for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+				accumulatedCount += binCounts[i];
+				if (binCounts[i] > 0) grow(accumulated, binBounds[i]);
+				leftCounts[i] = accumulatedCount;
+				leftAreas[i] = accumulatedCount > 0 ? halfSurfaceArea(accumulated) : 0.0f;
+			}
+
+			float bestCost = FLT_MAX;
+			uint32_t bestSplit = 0;
+			accumulated = makeEmptyAabb();
+			accumulatedCount = 0;
+			for (uint32_t i = BIN_COUNT - 1; i > 0; --i) {
+				accumulatedCount += binCounts[i];
+				if (binCounts[i] > 0) grow(accumulated, binBounds[i]);
+				if (accumulatedCount == 0 || leftCounts[i - 1] == 0) continue;
+				const float cost = leftCounts[i - 1] * leftAreas[i - 1] + accumulatedCount * halfSurfaceArea(accumulated);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestSplit = i;
+				}
+			}
+
+			if (bestSplit > 0) {
+				middle = std::partition(begin, end, [&getBin, bestSplit](uint32_t object) { return getBin(object) < bestSplit; });
+			}
+		}
+
+		// coincident centroids, a degenerate partition or a deep node fall back to a median split
+		if (middle == begin || middle == end) {
+			middle = begin + (end - begin) / 2;
+			std::nth_element(begin, middle, end, [this, axis](uint32_t a, uint32_t b) {
+				return m_objectCentroids[a][axis] < m_objectCentroids[b][axis];
+			});
+		}
+
+		const uint32_t split = static_cast<uint32_t>(middle - m_leafObjects.data());
+		left = BuildRange{ range.begin, split, computeRangeBounds(range.begin, split) };
+		right = BuildRange{ split, range.end, computeRangeBounds(split, range.end) };
+		return true;
+	}
+
+	Aabb Bvh::computeRangeBounds(uint32_t begin, uint32_t end) const noexcept
+	{
+		Aabb bounds = makeEmptyAabb();
+		for (uint32_t i = begin; i < end; ++i) {
+			grow(bounds, m_objectBounds[m_leafObjects[i]]);
+		}
+		return bounds;
+	}
+
+	Aabb Bvh::getNodeBounds(uint32_t nodeIndex) const noexcept
+	{
+		const Node& node = m_nodes[nodeIndex];
+		Aabb bounds = makeEmptyAabb();
+		for (uint32_t slot = 0; slot < 4; ++slot) {
+			if (node.children[slot] == EMPTY_CHILD) continue;
+			grow(bounds, Aabb{ glm::vec4(node.minX[slot], node.minY[slot], node.minZ[slot], 0.0f),
+				glm::vec4(node.maxX[slot], node.maxY[slot], node.maxZ[slot], 0.0f) });
+		}
+		return bounds;
+	}
+
+	void Bvh::setChildBounds(Node& node, uint32_t slot, const Aabb& bounds) noexcept
+	{
+		node.minX[slot] = bounds.min.x;
+		node.minY[slot] = bounds.min.y;
+		node.minZ[slot] = bounds.min.z;
+		node.maxX[slot] = bounds.max.x;
+		node.maxY[slot] = bounds.max.y;
+		node.maxZ[slot] = bounds.max.z;
+	}
+
+	void Bvh::markRefit(uint32_t nodeIndex)
+	{
+		if (m_refitStamps[nodeIndex] == m_refitStamp) return;
+		m_refitStamps[nodeIndex] = m_refitStamp;
+		m_refitHeap.push_back(nodeIndex);
+		std::push_heap(m_refitHeap.begin(), m_refitHeap.end());
+	}
+}
@@ -1,45 +1,409 @@
 ﻿#include "ColdWindEngine.h"
+#include "AllocationCounter.h"
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 
 namespace coldwind
 {
     ColdWindEngine::ColdWindEngine(const std::string& appName, uint32_t width, uint32_t height)
-        : m_instance(appName), m_window(m_instance, width, height, appName), 
-        m_context(m_instance, m_window), m_swapChain(m_context, m_window)
+        : m_instance(appName), m_windows(createMainWindow(m_instance, width, height, appName)),
+        m_context(m_instance, *m_windows.front()->window), m_resources(m_context), m_frameContext(m_context, m_resources),
+        m_capture(m_context, m_resources), m_pipelineCache(m_context, m_jobSystem),
+        m_dynamicResolution(m_context, m_resources, m_pipelineCache),
+        m_textureStreamer(m_context, m_resources, m_jobSystem), m_textureLoader(m_context, m_jobSystem, m_textureStreamer)
     {
+        addWindow(*m_windows.front());
         spdlog::info("Engine coldwind initialized");
-
-        glfwSetWindowUserPointer(m_window.getWindowPtr(), this);
-        glfwSetWindowSizeCallback(m_window.getWindowPtr(), windowResizeCallback);
     }
 
     ColdWindEngine::~ColdWindEngine()
     {
+        // run() joins the render thread, unless it left through an exception of the main thread
+        if (m_renderThread.joinable()) {
+            m_isStopRequested.store(true, std::memory_order_release);
+            m_eventSignal.fetch_add(1, std::memory_order_release);
+            m_eventSignal.notify_one();
+            m_renderThread.join();
+        }
+        static_cast<void>(m_context.getDevice()->waitIdle());
+        // declared before the pipeline cache it takes its pipeline from
+        m_recorder.reset();
+        // swapchains need the device, the windows themselves outlive the context
+        for (auto& engineWindow : m_windows) {
+            engineWindow->swapChain.reset();
+        }
+    }
+
+    void ColdWindEngine::openWindow(const std::string& title, uint32_t width, uint32_t height)
+    {
+        auto engineWindow = std::make_unique<EngineWindow>();
+        engineWindow->window = std::make_unique<Window>(m_instance, width, height, title);
+        addWindow(*engineWindow);
+        m_windows.push_back(std::move(engineWindow));
+        spdlog::info("Opened window {}, {} windows share the device", title, m_windows.size());
+    }
+
+    void ColdWindEngine::captureFrames(const std::string& path, uint32_t frameCount)
+    {
+        postRenderCommand([this, path, frameCount] {
+            // started between two frames by drawFrame()
+            m_capturePath = path;
+            m_captureFrameCount = frameCount;
+        });
+    }
+
+    void ColdWindEngine::startRecording(const RecordingSettings& settings)
+    {
+        postRenderCommand([this, settings] {
+            // the swapchain format is kept across resizes, sources of another size are scaled to the video
+            m_recorder.reset();
+            const SwapChain& swapChain = *m_renderWindows.front()->swapChain;
+            if (!(swapChain.getImageUsage() & vk::ImageUsageFlagBits::eTransferSrc)) {
+                spdlog::error("Can not record to {}, the main window's surface does not allow reading its images back!", settings.path);
+                return;
+            }
+            m_recorder = std::make_unique<FrameRecorder>(m_context, m_resources, m_pipelineCache,
+                swapChain.getSurfaceFormat().format, settings);
+        });
+    }
+
+    void ColdWindEngine::stopRecording()
+    {
+        postRenderCommand([this] { m_recorder.reset(); });
+    }
+
+    void ColdWindEngine::setFrameUpdate(FrameUpdate update)
+    {
+        postRenderCommand([this, update = std::move(update)] { m_frameUpdate = update; });
+    }
+
+    void ColdWindEngine::run()
+    {
+        m_renderThread = std::thread([this] { renderLoop(); });
+        while (!m_isRenderThreadDone.load(std::memory_order_acquire)) {
+            // the callbacks queue the events, the render thread posts an empty event to wake this wait
+            glfwWaitEvents();
+            destroyReleasedWindows();
+        }
+        m_renderThread.join();
+        if (m_renderThreadError) std::rethrow_exception(m_renderThreadError);
+    }
+
+    void ColdWindEngine::renderLoop()
+    {
+        try {
+            while (true) {
+                // read before draining the queue, an event pushed after the drain changes it and ends the idle wait
+                const uint32_t eventSignal = m_eventSignal.load(std::memory_order_acquire);
+                if (!processEvents()) break;
+                runRenderCommands();
+
+                bool isAnyVisible = false;
+                for (const EngineWindow* engineWindow : m_renderWindows) {
+                    isAnyVisible |= !engineWindow->window->isMinimized();
+                }
+                if (!isAnyVisible) {
+                    m_eventSignal.wait(eventSignal, std::memory_order_acquire);
+                    continue;
+                }
+
+#ifndef NDEBUG
+                const uint64_t allocationCount = getHeapAllocationCount();
+                drawFrame();
+                // the frame loop must not allocate once every container reached its working size
+                const uint64_t frameAllocations = getHeapAllocationCount() - allocationCount;
+                if (frameAllocations != m_lastFrameAllocations) {
+                    spdlog::debug("Frame {} made {} heap allocations", m_frameContext.getFrameNumber(), frameAllocations);
+                    m_lastFrameAllocations = frameAllocations;
+                }
+#else
+                drawFrame();
+#endif
+            }
+        }
+        catch (...) {
+            m_renderThreadError = std::current_exception();
+        }
+        m_isRenderThreadDone.store(true, std::memory_order_release);
+        glfwPostEmptyEvent();
+    }
+
+    bool ColdWindEngine::processEvents()
+    {
+        WindowEvent event;
+        while (m_events.pop(event)) {
+            EngineWindow& engineWindow = *event.window;
+            switch (event.type) {
+            case WindowEvent::Type::Opened:
+                attachSwapChain(engineWindow);
+                m_renderWindows.push_back(&engineWindow);
+                break;
+            case WindowEvent::Type::Resized:
+                engineWindow.isResized = true;
+                break;
+            case WindowEvent::Type::Closed:
+                // the main window closes the engine, other windows are closed on their own
+                if (&engineWindow == m_renderWindows.front()) return false;
+                releaseWindow(engineWindow);
+                break;
+            case WindowEvent::Type::Key:
+                m_input.onKey(event.code, event.action);
+                break;
+            case WindowEvent::Type::MouseButton:
+                m_input.onMouseButton(event.code, event.action);
+                break;
+            case WindowEvent::Type::CursorMoved:
+                m_input.onCursorMoved(event.x, event.y);
+                break;
+            case WindowEvent::Type::Scrolled:
+                m_input.onScrolled(event.x, event.y);
+                break;
+            }
+        }
+        return !m_isStopRequested.load(std::memory_order_acquire);
     }
 
-    void ColdWindEngine::mainLoop()
+    void ColdWindEngine::runRenderCommands()
     {
-        while (!m_window.shouldClose()) {
-            m_window.pollEvents();
-            if (m_window.isMinimized()) continue;
+        {
+            std::lock_guard lock(m_renderCommandMutex);
+            if (m_renderCommands.empty()) return;
+            std::swap(m_renderCommands, m_runningCommands);
         }
+        for (auto& command : m_runningCommands) {
+            command();
+        }
+        m_runningCommands.clear();
     }
 
-    void ColdWindEngine::onWindowResize()
+    void ColdWindEngine::postRenderCommand(std::function<void()> command)
     {
-        m_swapChain.createSwapchain(m_context, m_window);
+        {
+            std::lock_guard lock(m_renderCommandMutex);
+            m_renderCommands.push_back(std::move(command));
+        }
+        m_eventSignal.fetch_add(1, std::memory_order_release);
+        m_eventSignal.notify_one();
     }
 
-    void ColdWindEngine::windowResizeCallback(GLFWwindow* window, int width, int height)
+    void ColdWindEngine::drawFrame()
     {
+        m_frameContext.beginFrame();
+        m_resources.beginFrame(m_frameContext.getFrameNumber(), m_frameContext.getTimelineSemaphore());
+        if (m_captureFrameCount != 0) {
+            m_capture.begin(m_capturePath, m_captureFrameCount);
+            m_captureFrameCount = 0;
+        }
+        // the slot fence covers every frame up to the previous use of the slot
+        if (m_recorder && m_frameContext.getFrameNumber() >= MAX_FRAMES_IN_FLIGHT) {
+            m_recorder->collect(m_frameContext.getFrameNumber() - MAX_FRAMES_IN_FLIGHT);
+        }
+        // the frame's arrays live in the scratch allocator, sized for every window up front
+        LinearAllocator& scratch = m_frameContext.getScratchAllocator();
+        const size_t windowCount = m_renderWindows.size();
+        FrameVector<SwapChain*> swapChains{ LinearStlAllocator<SwapChain*>(scratch) };
+        FrameVector<uint32_t> imageIndices{ LinearStlAllocator<uint32_t>(scratch) };
+        FrameVector<vk::Semaphore> waitSemaphores{ LinearStlAllocator<vk::Semaphore>(scratch) };
+        FrameVector<vk::PipelineStageFlags> waitStages{ LinearStlAllocator<vk::PipelineStageFlags>(scratch) };
+        FrameVector<vk::Semaphore> signalSemaphores{ LinearStlAllocator<vk::Semaphore>(scratch) };
+        swapChains.reserve(windowCount);
+        imageIndices.reserve(windowCount);
+        waitSemaphores.reserve(windowCount);
+        waitStages.reserve(windowCount);
+        signalSemaphores.reserve(windowCount);
+
+        const uint32_t frameSlot = m_frameContext.getFrameSlot();
+        SwapChain* mainSwapChain = m_renderWindows.front()->swapChain.get();
+        for (EngineWindow* engineWindow : m_renderWindows) {
+            if (engineWindow->window->isMinimized()) continue;
+
+            SwapChain& swapChain = *engineWindow->swapChain;
+            if (engineWindow->isResized || swapChain.isOutOfDate()) {
+                swapChain.createSwapchain(m_context, *engineWindow->window);
+                engineWindow->isResized = false;
+            }
+            // an out of date swapchain signals nothing, the window skips this frame
+            if (swapChain.acquireNextImage(m_context, frameSlot, engineWindow->imageIndex) == vk::Result::eErrorOutOfDateKHR) continue;
+
+            swapChains.push_back(&swapChain);
+            imageIndices.push_back(engineWindow->imageIndex);
+            waitSemaphores.push_back(swapChain.getImageAvailableSemaphore(frameSlot));
+            waitStages.push_back(vk::PipelineStageFlagBits::eTransfer);
+            signalSemaphores.push_back(swapChain.getRenderFinishedSemaphore(engineWindow->imageIndex));
+        }
+        // nothing acquired, the frame number stays and the next attempt updates the frame instead
+        if (swapChains.empty()) return;
+
+        m_textureStreamer.update(m_frameContext.getFrameNumber());
+        if (m_frameUpdate) m_frameUpdate(m_input, m_scene);
+        // the frame consumed the input, events from now on belong to the next one
+        m_input.beginFrame();
+        m_scene.update(m_jobSystem);
+        updateSceneBvh();
+
+        // the main window renders into the scaled target, the other windows straight into their swapchain images
+        const bool isMainAcquired = swapChains.front() == mainSwapChain;
+        if (isMainAcquired) m_dynamicResolution.update(frameSlot, mainSwapChain->getSwapchainExtent2D());
+        m_commandStream.clear();
+        m_commandStream.beginPass("clear");
+        for (size_t i = 0; i < swapChains.size(); ++i) {
+            if (swapChains[i] == mainSwapChain) recordClear(m_dynamicResolution.getSceneTarget(), vk::ImageLayout::eShaderReadOnlyOptimal);
+            else recordClear(swapChains[i]->getSwapchainImageHandle(imageIndices[i]), vk::ImageLayout::ePresentSrcKHR);
+        }
+        m_commandStream.endPass();
+
+        // frames without the main window say nothing about its render scale and are not timed
+        const vk::CommandBuffer commandBuffer = m_frameContext.beginCommands();
+        if (isMainAcquired) m_dynamicResolution.beginTiming(commandBuffer, frameSlot);
+        m_commandStream.execute(commandBuffer, m_resources);
+        // the upscale and the recorder's copies bypass the command stream, captures replay the frame without them
+        if (isMainAcquired) {
+            const ImageHandle mainImage = mainSwapChain->getSwapchainImageHandle(imageIndices.front());
+            m_dynamicResolution.recordUpscale(commandBuffer, frameSlot, mainImage, vk::ImageLayout::ePresentSrcKHR);
+            if (m_recorder) m_recorder->record(commandBuffer, mainImage, m_frameContext.getFrameNumber());
+            m_dynamicResolution.endTiming(commandBuffer, frameSlot);
+        }
+
+        // after the last CPU write of the frame, the capture stores the written bytes
+        m_capture.recordFrame(m_commandStream);
+        m_frameContext.submit(waitSemaphores, waitStages, signalSemaphores);
+        SwapChain::present(m_context, swapChains, imageIndices, scratch);
+    }
+
+    void ColdWindEngine::recordClear(ImageHandle image, vk::ImageLayout finalLayout)
+    {
+        m_commandStream.imageBarrier(image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+            vk::PipelineStageFlagBits::eTransfer, {}, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite);
+        m_commandStream.clearColorImage(image, { 0.0f, 0.0f, 0.0f, 1.0f });
+        if (finalLayout == vk::ImageLayout::ePresentSrcKHR) {
+            m_commandStream.imageBarrier(image, vk::ImageLayout::eTransferDstOptimal, finalLayout,
+                vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eBottomOfPipe, {});
+            return;
+        }
+        m_commandStream.imageBarrier(image, vk::ImageLayout::eTransferDstOptimal, finalLayout,
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead);
+    }
+
+    void ColdWindEngine::updateSceneBvh()
+    {
+        // instance indices shift when nodes are created or destroyed, the tree is rebuilt then
+        const auto bounds = m_scene.getWorldBounds();
+        if (bounds.size() != m_sceneBvh.getObjectCount() || m_sceneBvh.isRebuildRecommended()) {
+            m_sceneBvh.build(bounds, m_jobSystem);
+            return;
+        }
+
+        for (const uint32_t instance : m_scene.getChangedInstances()) {
+            m_sceneBvh.updateObject(instance, bounds[instance]);
+        }
+        m_sceneBvh.refit();
+    }
+
+    void ColdWindEngine::releaseWindow(EngineWindow& engineWindow)
+    {
+        // the surface goes with the window, nothing may still use its swapchain
+        static_cast<void>(m_context.getDevice()->waitIdle());
+        engineWindow.swapChain.reset();
+        m_resources.collect(UINT64_MAX);
+        std::erase(m_renderWindows, &engineWindow);
+        engineWindow.isReleased.store(true, std::memory_order_release);
+        glfwPostEmptyEvent();
+    }
+
+    void ColdWindEngine::destroyReleasedWindows()
+    {
+        std::erase_if(m_windows, [](const std::unique_ptr<EngineWindow>& engineWindow) {
+            return engineWindow->isReleased.load(std::memory_order_acquire);
+        });
+    }
+
+    std::vector<std::unique_ptr<ColdWindEngine::EngineWindow>> ColdWindEngine::createMainWindow(Instance& instance,
+        uint32_t width, uint32_t height, const std::string& title)
+    {
+        std::vector<std::unique_ptr<EngineWindow>> windows;
+        windows.push_back(std::make_unique<EngineWindow>());
+        windows.front()->window = std::make_unique<Window>(instance, width, height, title);
+        return windows;
+    }
+
+    void ColdWindEngine::addWindow(EngineWindow& engineWindow)
+    {
+        engineWindow.engine = this;
+        GLFWwindow* window = engineWindow.window->getWindowPtr();
+        glfwSetWindowUserPointer(window, &engineWindow);
+        glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+        glfwSetWindowCloseCallback(window, windowCloseCallback);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+        glfwSetCursorPosCallback(window, cursorPosCallback);
+        glfwSetScrollCallback(window, scrollCallback);
+        pushEvent({ WindowEvent::Type::Opened, &engineWindow });
+    }
+
+    void ColdWindEngine::attachSwapChain(EngineWindow& engineWindow)
+    {
+        engineWindow.swapChain = std::make_unique<SwapChain>(m_context, *engineWindow.window, m_resources);
+    }
+
+    void ColdWindEngine::pushEvent(const WindowEvent& event)
+    {
+        // the render thread may release the window right after its Closed event, later events would outlive it
+        if (event.window->isClosing) return;
+        if (event.type == WindowEvent::Type::Closed) event.window->isClosing = true;
+
+        // the queue is only full when the render thread stalls for a long time, nothing may be lost
+        while (!m_events.push(event)) {
+            if (m_isRenderThreadDone.load(std::memory_order_acquire)) return;
+            std::this_thread::yield();
+        }
+        m_eventSignal.fetch_add(1, std::memory_order_release);
+        m_eventSignal.notify_one();
+    }
+
+    void ColdWindEngine::framebufferSizeCallback(GLFWwindow* window, int width, int height)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        engineWindow->window->setFramebufferExtent(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
         if (width != 0 && height != 0) {
             spdlog::debug("Window resized to : {}x{}", width, height);
-            ColdWindEngine* app = static_cast<ColdWindEngine*>(glfwGetWindowUserPointer(window));
-            app->onWindowResize();
         }
         else {
             spdlog::debug("Window minimized");
         }
+        // also sent when minimized, it wakes the idle render thread
+        engineWindow->engine->pushEvent({ WindowEvent::Type::Resized, engineWindow });
+    }
+
+    void ColdWindEngine::windowCloseCallback(GLFWwindow* window)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        // hidden right away, destroyed once the render thread released its swapchain
+        if (engineWindow != engineWindow->engine->m_windows.front().get()) glfwHideWindow(window);
+        engineWindow->engine->pushEvent({ WindowEvent::Type::Closed, engineWindow });
+    }
+
+    void ColdWindEngine::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        engineWindow->engine->pushEvent({ WindowEvent::Type::Key, engineWindow, key, action });
+    }
+
+    void ColdWindEngine::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        engineWindow->engine->pushEvent({ WindowEvent::Type::MouseButton, engineWindow, button, action });
+    }
+
+    void ColdWindEngine::cursorPosCallback(GLFWwindow* window, double x, double y)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        engineWindow->engine->pushEvent({ WindowEvent::Type::CursorMoved, engineWindow, 0, 0, x, y });
+    }
+
+    void ColdWindEngine::scrollCallback(GLFWwindow* window, double x, double y)
+    {
+        EngineWindow* engineWindow = static_cast<EngineWindow*>(glfwGetWindowUserPointer(window));
+        engineWindow->engine->pushEvent({ WindowEvent::Type::Scrolled, engineWindow, 0, 0, x, y });
     }
 }
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "CommandStream.h"
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace coldwind {
+	namespace {
+		struct BeginPassCommand {
+			char name[CommandStream::MAX_PASS_NAME_LENGTH + 1];
+		};
+
+		struct ImageBarrierCommand {
+			ImageHandle image;
+			vk::ImageLayout oldLayout;
+			vk::ImageLayout newLayout;
+			vk::PipelineStageFlags srcStage;
+			vk::AccessFlags srcAccess;
+			vk::PipelineStageFlags dstStage;
+			vk::AccessFlags dstAccess;
+		};
+
+		struct ClearColorImageCommand {
+			ImageHandle image;
+			std::array<float, 4> color;
+		};
+
+		struct CopyBufferCommand {
+			BufferHandle source;
+			BufferHandle destination;
+			vk::BufferCopy region;
+		};
+
+		struct CopyBufferToImageCommand {
+			BufferHandle source;
+			ImageHandle destination;
+			vk::BufferImageCopy region;
+		};
+
+		struct FillBufferCommand {
+			BufferHandle destination;
+			vk::DeviceSize offset;
+			vk::DeviceSize size;
+			uint32_t data;
+		};
+
+		constexpr uint32_t getPayloadSize(size_t size) noexcept
+		{
+			return static_cast<uint32_t>((size + 7) & ~size_t(7));
+		}
+
+		constexpr std::array<uint32_t, static_cast<size_t>(CommandType::Count)> PAYLOAD_SIZES = {
+			getPayloadSize(sizeof(BeginPassCommand)),
+			0,
+			getPayloadSize(sizeof(ImageBarrierCommand)),
+			getPayloadSize(sizeof(ClearColorImageCommand)),
+			getPayloadSize(sizeof(CopyBufferCommand)),
+			getPayloadSize(sizeof(CopyBufferToImageCommand)),
+			getPayloadSize(sizeof(FillBufferCommand)),
+		};
+
+		// payloads are not aligned inside the stream, they are copied out and back
+		template<typename T>
+		T readPayload(const std::byte* payload) noexcept
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			T value;
+			std::memcpy(&value, payload, sizeof(T));
+			return value;
+		}
+
+		vk::ImageAspectFlags getAspectMask(vk::Format format) noexcept
+		{
+			switch (format) {
+			case vk::Format::eD16Unorm:
+			case vk::Format::eD32Sfloat:
+			case vk::Format::eX8D24UnormPack32:
+				return vk::ImageAspectFlagBits::eDepth;
+			case vk::Format::eD16UnormS8Uint:
+			case vk::Format::eD24UnormS8Uint:
+			case vk::Format::eD32SfloatS8Uint:
+				return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+			default:
+				return vk::ImageAspectFlagBits::eColor;
+			}
+		}
+
+		const ImageResource& getImage(const ResourceRegistry& registry, ImageHandle handle)
+		{
+			const ImageResource* image = registry.get(handle);
+			if (image == nullptr) {
+				spdlog::error("Command stream references stale image handle {}:{}!", handle.index, handle.generation);
+				throw std::runtime_error("Stale image handle in command stream!");
+			}
+			return *image;
+		}
+
+		const BufferResource& getBuffer(const ResourceRegistry& registry, BufferHandle handle)
+		{
+			const BufferResource* buffer = registry.get(handle);
+			if (buffer == nullptr) {
+				spdlog::error("Command stream references stale buffer handle {}:{}!", handle.index, handle.generation);
+				throw std::runtime_error("Stale buffer handle in command stream!");
+			}
+			return *buffer;
+		}
+	}
+
+	void CommandStream::clear() noexcept
+	{
+		m_data.clear();
+		m_commandCount = 0;
+		m_passCount = 0;
+		m_isInPass = false;
+	}
+
+	void CommandStream::beginPass(std::string_view name)
+	{
+		if (m_isInPass) {
+			spdlog::error("Command stream pass {} begins inside another pass!", name);
+			throw std::runtime_error("Command stream passes can not nest!");
+		}
+
+		BeginPassCommand command{};
+		name.copy(command.name, MAX_PASS_NAME_LENGTH);
+		push(CommandType::BeginPass, command);
+		m_isInPass = true;
+	}
+
+	void CommandStream::endPass()
+	{
+		if (!m_isInPass) {
+			spdlog::error("Command stream pass ended without beginPass()!");
+			throw std::runtime_error("Command stream pass ended without beginPass()!");
+		}
+
+		push(CommandType::EndPass, nullptr);
+		m_isInPass = false;
+		++m_passCount;
+	}
+
+	void CommandStream::imageBarrier(ImageHandle image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess)
+	{
+		push(CommandType::ImageBarrier, ImageBarrierCommand{ image, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess });
+	}
+
+	void CommandStream::clearColorImage(ImageHandle image, const std::array<float, 4>& color)
+	{
+		push(CommandType::ClearColorImage, ClearColorImageCommand{ image, color });
+	}
+
+	void CommandStream::copyBuffer(BufferHandle source, BufferHandle destination, const vk::BufferCopy& region)
+	{
+		push(CommandType::CopyBuffer, CopyBufferCommand{ source, destination, region });
+	}
+
+	void CommandStream::copyBufferToImage(BufferHandle source, ImageHandle destination, const vk::BufferImageCopy& region)
+	{
+		push(CommandType::CopyBufferToImage, CopyBufferToImageCommand{ source, destination, region });
+	}
+
+	void CommandStream::fillBuffer(BufferHandle destination, vk::DeviceSize offset, vk::DeviceSize size, uint32_t data)
+	{
+		push(CommandType::FillBuffer, FillBufferCommand{ destination, offset, size, data });
+	}
+
+	void CommandStream::execute(vk::CommandBuffer commandBuffer, ResourceRegistry& registry, vk::QueryPool timestampPool,
+		uint32_t firstQuery, uint32_t queryCount) const
+	{
+		if (m_isInPass) {
+			spdlog::error("Command stream executed inside an open pass!");
+			throw std::runtime_error("Command stream executed inside an open pass!");
+		}
+		// every pass is balanced, so the stream writes exactly 2 * m_passCount queries
+		if (timestampPool && static_cast<uint64_t>(firstQuery) + 2ull * m_passCount > queryCount) {
+			spdlog::error("Command stream writes {} timestamps from query {}, the pool holds {}!", 2 * m_passCount, firstQuery, queryCount);
+			throw std::runtime_error("Timestamp queries out of range!");
+		}
+
+		uint32_t pass = 0;
+		forEachCommand([&](CommandType type, const std::byte* payload) {
+			switch (type) {
+			case CommandType::BeginPass:
+				if (timestampPool) {
+					commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool, firstQuery + 2 * pass);
+				}
+				break;
+			case CommandType::EndPass:
+				if (timestampPool) {
+					commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampPool, firstQuery + 2 * pass + 1);
+				}
+				++pass;
+				break;
+			case CommandType::ImageBarrier: {
+				const auto command = readPayload<ImageBarrierCommand>(payload);
+				const ImageResource& image = getImage(registry, command.image);
+
+				vk::ImageMemoryBarrier barrier{};
+				barrier.srcAccessMask = command.srcAccess;
+				barrier.dstAccessMask = command.dstAccess;
+				barrier.oldLayout = command.oldLayout;
+				barrier.newLayout = command.newLayout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = image.image;
+				barrier.subresourceRange = vk::ImageSubresourceRange(getAspectMask(image.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+				commandBuffer.pipelineBarrier(command.srcStage, command.dstStage, {}, nullptr, nullptr, barrier);
+				registry.setImageLayout(command.image, command.newLayout);
+				break;
+			}
+			case CommandType::ClearColorImage: {
+				const auto command = readPayload<ClearColorImageCommand>(payload);
+				const ImageResource& image = getImage(registry, command.image);
+				const vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+				commandBuffer.clearColorImage(image.image, image.layout, vk::ClearColorValue(command.color), range);
+				break;
+			}
+			case CommandType::CopyBuffer: {
+				const auto command = readPayload<CopyBufferCommand>(payload);
+				commandBuffer.copyBuffer(getBuffer(registry, command.source).buffer, getBuffer(registry, command.destination).buffer, command.region);
+				break;
+			}
+			case CommandType::CopyBufferToImage: {
+				const auto command = readPayload<CopyBufferToImageCommand>(payload);
+				const ImageResource& image = getImage(registry, command.destination);
+				commandBuffer.copyBufferToImage(getBuffer(registry, command.source).buffer, image.image, image.layout, command.region);
+				break;
+			}
+			case CommandType::FillBuffer: {
+				const auto command = readPayload<FillBufferCommand>(payload);
+				commandBuffer.fillBuffer(getBuffer(registry, command.destination).buffer, command.offset, command.size, command.data);
+				break;
+			}
+			default:
+				break;
+			}
+		});
+	}
+
+	void CommandStream::assign(std::span<const std::byte> data)
+	{
+		clear();
+		m_data.assign(data.begin(), data.end());
+
+		// validates the whole stream up front, execute() trusts the headers
+		size_t offset = 0;
+		while (offset < m_data.size()) {
+			const auto header = offset + sizeof(CommandHeader) <= m_data.size() ?
+				readPayload<CommandHeader>(m_data.data() + offset) : CommandHeader{ CommandType::Count, 0 };
+			if (header.type >= CommandType::Count || header.size != PAYLOAD_SIZES[static_cast<size_t>(header.type)] ||
+				offset + sizeof(CommandHeader) + header.size > m_data.size()) {
+				spdlog::error("Invalid command stream, command {} at byte {} is malformed!", m_commandCount, offset);
+				clear();
+				throw std::runtime_error("Invalid command stream!");
+			}
+
+			// the same rules beginPass() and endPass() enforce while recording
+			const bool isBegin = header.type == CommandType::BeginPass;
+			if ((isBegin || header.type == CommandType::EndPass) && m_isInPass == isBegin) {
+				spdlog::error("Invalid command stream, command {} at byte {} {}!", m_commandCount, offset,
+					isBegin ? "begins a pass inside another pass" : "ends a pass that was not begun");
+				clear();
+				throw std::runtime_error("Invalid command stream!");
+			}
+			if (isBegin) m_isInPass = true;
+			else if (header.type == CommandType::EndPass) {
+				m_isInPass = false;
+				++m_passCount;
+			}
+			++m_commandCount;
+			offset += sizeof(CommandHeader) + header.size;
+		}
+
+		if (m_isInPass) {
+			spdlog::error("Invalid command stream, the last pass of {} commands is never ended!", m_commandCount);
+			clear();
+			throw std::runtime_error("Invalid command stream!");
+		}
+	}
+
+	void CommandStream::remapHandles(const std::function<BufferHandle(BufferHandle)>& remapBuffer, const std::function<ImageHandle(ImageHandle)>& remapImage)
+	{
+		forEachCommand([&](CommandType type, std::byte* payload) {
+			switch (type) {
+			case CommandType::ImageBarrier: {
+				auto command = readPayload<ImageBarrierCommand>(payload);
+				command.image = remapImage(command.image);
+				std::memcpy(payload, &command, sizeof(command));
+				break;
+			}
+			case CommandType::ClearColorImage: {
+				auto command = readPayload<ClearColorImageCommand>(payload);
+				command.image = remapImage(command.image);
+				std::memcpy(payload, &command, sizeof(command));
+				break;
+			}
+			case CommandType::CopyBuffer: {
+				auto command = readPayload<CopyBufferCommand>(payload);
+				command.source = remapBuffer(command.source);
+				command.destination = remapBuffer(command.destination);
+				std::memcpy(payload, &command, sizeof(command));
+				break;
+			}
+			case CommandType::CopyBufferToImage: {
+				auto command = readPayload<CopyBufferToImageCommand>(payload);
+				command.source = remapBuffer(command.source);
+				command.destination = remapImage(command.destination);
+				std::memcpy(payload, &command, sizeof(command));
+				break;
+			}
+			case CommandType::FillBuffer: {
+				auto command = readPayload<FillBufferCommand>(payload);
+				command.destination = remapBuffer(command.destination);
+				std::memcpy(payload, &command, sizeof(command));
+				break;
+			}
+			default:
+				break;
+			}
+		});
+	}
+
+	void CommandStream::replaceLayout(vk::ImageLayout from, vk::ImageLayout to)
+	{
+		forEachCommand([&](CommandType type, std::byte* payload) {
+			if (type != CommandType::ImageBarrier) return;
+
+			auto command = readPayload<ImageBarrierCommand>(payload);
+			if (command.oldLayout == from) command.oldLayout = to;
+			if (command.newLayout == from) command.newLayout = to;
+			std::memcpy(payload, &command, sizeof(command));
+		});
+	}
+
+	std::vector<std::string> CommandStream::getPassNames() const
+	{
+		std::vector<std::string> names;
+		names.reserve(m_passCount);
+		forEachCommand([&](CommandType type, const std::byte* payload) {
+			if (type == CommandType::BeginPass) names.emplace_back(readPayload<BeginPassCommand>(payload).name);
+		});
+		return names;
+	}
+
+	template<typename T>
+	void CommandStream::push(CommandType type, const T& payload)
+	{
+		const uint32_t payloadSize = PAYLOAD_SIZES[static_cast<size_t>(type)];
+		const size_t offset = m_data.size();
+		m_data.resize(offset + sizeof(CommandHeader) + payloadSize);
+
+		const CommandHeader header{ type, payloadSize };
+		std::memcpy(m_data.data() + offset, &header, sizeof(header));
+		if constexpr (!std::is_null_pointer_v<T>) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			std::memcpy(m_data.data() + offset + sizeof(header), &payload, sizeof(T));
+		}
+		++m_commandCount;
+	}
+
+	template<typename Visitor>
+	void CommandStream::forEachCommand(Visitor&& visitor) const
+	{
+		for (size_t offset = 0; offset < m_data.size();) {
+			const auto header = readPayload<CommandHeader>(m_data.data() + offset);
+			visitor(header.type, m_data.data() + offset + sizeof(CommandHeader));
+			offset += sizeof(CommandHeader) + header.size;
+		}
+	}
+
+	template<typename Visitor>
+	void CommandStream::forEachCommand(Visitor&& visitor)
+	{
+		for (size_t offset = 0; offset < m_data.size();) {
+			const auto header = readPayload<CommandHeader>(m_data.data() + offset);
+			visitor(header.type, m_data.data() + offset + sizeof(CommandHeader));
+			offset += sizeof(CommandHeader) + header.size;
+		}
+	}
+}
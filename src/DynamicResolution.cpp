@@ -0,0 +1,409 @@
+#include "DynamicResolution.h"
+#include "ShaderCompiler.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		// Catmull-Rom in 9 bilinear taps instead of 16 point taps, the two middle weights of each axis share
+		// one linear fetch. Taps are clamped to the rendered rect, the rest of the target holds stale pixels.
+		constexpr const char* UPSCALE_SHADER = R"(
+#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D scene;
+layout(set = 0, binding = 1, rgba16f) uniform writeonly image2D upscaled;
+
+layout(push_constant) uniform PushConstants {
+	uvec2 outputExtent;
+	// scene texels per output pixel
+	vec2 sourceScale;
+	vec2 texelSize;
+	// last texel center of the rendered rect
+	vec2 maxUv;
+};
+
+vec2 clampUv(vec2 uv)
+{
+	return clamp(uv, 0.5 * texelSize, maxUv);
+}
+
+vec3 sampleCatmullRom(vec2 position)
+{
+	vec2 center = floor(position - 0.5) + 0.5;
+	vec2 f = position - center;
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+	vec2 uv0 = clampUv((center - 1.0) * texelSize);
+	vec2 uv12 = clampUv((center + w2 / w12) * texelSize);
+	vec2 uv3 = clampUv((center + 2.0) * texelSize);
+
+	vec3 color = textureLod(scene, vec2(uv0.x, uv0.y), 0.0).rgb * w0.x * w0.y;
+	color += textureLod(scene, vec2(uv12.x, uv0.y), 0.0).rgb * w12.x * w0.y;
+	color += textureLod(scene, vec2(uv3.x, uv0.y), 0.0).rgb * w3.x * w0.y;
+	color += textureLod(scene, vec2(uv0.x, uv12.y), 0.0).rgb * w0.x * w12.y;
+	color += textureLod(scene, vec2(uv12.x, uv12.y), 0.0).rgb * w12.x * w12.y;
+	color += textureLod(scene, vec2(uv3.x, uv12.y), 0.0).rgb * w3.x * w12.y;
+	color += textureLod(scene, vec2(uv0.x, uv3.y), 0.0).rgb * w0.x * w3.y;
+	color += textureLod(scene, vec2(uv12.x, uv3.y), 0.0).rgb * w12.x * w3.y;
+	color += textureLod(scene, vec2(uv3.x, uv3.y), 0.0).rgb * w3.x * w3.y;
+	// the negative lobes ring below zero on hard edges
+	return max(color, vec3(0.0));
+}
+
+void main()
+{
+	uvec2 pixel = gl_GlobalInvocationID.xy;
+	if (pixel.x >= outputExtent.x || pixel.y >= outputExtent.y) return;
+
+	vec2 position = (vec2(pixel) + 0.5) * sourceScale;
+	imageStore(upscaled, ivec2(pixel), vec4(sampleCatmullRom(position), 1.0));
+}
+)";
+
+		struct PushConstants {
+			uint32_t outputWidth;
+			uint32_t outputHeight;
+			float scaleX;
+			float scaleY;
+			float texelWidth;
+			float texelHeight;
+			float maxU;
+			float maxV;
+		};
+
+		constexpr vk::Format UPSCALED_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+	}
+
+	DynamicResolution::DynamicResolution(VKContext& context, ResourceRegistry& registry, PipelineCache& pipelineCache,
+		const DynamicResolutionSettings& settings)
+		: m_context(context), m_registry(registry), m_pipelineCache(pipelineCache), m_settings(settings)
+	{
+		if (settings.minScale <= 0.0f || settings.minScale > settings.maxScale || settings.targetMilliseconds <= 0.0f) {
+			spdlog::error("Invalid dynamic resolution settings, scale {} to {} for {} ms!", settings.minScale, settings.maxScale,
+				settings.targetMilliseconds);
+			throw std::runtime_error("Invalid dynamic resolution settings!");
+		}
+		m_stats.scale = settings.maxScale;
+		createPipeline();
+
+		// without timestamps the scale stays at maxScale
+		const auto queueFamilies = context.getPhysicalDevice().getQueueFamilyProperties();
+		const uint32_t validBits = queueFamilies[context.getGraphicQueueFamilyIndex()].timestampValidBits;
+		if (validBits == 0) {
+			spdlog::warn("Graphics queue has no timestamps, dynamic resolution stays at scale {}", settings.maxScale);
+			return;
+		}
+		auto queryPool = context.getDevice()->createQueryPoolUnique(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 2 * MAX_FRAMES_IN_FLIGHT));
+		if (queryPool.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create frame timing query pool! Error code: {}", vk::to_string(queryPool.result));
+			throw std::runtime_error("Failed to create frame timing query pool!");
+		}
+		m_queryPool = std::move(queryPool.value);
+		m_timestampPeriod = context.getPhysicalDevice().getProperties().limits.timestampPeriod;
+		m_timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+	}
+
+	DynamicResolution::~DynamicResolution()
+	{
+		if (m_sceneTarget.isValid()) {
+			m_registry.destroy(m_sceneView);
+			m_registry.destroy(m_sceneTarget);
+			m_registry.destroy(m_upscaledView);
+			m_registry.destroy(m_upscaled);
+		}
+	}
+
+	void DynamicResolution::update(uint32_t frameSlot, vk::Extent2D outputExtent)
+	{
+		readTiming(frameSlot);
+		if (outputExtent.width == 0 || outputExtent.height == 0) return;
+
+		const vk::Extent2D targetExtent(static_cast<uint32_t>(std::ceil(outputExtent.width * m_settings.maxScale)),
+			static_cast<uint32_t>(std::ceil(outputExtent.height * m_settings.maxScale)));
+		if (targetExtent.width > m_targetExtent.width || targetExtent.height > m_targetExtent.height ||
+			outputExtent.width > m_upscaledExtent.width || outputExtent.height > m_upscaledExtent.height) {
+			createTargets(outputExtent);
+		}
+		m_outputExtent = outputExtent;
+		updateRenderExtent();
+	}
+
+	void DynamicResolution::beginTiming(vk::CommandBuffer commandBuffer, uint32_t frameSlot)
+	{
+		if (!m_queryPool) return;
+		commandBuffer.resetQueryPool(m_queryPool.get(), 2 * frameSlot, 2);
+		// a top of pipe timestamp would not wait for the swapchain image and count the acquire latency as GPU time
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTransfer, m_queryPool.get(), 2 * frameSlot);
+	}
+
+	void DynamicResolution::endTiming(vk::CommandBuffer commandBuffer, uint32_t frameSlot)
+	{
+		if (!m_queryPool) return;
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool.get(), 2 * frameSlot + 1);
+		m_isTimingWritten[frameSlot] = true;
+	}
+
+	void DynamicResolution::recordUpscale(vk::CommandBuffer commandBuffer, uint32_t frameSlot, ImageHandle output, vk::ImageLayout finalLayout)
+	{
+		const ImageResource* outputImage = m_registry.get(output);
+		if (outputImage == nullptr || !m_sceneTarget.isValid()) {
+			spdlog::error("Can not upscale to image {}:{}, it is stale or no frame was rendered!", output.index, output.generation);
+			throw std::runtime_error("Invalid upscale output!");
+		}
+		const ImageResource& scene = *m_registry.get(m_sceneTarget);
+		const vk::Extent2D renderExtent = m_stats.renderExtent;
+		const vk::Extent2D outputExtent(std::min(outputImage->extent.width, m_upscaledExtent.width),
+			std::min(outputImage->extent.height, m_upscaledExtent.height));
+
+		const vk::ImageSubresourceRange colorRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+		const vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+		vk::ImageBlit blit{};
+		blit.srcSubresource = layers;
+		blit.dstSubresource = layers;
+		blit.dstOffsets[1] = vk::Offset3D(static_cast<int32_t>(outputExtent.width), static_cast<int32_t>(outputExtent.height), 1);
+		std::array<vk::ImageMemoryBarrier, 2> barriers;
+
+		// the output's old contents are overwritten, its acquire semaphore waits at the transfer stage
+		const vk::Pipeline pipeline = getPipeline();
+		if (pipeline) {
+			if (m_descriptorGenerations[frameSlot] != m_targetGeneration) writeDescriptorSet(frameSlot);
+			const ImageResource& upscaled = *m_registry.get(m_upscaled);
+
+			barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eShaderRead, scene.layout,
+				vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, scene.image, colorRange);
+			barriers[1] = vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, upscaled.image, colorRange);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eComputeShader,
+				{}, nullptr, nullptr, barriers);
+			m_registry.setImageLayout(m_sceneTarget, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+			const PushConstants pushConstants{ outputExtent.width, outputExtent.height,
+				static_cast<float>(renderExtent.width) / outputExtent.width, static_cast<float>(renderExtent.height) / outputExtent.height,
+				1.0f / m_targetExtent.width, 1.0f / m_targetExtent.height,
+				(renderExtent.width - 0.5f) / m_targetExtent.width, (renderExtent.height - 0.5f) / m_targetExtent.height };
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, m_descriptorSets[frameSlot], nullptr);
+			commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+			commandBuffer.dispatch((outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+			// swapchain formats rarely allow storage writes, the upscaled image is copied over with a 1:1 blit
+			barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eGeneral,
+				vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, upscaled.image, colorRange);
+			barriers[1] = vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, outputImage->image, colorRange);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
+			m_registry.setImageLayout(m_upscaled, vk::ImageLayout::eTransferSrcOptimal);
+
+			blit.srcOffsets[1] = blit.dstOffsets[1];
+			commandBuffer.blitImage(upscaled.image, vk::ImageLayout::eTransferSrcOptimal, outputImage->image, vk::ImageLayout::eTransferDstOptimal,
+				blit, vk::Filter::eNearest);
+		}
+		else {
+			// until the pipeline compiled
+			barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead, scene.layout,
+				vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, scene.image, colorRange);
+			barriers[1] = vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, outputImage->image, colorRange);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+				{}, nullptr, nullptr, barriers);
+			m_registry.setImageLayout(m_sceneTarget, vk::ImageLayout::eTransferSrcOptimal);
+
+			blit.srcOffsets[1] = vk::Offset3D(static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1);
+			commandBuffer.blitImage(scene.image, vk::ImageLayout::eTransferSrcOptimal, outputImage->image, vk::ImageLayout::eTransferDstOptimal,
+				blit, vk::Filter::eLinear);
+		}
+
+		barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead, vk::ImageLayout::eTransferDstOptimal,
+			finalLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, outputImage->image, colorRange);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+			{}, nullptr, nullptr, barriers[0]);
+		m_registry.setImageLayout(output, finalLayout);
+	}
+
+	void DynamicResolution::createPipeline()
+	{
+		const std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+		};
+		m_descriptorSetLayout = m_pipelineCache.getDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, bindings));
+
+		const vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants));
+		m_pipelineLayout = m_pipelineCache.getPipelineLayout(vk::PipelineLayoutCreateInfo({}, m_descriptorSetLayout, pushConstantRange));
+
+		const auto spirv = compileShader(vk::ShaderStageFlagBits::eCompute, UPSCALE_SHADER, "upscale.comp", m_context.getCapabilities().apiVersion);
+		m_shaderModule = m_pipelineCache.getShaderModule(spirv);
+		// queues the compile, frames are blitted until it finished
+		static_cast<void>(getPipeline());
+
+		vk::SamplerCreateInfo samplerInfo{};
+		samplerInfo.magFilter = vk::Filter::eLinear;
+		samplerInfo.minFilter = vk::Filter::eLinear;
+		samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+		samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+		samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+		samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+		m_sampler = m_pipelineCache.getSampler(samplerInfo);
+
+		auto& device = m_context.getDevice();
+		const std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+			vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MAX_FRAMES_IN_FLIGHT),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, MAX_FRAMES_IN_FLIGHT),
+		};
+		auto descriptorPool = device->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, MAX_FRAMES_IN_FLIGHT, poolSizes));
+		if (descriptorPool.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create upscale descriptor pool! Error code: {}", vk::to_string(descriptorPool.result));
+			throw std::runtime_error("Failed to create upscale descriptor pool!");
+		}
+		m_descriptorPool = std::move(descriptorPool.value);
+
+		std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(m_descriptorSetLayout);
+		auto descriptorSets = device->allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), layouts));
+		if (descriptorSets.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to allocate upscale descriptor sets! Error code: {}", vk::to_string(descriptorSets.result));
+			throw std::runtime_error("Failed to allocate upscale descriptor sets!");
+		}
+		std::copy(descriptorSets.value.begin(), descriptorSets.value.end(), m_descriptorSets.begin());
+	}
+
+	void DynamicResolution::createTargets(vk::Extent2D outputExtent)
+	{
+		// only ever grows, a window going back to a smaller size keeps its targets
+		m_targetExtent = vk::Extent2D(
+			std::max(m_targetExtent.width, static_cast<uint32_t>(std::ceil(outputExtent.width * m_settings.maxScale))),
+			std::max(m_targetExtent.height, static_cast<uint32_t>(std::ceil(outputExtent.height * m_settings.maxScale))));
+		m_upscaledExtent = vk::Extent2D(std::max(m_upscaledExtent.width, outputExtent.width), std::max(m_upscaledExtent.height, outputExtent.height));
+
+		// frames in flight may still sample the old targets, the registry destroys them once they completed
+		if (m_sceneTarget.isValid()) {
+			m_registry.destroy(m_sceneView);
+			m_registry.destroy(m_sceneTarget);
+			m_registry.destroy(m_upscaledView);
+			m_registry.destroy(m_upscaled);
+		}
+
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.imageType = vk::ImageType::e2D;
+		imageCreateInfo.format = m_settings.format;
+		imageCreateInfo.extent = vk::Extent3D(m_targetExtent.width, m_targetExtent.height, 1);
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+		imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+		imageCreateInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled |
+			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+		imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+		imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+		VmaAllocationCreateInfo allocationCreateInfo{};
+		allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		// written and read every frame, the last memory to page out when the device supports memory priority
+		allocationCreateInfo.priority = 1.0f;
+		m_sceneTarget = m_registry.createImage(imageCreateInfo, allocationCreateInfo);
+
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo.viewType = vk::ImageViewType::e2D;
+		viewInfo.format = m_settings.format;
+		viewInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+		m_sceneView = m_registry.createImageView(m_sceneTarget, viewInfo);
+
+		imageCreateInfo.format = UPSCALED_FORMAT;
+		imageCreateInfo.extent = vk::Extent3D(m_upscaledExtent.width, m_upscaledExtent.height, 1);
+		imageCreateInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc;
+		m_upscaled = m_registry.createImage(imageCreateInfo, allocationCreateInfo);
+		viewInfo.format = UPSCALED_FORMAT;
+		m_upscaledView = m_registry.createImageView(m_upscaled, viewInfo);
+
+		++m_targetGeneration;
+		spdlog::info("Dynamic resolution target {}x{}, output {}x{}", m_targetExtent.width, m_targetExtent.height,
+			m_upscaledExtent.width, m_upscaledExtent.height);
+	}
+
+	void DynamicResolution::writeDescriptorSet(uint32_t frameSlot)
+	{
+		// the slot's previous frame completed, nothing uses its set
+		const vk::DescriptorImageInfo sceneInfo(m_sampler, m_registry.get(m_sceneView)->view, vk::ImageLayout::eShaderReadOnlyOptimal);
+		const vk::DescriptorImageInfo upscaledInfo(nullptr, m_registry.get(m_upscaledView)->view, vk::ImageLayout::eGeneral);
+		const std::array<vk::WriteDescriptorSet, 2> writes = {
+			vk::WriteDescriptorSet(m_descriptorSets[frameSlot], 0, 0, vk::DescriptorType::eCombinedImageSampler, sceneInfo),
+			vk::WriteDescriptorSet(m_descriptorSets[frameSlot], 1, 0, vk::DescriptorType::eStorageImage, upscaledInfo),
+		};
+		m_context.getDevice()->updateDescriptorSets(writes, nullptr);
+		m_descriptorGenerations[frameSlot] = m_targetGeneration;
+	}
+
+	void DynamicResolution::readTiming(uint32_t frameSlot)
+	{
+		if (!m_queryPool || !m_isTimingWritten[frameSlot]) return;
+		m_isTimingWritten[frameSlot] = false;
+
+		// the slot fence signaled, the results are available without waiting
+		std::array<uint64_t, 2> timestamps{};
+		const auto result = m_context.getDevice()->getQueryPoolResults(m_queryPool.get(), 2 * frameSlot, 2,
+			sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess) return;
+
+		const uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+		updateScale(static_cast<float>(ticks * m_timestampPeriod * 1e-6));
+	}
+
+	void DynamicResolution::updateScale(float gpuMilliseconds)
+	{
+		// spikes are followed quickly, drops in load slowly
+		float& smoothed = m_stats.smoothedMilliseconds;
+		const float smoothing = gpuMilliseconds > smoothed ? 0.5f : 0.1f;
+		smoothed = smoothed == 0.0f ? gpuMilliseconds : smoothed + (gpuMilliseconds - smoothed) * smoothing;
+		m_stats.gpuMilliseconds = gpuMilliseconds;
+
+		// the frames in flight were recorded at the old scale, their times say nothing about the new one
+		if (m_cooldownFrames != 0) {
+			--m_cooldownFrames;
+			return;
+		}
+
+		const float budget = m_settings.targetMilliseconds;
+		const float comfortable = budget * (1.0f - m_settings.headroom);
+		if (smoothed <= budget && smoothed >= comfortable) return;
+
+		// GPU time follows the pixel count, the scale applies to both axes, aim for the middle of the band
+		const float aim = (budget + comfortable) * 0.5f;
+		float scale = m_stats.scale * std::sqrt(aim / std::max(smoothed, 0.001f));
+		// shrinking fast avoids dropped frames, growing slowly avoids overshooting into them
+		scale = std::clamp(scale, m_stats.scale * 0.75f, m_stats.scale * 1.05f);
+		scale = std::clamp(scale, m_settings.minScale, m_settings.maxScale);
+		if (std::abs(scale - m_stats.scale) < 0.01f) return;
+
+		m_stats.scale = scale;
+		++m_stats.scaleChanges;
+		m_cooldownFrames = MAX_FRAMES_IN_FLIGHT + 1;
+		updateRenderExtent();
+	}
+
+	void DynamicResolution::updateRenderExtent() noexcept
+	{
+		// multiples of 8 keep the extent from flickering by a pixel and match the upscale's workgroups
+		const auto scaleSize = [this](uint32_t size, uint32_t limit) {
+			const uint32_t scaled = static_cast<uint32_t>(size * m_stats.scale) & ~7u;
+			return std::clamp(scaled, std::min(8u, limit), limit);
+		};
+		m_stats.renderExtent = vk::Extent2D(scaleSize(m_outputExtent.width, m_targetExtent.width),
+			scaleSize(m_outputExtent.height, m_targetExtent.height));
+	}
+
+	vk::Pipeline DynamicResolution::getPipeline()
+	{
+		const vk::ComputePipelineCreateInfo createInfo({},
+			vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, m_shaderModule, "main"), m_pipelineLayout);
+		return m_pipelineCache.getPipeline(createInfo);
+	}
+}
@@ -0,0 +1,678 @@
+#include "FrameCapture.h"
+#include "TextureFormat.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace coldwind {
+	namespace {
+		// "CWCP", the layout of every record below is part of the version
+		constexpr uint32_t CAPTURE_MAGIC = 0x50435743;
+		constexpr uint32_t CAPTURE_VERSION = 2;
+
+		enum class ChunkType : uint32_t {
+			Buffer,
+			Image,
+			// contents when the capture began, images also once written outside the command streams
+			BufferData,
+			ImageData,
+			Frame,
+			// bytes the CPU wrote to a mapped buffer for the frame chunk that follows
+			BufferWrite
+		};
+
+		struct FileHeader {
+			uint32_t magic = CAPTURE_MAGIC;
+			uint32_t version = CAPTURE_VERSION;
+			uint32_t frameCount = 0;
+			uint32_t reserved = 0;
+		};
+
+		struct ChunkHeader {
+			ChunkType type;
+			uint32_t reserved;
+			// record and data bytes that follow
+			uint64_t size;
+		};
+
+		struct BufferRecord {
+			uint32_t index;
+			uint32_t generation;
+			uint64_t size;
+			uint32_t usage;
+			uint32_t isMapped;
+		};
+
+		struct ImageRecord {
+			uint32_t index;
+			uint32_t generation;
+			uint32_t format;
+			uint32_t width;
+			uint32_t height;
+			uint32_t depth;
+			uint32_t mipLevels;
+			uint32_t arrayLayers;
+			uint32_t usage;
+			uint32_t layout;
+			uint32_t isImported;
+			uint32_t reserved;
+		};
+
+		// followed by the buffer bytes at offset
+		struct DataRecord {
+			uint32_t index;
+			uint32_t generation;
+			uint64_t offset;
+		};
+
+		// followed by the mip levels in order, each with all of its layers
+		struct ImageDataRecord {
+			uint32_t index;
+			uint32_t generation;
+			// layout of the image once the contents are restored
+			uint32_t layout;
+			uint32_t reserved;
+		};
+
+		template<typename T>
+		T readRecord(const std::vector<std::byte>& chunk, const std::string& path)
+		{
+			if (chunk.size() < sizeof(T)) {
+				spdlog::error("Capture {} has a chunk of {} bytes, {} are required!", path, chunk.size(), sizeof(T));
+				throw std::runtime_error("Invalid capture file!");
+			}
+			T record;
+			std::memcpy(&record, chunk.data(), sizeof(T));
+			return record;
+		}
+
+		template<typename Tag>
+		uint64_t packHandle(Handle<Tag> handle) noexcept
+		{
+			return (static_cast<uint64_t>(handle.index) << 32) | handle.generation;
+		}
+
+		bool isDepthFormat(vk::Format format) noexcept
+		{
+			return format >= vk::Format::eD16Unorm && format <= vk::Format::eD32SfloatS8Uint;
+		}
+
+		vk::DeviceSize getMipLevelByteSize(const ImageResource& image, uint32_t mipLevel) noexcept
+		{
+			return getMipByteSize(image.format, getMipExtent(image.extent.width, mipLevel), getMipExtent(image.extent.height, mipLevel)) *
+				getMipExtent(image.extent.depth, mipLevel) * image.arrayLayers;
+		}
+
+		vk::DeviceSize getImageByteSize(const ImageResource& image) noexcept
+		{
+			vk::DeviceSize size = 0;
+			for (uint32_t mipLevel = 0; mipLevel < image.mipLevels; ++mipLevel) size += getMipLevelByteSize(image, mipLevel);
+			return size;
+		}
+
+		vk::BufferImageCopy getMipLevelCopy(const ImageResource& image, uint32_t mipLevel, vk::DeviceSize bufferOffset) noexcept
+		{
+			vk::BufferImageCopy region{};
+			region.bufferOffset = bufferOffset;
+			region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mipLevel, 0, image.arrayLayers);
+			region.imageExtent = vk::Extent3D(getMipExtent(image.extent.width, mipLevel), getMipExtent(image.extent.height, mipLevel),
+				getMipExtent(image.extent.depth, mipLevel));
+			return region;
+		}
+
+		void recordLayoutTransition(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+		{
+			vk::ImageMemoryBarrier barrier{};
+			barrier.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+				{}, nullptr, nullptr, barrier);
+		}
+
+		/// Host visible buffer for the one off copies of capture and replay setup.
+		class StagingBuffer {
+		public:
+			StagingBuffer(VKContext& context, vk::DeviceSize size, bool isReadback)
+				: m_context(context)
+			{
+				vk::BufferCreateInfo bufferCreateInfo{};
+				bufferCreateInfo.size = size;
+				bufferCreateInfo.usage = isReadback ? vk::BufferUsageFlagBits::eTransferDst : vk::BufferUsageFlagBits::eTransferSrc;
+				bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+				VmaAllocationCreateInfo allocationCreateInfo{};
+				allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+				allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | (isReadback ?
+					VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+				VkBuffer buffer = VK_NULL_HANDLE;
+				VmaAllocationInfo allocationInfo{};
+				VkResult result = vmaCreateBuffer(m_context.getVmaAllocator(), &static_cast<const VkBufferCreateInfo&>(bufferCreateInfo),
+					&allocationCreateInfo, &buffer, &m_allocation, &allocationInfo);
+				if (result != VK_SUCCESS) {
+					spdlog::error("Failed to create capture staging buffer of {} bytes! Error code: {}", size, vk::to_string(vk::Result(result)));
+					throw std::runtime_error("Failed to create capture staging buffer!");
+				}
+				m_buffer = buffer;
+				m_mapped = static_cast<std::byte*>(allocationInfo.pMappedData);
+			}
+			StagingBuffer(const StagingBuffer&) = delete;
+			StagingBuffer& operator=(const StagingBuffer&) = delete;
+			~StagingBuffer()
+			{
+				vmaDestroyBuffer(m_context.getVmaAllocator(), m_buffer, m_allocation);
+			}
+
+			[[nodiscard]] vk::Buffer getBuffer() const noexcept { return m_buffer; }
+			[[nodiscard]] std::byte* getMapped() const noexcept { return m_mapped; }
+			[[nodiscard]] VmaAllocation getAllocation() const noexcept { return m_allocation; }
+
+		private:
+			VKContext& m_context;
+			vk::Buffer m_buffer;
+			VmaAllocation m_allocation = nullptr;
+			std::byte* m_mapped = nullptr;
+		};
+
+		template<typename Record>
+		void submitAndWait(VKContext& context, Record&& record)
+		{
+			auto& device = context.getDevice();
+			auto commandPool = device->createCommandPoolUnique(
+				vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, context.getGraphicQueueFamilyIndex()));
+			if (commandPool.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create capture command pool! Error code: {}", vk::to_string(commandPool.result));
+				throw std::runtime_error("Failed to create capture command pool!");
+			}
+			auto commandBuffers = device->allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(commandPool.value.get(), vk::CommandBufferLevel::ePrimary, 1));
+			if (commandBuffers.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to allocate capture command buffer! Error code: {}", vk::to_string(commandBuffers.result));
+				throw std::runtime_error("Failed to allocate capture command buffer!");
+			}
+			auto fence = device->createFenceUnique(vk::FenceCreateInfo());
+			if (fence.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create capture fence! Error code: {}", vk::to_string(fence.result));
+				throw std::runtime_error("Failed to create capture fence!");
+			}
+
+			const vk::CommandBuffer commandBuffer = commandBuffers.value[0].get();
+			static_cast<void>(commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)));
+			record(commandBuffer);
+			static_cast<void>(commandBuffer.end());
+
+			vk::SubmitInfo submitInfo{};
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			auto result = context.getGraphicsQueue().submit(submitInfo, fence.value.get());
+			if (result == vk::Result::eSuccess) result = device->waitForFences(fence.value.get(), VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) {
+				spdlog::error("Failed to execute capture copies! Error code: {}", vk::to_string(result));
+				throw std::runtime_error("Failed to execute capture copies!");
+			}
+		}
+	}
+
+	FrameCapture::FrameCapture(VKContext& context, ResourceRegistry& registry)
+		: m_context(context), m_registry(registry)
+	{
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		if (isCapturing()) end();
+	}
+
+	void FrameCapture::begin(const std::string& path, uint32_t frameCount)
+	{
+		if (isCapturing()) {
+			spdlog::error("Capture {} requested while {} is still being captured!", path, m_path);
+			throw std::runtime_error("A capture is already running!");
+		}
+
+		m_stream.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_stream) {
+			spdlog::error("Failed to create capture file {}!", path);
+			throw std::runtime_error("Failed to create capture file!");
+		}
+		m_path = path;
+		m_frameCount = frameCount;
+		m_capturedFrames = 0;
+		m_writtenBuffers.clear();
+		m_writtenImages.clear();
+
+		const FileHeader header;
+		m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		static_cast<void>(m_context.getDevice()->waitIdle());
+		writeNewResources();
+
+		std::vector<BufferHandle> buffers;
+		std::vector<ImageHandle> images;
+		for (uint32_t i = 0; i < m_registry.getBuffers().size(); ++i) buffers.push_back(m_registry.getBuffers().getHandle(i));
+		for (uint32_t i = 0; i < m_registry.getImages().size(); ++i) images.push_back(m_registry.getImages().getHandle(i));
+		writeContents(buffers, images);
+		spdlog::info("Capturing {} frames to {}, {} buffers and {} images", frameCount, path,
+			m_writtenBuffers.size(), m_writtenImages.size());
+	}
+
+	void FrameCapture::recordFrame(const CommandStream& stream)
+	{
+		if (!isCapturing()) return;
+
+		writeNewResources();
+
+		// e.g. streamed textures the transfer queue finished, read back like initial contents
+		if (!m_registry.getImageWrites().empty()) writeContents({}, m_registry.getImageWrites());
+		for (const BufferWrite& write : m_registry.getBufferWrites()) {
+			const BufferResource* buffer = m_registry.get(write.buffer);
+			if (buffer == nullptr || buffer->mapped == nullptr) continue;
+
+			const DataRecord record{ write.buffer.index, write.buffer.generation, write.offset };
+			writeChunk(static_cast<uint32_t>(ChunkType::BufferWrite), &record, sizeof(record),
+				static_cast<const std::byte*>(buffer->mapped) + write.offset, write.size);
+		}
+
+		const auto data = stream.getData();
+		writeChunk(static_cast<uint32_t>(ChunkType::Frame), nullptr, 0, data.data(), data.size());
+		if (++m_capturedFrames == m_frameCount) end();
+	}
+
+	void FrameCapture::writeChunk(uint32_t type, const void* header, size_t headerSize, const void* data, size_t dataSize)
+	{
+		const ChunkHeader chunk{ static_cast<ChunkType>(type), 0, headerSize + dataSize };
+		m_stream.write(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+		if (headerSize != 0) m_stream.write(static_cast<const char*>(header), static_cast<std::streamsize>(headerSize));
+		if (dataSize != 0) m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(dataSize));
+		if (!m_stream) {
+			spdlog::error("Failed to write capture file {}!", m_path);
+			m_stream.close();
+			throw std::runtime_error("Failed to write capture file!");
+		}
+	}
+
+	void FrameCapture::writeNewResources()
+	{
+		const auto& buffers = m_registry.getBuffers();
+		for (uint32_t i = 0; i < buffers.size(); ++i) {
+			const BufferHandle handle = buffers.getHandle(i);
+			if (!m_writtenBuffers.insert(packHandle(handle)).second) continue;
+
+			const BufferResource& buffer = buffers.getValues()[i];
+			const BufferRecord record{ handle.index, handle.generation, buffer.size,
+				static_cast<uint32_t>(buffer.usage), buffer.mapped != nullptr };
+			writeChunk(static_cast<uint32_t>(ChunkType::Buffer), &record, sizeof(record));
+		}
+
+		const auto& images = m_registry.getImages();
+		for (uint32_t i = 0; i < images.size(); ++i) {
+			const ImageHandle handle = images.getHandle(i);
+			if (!m_writtenImages.insert(packHandle(handle)).second) continue;
+
+			const ImageResource& image = images.getValues()[i];
+			const ImageRecord record{ handle.index, handle.generation, static_cast<uint32_t>(image.format),
+				image.extent.width, image.extent.height, image.extent.depth, image.mipLevels, image.arrayLayers,
+				static_cast<uint32_t>(image.usage), static_cast<uint32_t>(image.layout), image.allocation == nullptr, 0 };
+			writeChunk(static_cast<uint32_t>(ChunkType::Image), &record, sizeof(record));
+		}
+	}
+
+	void FrameCapture::writeContents(std::span<const BufferHandle> buffers, std::span<const ImageHandle> images)
+	{
+		struct Readback {
+			uint32_t index;
+			vk::DeviceSize offset;
+		};
+		std::vector<Readback> bufferReadbacks;
+		std::vector<Readback> imageReadbacks;
+		vk::DeviceSize stagingSize = 0;
+		uint32_t unreadable = 0;
+		uint32_t imported = 0;
+		uint32_t undefined = 0;
+
+		for (uint32_t i = 0; i < buffers.size(); ++i) {
+			const BufferResource& buffer = *m_registry.get(buffers[i]);
+			// the CPU wrote mapped buffers, their bytes need no copy
+			if (buffer.mapped != nullptr) {
+				const DataRecord record{ buffers[i].index, buffers[i].generation, 0 };
+				writeChunk(static_cast<uint32_t>(ChunkType::BufferData), &record, sizeof(record), buffer.mapped, buffer.size);
+				continue;
+			}
+			if (!(buffer.usage & vk::BufferUsageFlagBits::eTransferSrc)) {
+				++unreadable;
+				continue;
+			}
+			bufferReadbacks.push_back(Readback{ i, stagingSize });
+			stagingSize += (buffer.size + 15) & ~vk::DeviceSize(15);
+		}
+
+		for (uint32_t i = 0; i < images.size(); ++i) {
+			const ImageResource& image = *m_registry.get(images[i]);
+			if (image.allocation == nullptr) {
+				++imported;
+				continue;
+			}
+			if (image.layout == vk::ImageLayout::eUndefined) {
+				++undefined;
+				continue;
+			}
+			if (!(image.usage & vk::ImageUsageFlagBits::eTransferSrc) || isDepthFormat(image.format) ||
+				image.layout == vk::ImageLayout::ePreinitialized) {
+				++unreadable;
+				continue;
+			}
+			imageReadbacks.push_back(Readback{ i, stagingSize });
+			stagingSize += (getImageByteSize(image) + 15) & ~vk::DeviceSize(15);
+		}
+
+		if (unreadable + imported + undefined != 0) {
+			spdlog::warn("{} captured resources replay without contents: {} can not be read back, {} are imported images, "
+				"{} are images in an undefined layout", unreadable + imported + undefined, unreadable, imported, undefined);
+		}
+		if (stagingSize == 0) return;
+
+		StagingBuffer staging(m_context, stagingSize, true);
+		submitAndWait(m_context, [&](vk::CommandBuffer commandBuffer) {
+			for (const Readback& readback : bufferReadbacks) {
+				const BufferResource& buffer = *m_registry.get(buffers[readback.index]);
+				commandBuffer.copyBuffer(buffer.buffer, staging.getBuffer(), vk::BufferCopy(0, readback.offset, buffer.size));
+			}
+			for (const Readback& readback : imageReadbacks) {
+				// images in eGeneral are copied in place, frames in flight may still sample them,
+				// any other layout is only changed by begin() on an idle device
+				const ImageResource& image = *m_registry.get(images[readback.index]);
+				const vk::ImageLayout copyLayout = image.layout == vk::ImageLayout::eGeneral ?
+					vk::ImageLayout::eGeneral : vk::ImageLayout::eTransferSrcOptimal;
+				if (copyLayout != image.layout) recordLayoutTransition(commandBuffer, image.image, image.layout, copyLayout);
+				vk::DeviceSize offset = readback.offset;
+				for (uint32_t mipLevel = 0; mipLevel < image.mipLevels; ++mipLevel) {
+					commandBuffer.copyImageToBuffer(image.image, copyLayout, staging.getBuffer(), getMipLevelCopy(image, mipLevel, offset));
+					offset += getMipLevelByteSize(image, mipLevel);
+				}
+				if (copyLayout != image.layout) recordLayoutTransition(commandBuffer, image.image, copyLayout, image.layout);
+			}
+		});
+		vmaInvalidateAllocation(m_context.getVmaAllocator(), staging.getAllocation(), 0, VK_WHOLE_SIZE);
+
+		for (const Readback& readback : bufferReadbacks) {
+			const BufferHandle handle = buffers[readback.index];
+			const DataRecord record{ handle.index, handle.generation, 0 };
+			writeChunk(static_cast<uint32_t>(ChunkType::BufferData), &record, sizeof(record),
+				staging.getMapped() + readback.offset, m_registry.get(handle)->size);
+		}
+		for (const Readback& readback : imageReadbacks) {
+			const ImageHandle handle = images[readback.index];
+			const ImageResource& image = *m_registry.get(handle);
+			const ImageDataRecord record{ handle.index, handle.generation, static_cast<uint32_t>(image.layout), 0 };
+			writeChunk(static_cast<uint32_t>(ChunkType::ImageData), &record, sizeof(record),
+				staging.getMapped() + readback.offset, getImageByteSize(image));
+		}
+	}
+
+	void FrameCapture::end()
+	{
+		// the header's frame count stays 0 unless the capture completed
+		m_stream.seekp(offsetof(FileHeader, frameCount));
+		m_stream.write(reinterpret_cast<const char*>(&m_capturedFrames), sizeof(m_capturedFrames));
+		m_stream.close();
+		spdlog::info("Captured {} frames to {}", m_capturedFrames, m_path);
+	}
+
+	CaptureReplayer::CaptureReplayer(VKContext& context, ResourceRegistry& registry, const std::string& path)
+		: m_context(context), m_registry(registry)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		FileHeader header;
+		if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CAPTURE_MAGIC) {
+			spdlog::error("{} is not a capture file!", path);
+			throw std::runtime_error("Not a capture file!");
+		}
+		if (header.version != CAPTURE_VERSION || header.frameCount == 0) {
+			spdlog::error("Capture {} has version {} with {} frames, version {} with at least one frame is required!",
+				path, header.version, header.frameCount, CAPTURE_VERSION);
+			throw std::runtime_error("Unsupported capture file!");
+		}
+
+		// a swapchain's present layout has no meaning without a swapchain
+		const auto getReplayLayout = [this](uint32_t layout) {
+			const auto imageLayout = static_cast<vk::ImageLayout>(layout);
+			return m_context.isHeadless() && imageLayout == vk::ImageLayout::ePresentSrcKHR ? vk::ImageLayout::eGeneral : imageLayout;
+		};
+
+		std::unordered_map<uint64_t, BufferHandle> buffers;
+		std::unordered_map<uint64_t, ImageHandle> images;
+		const auto findBuffer = [&](uint32_t index, uint32_t generation) {
+			const auto it = buffers.find(packHandle(BufferHandle{ index, generation }));
+			if (it == buffers.end()) {
+				spdlog::error("Capture {} references unknown buffer {}:{}!", path, index, generation);
+				throw std::runtime_error("Invalid capture file!");
+			}
+			return it->second;
+		};
+		const auto findImage = [&](uint32_t index, uint32_t generation) {
+			const auto it = images.find(packHandle(ImageHandle{ index, generation }));
+			if (it == images.end()) {
+				spdlog::error("Capture {} references unknown image {}:{}!", path, index, generation);
+				throw std::runtime_error("Invalid capture file!");
+			}
+			return it->second;
+		};
+
+		struct InitialContents {
+			BufferHandle buffer;
+			// valid for image contents
+			ImageHandle image;
+			uint64_t offset;
+			std::vector<std::byte> data;
+		};
+		std::vector<InitialContents> initialContents;
+		ReplayFrame frame;
+		// every frame's buffer writes, each in a region of its own
+		std::vector<std::byte> frameStaging;
+		std::vector<std::byte> chunk;
+
+		ChunkHeader chunkHeader;
+		while (stream.read(reinterpret_cast<char*>(&chunkHeader), sizeof(chunkHeader))) {
+			chunk.resize(chunkHeader.size);
+			if (!stream.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()))) {
+				spdlog::error("Capture {} is truncated!", path);
+				throw std::runtime_error("Truncated capture file!");
+			}
+
+			switch (chunkHeader.type) {
+			case ChunkType::Buffer: {
+				const auto record = readRecord<BufferRecord>(chunk, path);
+				vk::BufferCreateInfo bufferCreateInfo{};
+				bufferCreateInfo.size = record.size;
+				bufferCreateInfo.usage = vk::BufferUsageFlags(record.usage) | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+				bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+				VmaAllocationCreateInfo allocationCreateInfo{};
+				allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+				if (record.isMapped) {
+					allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+				}
+				buffers.emplace(packHandle(BufferHandle{ record.index, record.generation }),
+					m_registry.createBuffer(bufferCreateInfo, allocationCreateInfo));
+				break;
+			}
+			case ChunkType::Image: {
+				// imported images are recreated as ordinary images of the same size and format
+				const auto record = readRecord<ImageRecord>(chunk, path);
+				vk::ImageCreateInfo imageCreateInfo{};
+				imageCreateInfo.imageType = record.depth > 1 ? vk::ImageType::e3D : vk::ImageType::e2D;
+				imageCreateInfo.format = static_cast<vk::Format>(record.format);
+				imageCreateInfo.extent = vk::Extent3D(record.width, record.height, record.depth);
+				imageCreateInfo.mipLevels = record.mipLevels;
+				imageCreateInfo.arrayLayers = record.arrayLayers;
+				imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+				imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+				imageCreateInfo.usage = vk::ImageUsageFlags(record.usage) | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+				imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+				imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+				VmaAllocationCreateInfo allocationCreateInfo{};
+				allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+				const ImageHandle image = m_registry.createImage(imageCreateInfo, allocationCreateInfo);
+				images.emplace(packHandle(ImageHandle{ record.index, record.generation }), image);
+				m_images.push_back(ReplayImage{ image, getReplayLayout(record.layout) });
+				break;
+			}
+			case ChunkType::BufferData:
+			case ChunkType::BufferWrite: {
+				const auto record = readRecord<DataRecord>(chunk, path);
+				const BufferHandle buffer = findBuffer(record.index, record.generation);
+				const uint64_t size = chunk.size() - sizeof(DataRecord);
+				if (record.offset + size > m_registry.get(buffer)->size) {
+					spdlog::error("Capture {} writes {} bytes at {} into a buffer of {} bytes!", path, size, record.offset, m_registry.get(buffer)->size);
+					throw std::runtime_error("Invalid capture file!");
+				}
+
+				if (chunkHeader.type == ChunkType::BufferData) {
+					initialContents.push_back(InitialContents{ buffer, ImageHandle{}, record.offset,
+						std::vector<std::byte>(chunk.begin() + sizeof(DataRecord), chunk.end()) });
+					break;
+				}
+				const uint64_t stagingOffset = frameStaging.size();
+				frameStaging.insert(frameStaging.end(), chunk.begin() + sizeof(DataRecord), chunk.end());
+				frameStaging.resize((frameStaging.size() + 15) & ~size_t(15));
+				frame.stagedWrites.push_back(ReplayFrame::StagedWrite{ buffer, record.offset, size, stagingOffset });
+				break;
+			}
+			case ChunkType::ImageData: {
+				const auto record = readRecord<ImageDataRecord>(chunk, path);
+				const ImageHandle image = findImage(record.index, record.generation);
+				std::vector<std::byte> data(chunk.begin() + sizeof(ImageDataRecord), chunk.end());
+				if (data.size() != getImageByteSize(*m_registry.get(image))) {
+					spdlog::error("Capture {} has {} bytes of contents for image {}:{} of {} bytes!", path, data.size(),
+						record.index, record.generation, getImageByteSize(*m_registry.get(image)));
+					throw std::runtime_error("Invalid capture file!");
+				}
+				// images written outside the command streams during the capture are only read by them,
+				// so their contents are restored up front like initial contents
+				const auto replayImage = std::find_if(m_images.begin(), m_images.end(),
+					[image](const ReplayImage& candidate) { return candidate.image == image; });
+				replayImage->initialLayout = getReplayLayout(record.layout);
+				initialContents.push_back(InitialContents{ BufferHandle{}, image, 0, std::move(data) });
+				break;
+			}
+			case ChunkType::Frame:
+				frame.commands.assign(chunk);
+				frame.commands.remapHandles(
+					[&](BufferHandle handle) { return findBuffer(handle.index, handle.generation); },
+					[&](ImageHandle handle) { return findImage(handle.index, handle.generation); });
+				if (m_context.isHeadless()) frame.commands.replaceLayout(vk::ImageLayout::ePresentSrcKHR, vk::ImageLayout::eGeneral);
+				m_frames.push_back(std::move(frame));
+				frame = ReplayFrame();
+				break;
+			default:
+				spdlog::warn("Skipping unknown chunk type {} in capture {}", static_cast<uint32_t>(chunkHeader.type), path);
+				break;
+			}
+		}
+
+		if (m_frames.size() != header.frameCount) {
+			spdlog::error("Capture {} declares {} frames but contains {}!", path, header.frameCount, m_frames.size());
+			throw std::runtime_error("Invalid capture file!");
+		}
+
+		if (!frameStaging.empty()) {
+			vk::BufferCreateInfo bufferCreateInfo{};
+			bufferCreateInfo.size = frameStaging.size();
+			bufferCreateInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+			bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+			VmaAllocationCreateInfo allocationCreateInfo{};
+			allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+			allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+			m_frameStaging = m_registry.createBuffer(bufferCreateInfo, allocationCreateInfo);
+
+			const BufferResource& staging = *m_registry.get(m_frameStaging);
+			std::memcpy(staging.mapped, frameStaging.data(), frameStaging.size());
+			vmaFlushAllocation(m_context.getVmaAllocator(), staging.allocation, 0, VK_WHOLE_SIZE);
+		}
+
+		vk::DeviceSize stagingSize = 0;
+		for (const auto& contents : initialContents) stagingSize += (contents.data.size() + 15) & ~size_t(15);
+		std::unique_ptr<StagingBuffer> staging;
+		if (stagingSize != 0) {
+			staging = std::make_unique<StagingBuffer>(m_context, stagingSize, false);
+			vk::DeviceSize offset = 0;
+			for (const auto& contents : initialContents) {
+				std::memcpy(staging->getMapped() + offset, contents.data.data(), contents.data.size());
+				offset += (contents.data.size() + 15) & ~size_t(15);
+			}
+			vmaFlushAllocation(m_context.getVmaAllocator(), staging->getAllocation(), 0, VK_WHOLE_SIZE);
+		}
+
+		submitAndWait(m_context, [&](vk::CommandBuffer commandBuffer) {
+			vk::DeviceSize offset = 0;
+			for (const auto& contents : initialContents) {
+				if (contents.image.isValid()) {
+					const ImageResource& image = *m_registry.get(contents.image);
+					recordLayoutTransition(commandBuffer, image.image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+					vk::DeviceSize mipOffset = offset;
+					for (uint32_t mipLevel = 0; mipLevel < image.mipLevels; ++mipLevel) {
+						commandBuffer.copyBufferToImage(staging->getBuffer(), image.image, vk::ImageLayout::eTransferDstOptimal,
+							getMipLevelCopy(image, mipLevel, mipOffset));
+						mipOffset += getMipLevelByteSize(image, mipLevel);
+					}
+					m_registry.setImageLayout(contents.image, vk::ImageLayout::eTransferDstOptimal);
+				}
+				else {
+					commandBuffer.copyBuffer(staging->getBuffer(), m_registry.get(contents.buffer)->buffer,
+						vk::BufferCopy(offset, contents.offset, contents.data.size()));
+				}
+				offset += (contents.data.size() + 15) & ~size_t(15);
+			}
+			recordRestoreLayouts(commandBuffer);
+		});
+
+		uint32_t commandCount = 0;
+		for (const auto& replayFrame : m_frames) commandCount += replayFrame.commands.getCommandCount();
+		spdlog::info("Loaded capture {}: {} frames, {} commands, {} buffers, {} images", path, m_frames.size(), commandCount,
+			buffers.size(), images.size());
+	}
+
+	void CaptureReplayer::recordFrame(uint32_t frame, vk::CommandBuffer commandBuffer, vk::QueryPool timestampPool, uint32_t firstQuery,
+		uint32_t queryCount)
+	{
+		const ReplayFrame& replayFrame = m_frames[frame];
+		if (!replayFrame.stagedWrites.empty()) {
+			// the copies wait until earlier frames are done with the buffers, the frame's commands wait for the copies
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {},
+				vk::MemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferWrite), nullptr, nullptr);
+			const vk::Buffer staging = m_registry.get(m_frameStaging)->buffer;
+			for (const auto& write : replayFrame.stagedWrites) {
+				commandBuffer.copyBuffer(staging, m_registry.get(write.buffer)->buffer, vk::BufferCopy(write.stagingOffset, write.offset, write.size));
+			}
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {},
+				vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite),
+				nullptr, nullptr);
+		}
+		replayFrame.commands.execute(commandBuffer, m_registry, timestampPool, firstQuery, queryCount);
+	}
+
+	void CaptureReplayer::recordRestoreLayouts(vk::CommandBuffer commandBuffer)
+	{
+		// an image first seen in an undefined layout is only ever transitioned from undefined by the capture itself
+		for (const ReplayImage& image : m_images) {
+			const ImageResource& resource = *m_registry.get(image.image);
+			if (image.initialLayout == vk::ImageLayout::eUndefined || resource.layout == image.initialLayout) continue;
+
+			recordLayoutTransition(commandBuffer, resource.image, resource.layout, image.initialLayout);
+			m_registry.setImageLayout(image.image, image.initialLayout);
+		}
+	}
+}
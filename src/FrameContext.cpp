@@ -0,0 +1,130 @@
+#include "FrameContext.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace coldwind {
+	FrameContext::FrameContext(VKContext& context, ResourceRegistry& registry, size_t scratchSize, vk::DeviceSize uploadSize)
+		: m_context(context), m_frames(createFrames(scratchSize, std::make_index_sequence<MAX_FRAMES_IN_FLIGHT>{})),
+		m_gpuAllocator(context, registry, uploadSize)
+	{
+		auto& device = m_context.getDevice();
+		for (auto& frame : m_frames) {
+			vk::CommandPoolCreateInfo commandPoolCreateInfo{};
+			commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+			commandPoolCreateInfo.queueFamilyIndex = m_context.getGraphicQueueFamilyIndex();
+			auto commandPool = device->createCommandPoolUnique(commandPoolCreateInfo);
+			if (commandPool.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create frame command pool! Error code: {}", vk::to_string(commandPool.result));
+				throw std::runtime_error("Failed to create frame command pool!");
+			}
+			frame.commandPool = std::move(commandPool.value);
+
+			vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
+			commandBufferAllocateInfo.commandPool = frame.commandPool.get();
+			commandBufferAllocateInfo.level = vk::CommandBufferLevel::ePrimary;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+			auto commandBuffers = device->allocateCommandBuffers(commandBufferAllocateInfo);
+			if (commandBuffers.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to allocate frame command buffer! Error code: {}", vk::to_string(commandBuffers.result));
+				throw std::runtime_error("Failed to allocate frame command buffer!");
+			}
+			frame.commandBuffer = commandBuffers.value[0];
+
+			auto fence = device->createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+			if (fence.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create frame fence! Error code: {}", vk::to_string(fence.result));
+				throw std::runtime_error("Failed to create frame fence!");
+			}
+			frame.inFlight = std::move(fence.value);
+		}
+
+		if (m_context.getCapabilities().timelineSemaphore) {
+			vk::SemaphoreTypeCreateInfo typeCreateInfo(vk::SemaphoreType::eTimeline, 0);
+			auto timeline = device->createSemaphoreUnique(vk::SemaphoreCreateInfo({}, &typeCreateInfo));
+			if (timeline.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create frame timeline semaphore! Error code: {}", vk::to_string(timeline.result));
+				throw std::runtime_error("Failed to create frame timeline semaphore!");
+			}
+			m_timeline = std::move(timeline.value);
+		}
+	}
+
+	void FrameContext::beginFrame()
+	{
+		Frame& frame = m_frames[getFrameSlot()];
+		auto result = m_context.getDevice()->waitForFences(frame.inFlight.get(), VK_TRUE, UINT64_MAX);
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to wait for frame fence! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to wait for frame fence!");
+		}
+
+		frame.scratch.reset();
+		m_gpuAllocator.beginFrame(getFrameSlot());
+	}
+
+	vk::CommandBuffer FrameContext::beginCommands()
+	{
+		Frame& frame = m_frames[getFrameSlot()];
+		auto result = m_context.getDevice()->resetCommandPool(frame.commandPool.get());
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to reset frame command pool! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to reset frame command pool!");
+		}
+
+		result = frame.commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to begin frame command buffer! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to begin frame command buffer!");
+		}
+		return frame.commandBuffer;
+	}
+
+	void FrameContext::submit(std::span<const vk::Semaphore> waitSemaphores, std::span<const vk::PipelineStageFlags> waitStages,
+		std::span<const vk::Semaphore> signalSemaphores)
+	{
+		Frame& frame = m_frames[getFrameSlot()];
+		auto result = frame.commandBuffer.end();
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to end frame command buffer! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to end frame command buffer!");
+		}
+		m_gpuAllocator.flush();
+
+		// the fence is only reset once work that signals it is guaranteed to be submitted
+		static_cast<void>(m_context.getDevice()->resetFences(frame.inFlight.get()));
+
+		vk::SubmitInfo submitInfo{};
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		// the timeline goes last, values of the binary semaphores before it are ignored
+		vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		if (m_timeline) {
+			const size_t signalCount = signalSemaphores.size() + 1;
+			auto* semaphores = frame.scratch.allocateArray<vk::Semaphore>(signalCount);
+			auto* values = frame.scratch.allocateArray<uint64_t>(signalCount);
+			std::copy(signalSemaphores.begin(), signalSemaphores.end(), semaphores);
+			semaphores[signalCount - 1] = m_timeline.get();
+			values[signalCount - 1] = m_frameNumber + 1;
+			timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalCount);
+			timelineSubmitInfo.pSignalSemaphoreValues = values;
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalCount);
+			submitInfo.pSignalSemaphores = semaphores;
+		}
+		result = m_context.getGraphicsQueue().submit(submitInfo, frame.inFlight.get());
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to submit frame! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to submit frame!");
+		}
+
+		++m_frameNumber;
+	}
+}
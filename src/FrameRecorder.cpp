@@ -0,0 +1,467 @@
+#include "FrameRecorder.h"
+#include "ShaderCompiler.h"
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+}
+
+#include <cmath>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		// every invocation converts 8x2 pixels, that is two words of luma per row and one word each of U and V
+		constexpr const char* YUV_CONVERSION_SHADER = R"(
+#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D colorImage;
+layout(set = 0, binding = 1) writeonly buffer Planes { uint words[]; };
+
+layout(push_constant) uniform PushConstants {
+	uvec2 extent;
+	// word offsets of the ring slot's Y, U and V planes
+	uint yOffset;
+	uint uOffset;
+	uint vOffset;
+};
+
+// BT.709 limited range, what players assume for HD video without color tags
+vec3 toYuv(vec3 rgb)
+{
+	float y = dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+	return vec3(16.0 + 219.0 * y, 128.0 + 224.0 * (rgb.b - y) / 1.8556, 128.0 + 224.0 * (rgb.r - y) / 1.5748);
+}
+
+uint packBytes(vec4 values)
+{
+	uvec4 bytes = uvec4(clamp(round(values), 0.0, 255.0));
+	return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+}
+
+void main()
+{
+	uvec2 origin = gl_GlobalInvocationID.xy * uvec2(8, 2);
+	if (origin.x >= extent.x || origin.y >= extent.y) return;
+
+	vec4 u = vec4(0.0);
+	vec4 v = vec4(0.0);
+	for (uint row = 0; row < 2; ++row) {
+		vec4 luma[2];
+		for (uint x = 0; x < 8; ++x) {
+			vec3 yuv = toYuv(imageLoad(colorImage, ivec2(origin + uvec2(x, row))).rgb);
+			luma[x / 4][x % 4] = yuv.x;
+			u[x / 2] += yuv.y * 0.25;
+			v[x / 2] += yuv.z * 0.25;
+		}
+		uint word = yOffset + ((origin.y + row) * extent.x + origin.x) / 4;
+		words[word] = packBytes(luma[0]);
+		words[word + 1] = packBytes(luma[1]);
+	}
+
+	uint chromaWord = ((origin.y / 2) * (extent.x / 2) + origin.x / 2) / 4;
+	words[uOffset + chromaWord] = packBytes(u);
+	words[vOffset + chromaWord] = packBytes(v);
+}
+)";
+
+		struct PushConstants {
+			uint32_t width;
+			uint32_t height;
+			uint32_t yOffset;
+			uint32_t uOffset;
+			uint32_t vOffset;
+		};
+
+		bool isSrgbFormat(vk::Format format) noexcept
+		{
+			switch (format) {
+			case vk::Format::eB8G8R8A8Srgb:
+			case vk::Format::eR8G8B8A8Srgb:
+			case vk::Format::eA8B8G8R8SrgbPack32:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		std::string getErrorString(int error)
+		{
+			char buffer[AV_ERROR_MAX_STRING_SIZE] = {};
+			av_strerror(error, buffer, sizeof(buffer));
+			return buffer;
+		}
+	}
+
+	FrameRecorder::FrameRecorder(VKContext& context, ResourceRegistry& registry, PipelineCache& pipelineCache, vk::Format sourceFormat,
+		const RecordingSettings& settings)
+		: m_context(context), m_registry(registry), m_pipelineCache(pipelineCache), m_settings(settings), m_isSourceSrgb(isSrgbFormat(sourceFormat))
+	{
+		if (settings.width == 0 || settings.width % 8 != 0 || settings.height == 0 || settings.height % 2 != 0 || settings.frameRate == 0) {
+			spdlog::error("Can not record {}x{} at {} fps, the width must be a multiple of 8 and the height even!",
+				settings.width, settings.height, settings.frameRate);
+			throw std::runtime_error("Invalid recording settings!");
+		}
+
+		createTargets(sourceFormat);
+		createPipeline();
+		openEncoder();
+
+		m_startTime = std::chrono::steady_clock::now();
+		m_encoder = std::thread(&FrameRecorder::encoderLoop, this);
+		spdlog::info("Recording {}x{} at {} fps to {}", settings.width, settings.height, settings.frameRate, settings.path);
+	}
+
+	FrameRecorder::~FrameRecorder()
+	{
+		static_cast<void>(m_context.getDevice()->waitIdle());
+		collect(UINT64_MAX);
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_one();
+		m_encoder.join();
+		closeEncoder();
+
+		m_registry.destroy(m_colorView);
+		m_registry.destroy(m_colorImage);
+		m_registry.destroy(m_readbackBuffer);
+
+		const double renderThreadMilliseconds = std::chrono::duration<double, std::milli>(m_renderThreadTime).count();
+		spdlog::info("Recorded {} frames to {}, {} dropped, {:.3f} ms render thread time per frame", getEncodedFrameCount(),
+			m_settings.path, m_droppedFrames, m_recordedFrames != 0 ? renderThreadMilliseconds / m_recordedFrames : 0.0);
+	}
+
+	void FrameRecorder::collect(uint64_t completedFrameNumber)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		uint32_t queued = 0;
+		{
+			std::lock_guard lock(m_mutex);
+			// oldest slot first, the encoder needs increasing timestamps
+			for (uint32_t i = 0; i < RING_SIZE; ++i) {
+				const uint32_t slot = (m_nextSlot + i) % RING_SIZE;
+				if (m_slots[slot].state != SlotState::InFlight || m_slots[slot].frameNumber > completedFrameNumber) continue;
+
+				m_slots[slot].state = SlotState::Encoding;
+				m_encodeQueue[(m_encodeHead + m_encodeCount) % RING_SIZE] = slot;
+				++m_encodeCount;
+				++queued;
+			}
+		}
+		if (queued != 0) m_condition.notify_one();
+		m_renderThreadTime += std::chrono::steady_clock::now() - begin;
+	}
+
+	void FrameRecorder::record(vk::CommandBuffer commandBuffer, ImageHandle source, uint64_t frameNumber)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		const ImageResource* sourceImage = m_registry.get(source);
+		if (sourceImage == nullptr || !(sourceImage->usage & vk::ImageUsageFlagBits::eTransferSrc) ||
+			isSrgbFormat(sourceImage->format) != m_isSourceSrgb) {
+			spdlog::error("Can not record image {}:{}, it is stale, not a transfer source or its format changed!", source.index, source.generation);
+			throw std::runtime_error("Invalid recording source!");
+		}
+
+		// frames come at the render rate, the video gets the ones closest to its own rate
+		const double seconds = std::chrono::duration<double>(begin - m_startTime).count();
+		const int64_t pts = std::llround(seconds * m_settings.frameRate);
+		if (pts <= m_lastPts) return;
+		// skips the frames until the conversion pipeline compiled
+		const vk::Pipeline pipeline = getPipeline();
+		if (!pipeline) return;
+
+		uint32_t slot;
+		{
+			std::lock_guard lock(m_mutex);
+			slot = m_nextSlot;
+			if (m_slots[slot].state != SlotState::Free) {
+				if (m_droppedFrames++ == 0) spdlog::warn("Encoder can not keep up, dropping frames");
+				return;
+			}
+			m_slots[slot] = Slot{ SlotState::InFlight, frameNumber, pts };
+			m_nextSlot = (slot + 1) % RING_SIZE;
+		}
+		m_lastPts = pts;
+
+		const ImageResource& colorImage = *m_registry.get(m_colorImage);
+		const vk::ImageSubresourceRange colorRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+		const vk::ImageLayout sourceLayout = sourceImage->layout;
+
+		std::array<vk::ImageMemoryBarrier, 2> barriers;
+		barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead,
+			sourceLayout, vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, sourceImage->image, colorRange);
+		barriers[1] = vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, colorImage.image, colorRange);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
+
+		const vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+		vk::ImageBlit blit{};
+		blit.srcSubresource = layers;
+		blit.srcOffsets[1] = vk::Offset3D(static_cast<int32_t>(sourceImage->extent.width), static_cast<int32_t>(sourceImage->extent.height), 1);
+		blit.dstSubresource = layers;
+		blit.dstOffsets[1] = vk::Offset3D(static_cast<int32_t>(m_settings.width), static_cast<int32_t>(m_settings.height), 1);
+		const bool isSameSize = sourceImage->extent.width == m_settings.width && sourceImage->extent.height == m_settings.height;
+		commandBuffer.blitImage(sourceImage->image, vk::ImageLayout::eTransferSrcOptimal, colorImage.image, vk::ImageLayout::eTransferDstOptimal,
+			blit, isSameSize ? vk::Filter::eNearest : vk::Filter::eLinear);
+
+		// an undefined source stays readable for the transfer, the registry learns about its new layout
+		const vk::ImageLayout restoredLayout = sourceLayout == vk::ImageLayout::eUndefined ? vk::ImageLayout::eTransferSrcOptimal : sourceLayout;
+		barriers[0] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+			vk::ImageLayout::eTransferSrcOptimal, restoredLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, sourceImage->image, colorRange);
+		barriers[1] = vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, colorImage.image, colorRange);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands | vk::PipelineStageFlagBits::eComputeShader,
+			{}, nullptr, nullptr, barriers);
+		m_registry.setImageLayout(source, restoredLayout);
+
+		const uint32_t slotWord = static_cast<uint32_t>(m_slotSize * slot / 4);
+		const uint32_t lumaWords = m_settings.width * m_settings.height / 4;
+		const PushConstants pushConstants{ m_settings.width, m_settings.height, slotWord, slotWord + lumaWords, slotWord + lumaWords + lumaWords / 4 };
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, m_descriptorSet, nullptr);
+		commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+		commandBuffer.dispatch((m_settings.width / 8 + 7) / 8, (m_settings.height / 2 + 7) / 8, 1);
+
+		const vk::BufferMemoryBarrier readbackBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_registry.get(m_readbackBuffer)->buffer, m_slotSize * slot, m_slotSize);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, {}, nullptr, readbackBarrier, nullptr);
+
+		++m_recordedFrames;
+		m_renderThreadTime += std::chrono::steady_clock::now() - begin;
+	}
+
+	void FrameRecorder::createTargets(vk::Format sourceFormat)
+	{
+		// Y plane and two quarter size chroma planes, slots stay aligned for flushes and word addressing
+		m_slotSize = (vk::DeviceSize(m_settings.width) * m_settings.height * 3 / 2 + 255) & ~vk::DeviceSize(255);
+
+		vk::BufferCreateInfo bufferCreateInfo{};
+		bufferCreateInfo.size = m_slotSize * RING_SIZE;
+		bufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+		bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		// host cached memory, the encoder reads every byte
+		VmaAllocationCreateInfo bufferAllocationInfo{};
+		bufferAllocationInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+		bufferAllocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+		m_readbackBuffer = m_registry.createBuffer(bufferCreateInfo, bufferAllocationInfo);
+		const BufferResource& readback = *m_registry.get(m_readbackBuffer);
+		m_readbackAllocation = readback.allocation;
+		m_readbackMapped = static_cast<uint8_t*>(readback.mapped);
+
+		// an sRGB source is blitted into an sRGB image, the shader reads the encoded bytes through a UNORM view
+		vk::ImageCreateInfo imageCreateInfo{};
+		if (m_isSourceSrgb) imageCreateInfo.flags = vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+		imageCreateInfo.imageType = vk::ImageType::e2D;
+		imageCreateInfo.format = m_isSourceSrgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+		imageCreateInfo.extent = vk::Extent3D(m_settings.width, m_settings.height, 1);
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+		imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+		imageCreateInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage;
+		imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+		imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+		VmaAllocationCreateInfo imageAllocationInfo{};
+		imageAllocationInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		m_colorImage = m_registry.createImage(imageCreateInfo, imageAllocationInfo);
+
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo.viewType = vk::ImageViewType::e2D;
+		viewInfo.format = vk::Format::eR8G8B8A8Unorm;
+		viewInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+		m_colorView = m_registry.createImageView(m_colorImage, viewInfo);
+
+		spdlog::debug("Recording {} source through a {} KiB readback ring", vk::to_string(sourceFormat), (m_slotSize * RING_SIZE) >> 10);
+	}
+
+	vk::Pipeline FrameRecorder::getPipeline()
+	{
+		const vk::ComputePipelineCreateInfo createInfo({},
+			vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, m_shaderModule, "main"), m_pipelineLayout);
+		return m_pipelineCache.getPipeline(createInfo);
+	}
+
+	void FrameRecorder::createPipeline()
+	{
+		auto& device = m_context.getDevice();
+
+		const std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		};
+		m_descriptorSetLayout = m_pipelineCache.getDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, bindings));
+
+		const vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants));
+		m_pipelineLayout = m_pipelineCache.getPipelineLayout(vk::PipelineLayoutCreateInfo({}, m_descriptorSetLayout, pushConstantRange));
+
+		const auto spirv = compileShader(vk::ShaderStageFlagBits::eCompute, YUV_CONVERSION_SHADER, "yuv_conversion.comp",
+			m_context.getCapabilities().apiVersion);
+		m_shaderModule = m_pipelineCache.getShaderModule(spirv);
+		// queues the compile, frames are skipped until it finished
+		static_cast<void>(getPipeline());
+
+		const std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 1),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1),
+		};
+		auto descriptorPool = device->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, 1, poolSizes));
+		if (descriptorPool.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create recorder descriptor pool! Error code: {}", vk::to_string(descriptorPool.result));
+			throw std::runtime_error("Failed to create recorder descriptor pool!");
+		}
+		m_descriptorPool = std::move(descriptorPool.value);
+
+		auto descriptorSets = device->allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_descriptorPool.get(), m_descriptorSetLayout));
+		if (descriptorSets.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to allocate recorder descriptor set! Error code: {}", vk::to_string(descriptorSets.result));
+			throw std::runtime_error("Failed to allocate recorder descriptor set!");
+		}
+		m_descriptorSet = descriptorSets.value[0];
+
+		const vk::DescriptorImageInfo imageInfo(nullptr, m_registry.get(m_colorView)->view, vk::ImageLayout::eGeneral);
+		const vk::DescriptorBufferInfo bufferInfo(m_registry.get(m_readbackBuffer)->buffer, 0, VK_WHOLE_SIZE);
+		const std::array<vk::WriteDescriptorSet, 2> writes = {
+			vk::WriteDescriptorSet(m_descriptorSet, 0, 0, vk::DescriptorType::eStorageImage, imageInfo),
+			vk::WriteDescriptorSet(m_descriptorSet, 1, 0, vk::DescriptorType::eStorageBuffer, nullptr, bufferInfo),
+		};
+		device->updateDescriptorSets(writes, nullptr);
+	}
+
+	void FrameRecorder::openEncoder()
+	{
+		const std::string& path = m_settings.path;
+		const char* container = m_settings.container.empty() ? nullptr : m_settings.container.c_str();
+		if (container == nullptr && path.starts_with("rtmp")) container = "flv";
+		else if (container == nullptr && (path.starts_with("srt://") || path.starts_with("udp://"))) container = "mpegts";
+
+		int error = avformat_alloc_output_context2(&m_formatContext, nullptr, container, path.c_str());
+		const AVCodec* codec = avcodec_find_encoder_by_name(m_settings.codec.c_str());
+		if (codec == nullptr) codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+		if (error < 0 || codec == nullptr) {
+			spdlog::error("Failed to set up encoding to {}, {}!", path, codec == nullptr ? "no H.264 encoder" : getErrorString(error));
+			closeEncoder();
+			throw std::runtime_error("Failed to set up encoding!");
+		}
+
+		m_codecContext = avcodec_alloc_context3(codec);
+		m_codecContext->width = static_cast<int>(m_settings.width);
+		m_codecContext->height = static_cast<int>(m_settings.height);
+		m_codecContext->time_base = AVRational{ 1, static_cast<int>(m_settings.frameRate) };
+		m_codecContext->framerate = AVRational{ static_cast<int>(m_settings.frameRate), 1 };
+		m_codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+		m_codecContext->bit_rate = m_settings.bitRate;
+		m_codecContext->gop_size = static_cast<int>(m_settings.frameRate) * 2;
+		// no reordering delay, streams stay low latency
+		m_codecContext->max_b_frames = 0;
+		m_codecContext->color_primaries = AVCOL_PRI_BT709;
+		m_codecContext->color_trc = AVCOL_TRC_BT709;
+		m_codecContext->colorspace = AVCOL_SPC_BT709;
+		m_codecContext->color_range = AVCOL_RANGE_MPEG;
+		if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) m_codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+		av_opt_set(m_codecContext->priv_data, "preset", "veryfast", 0);
+
+		error = avcodec_open2(m_codecContext, codec, nullptr);
+		if (error >= 0) {
+			m_stream = avformat_new_stream(m_formatContext, nullptr);
+			m_stream->time_base = m_codecContext->time_base;
+			error = avcodec_parameters_from_context(m_stream->codecpar, m_codecContext);
+		}
+		if (error >= 0 && !(m_formatContext->oformat->flags & AVFMT_NOFILE)) error = avio_open(&m_formatContext->pb, path.c_str(), AVIO_FLAG_WRITE);
+		if (error >= 0) error = avformat_write_header(m_formatContext, nullptr);
+		if (error < 0) {
+			spdlog::error("Failed to open {} encoding to {}! Error: {}", codec->name, path, getErrorString(error));
+			closeEncoder();
+			throw std::runtime_error("Failed to open encoder!");
+		}
+
+		m_frame = av_frame_alloc();
+		m_frame->format = AV_PIX_FMT_YUV420P;
+		m_frame->width = m_codecContext->width;
+		m_frame->height = m_codecContext->height;
+		m_packet = av_packet_alloc();
+		spdlog::debug("Encoding with {} into {}", codec->name, m_formatContext->oformat->name);
+	}
+
+	void FrameRecorder::closeEncoder()
+	{
+		if (m_codecContext != nullptr && m_frame != nullptr && !m_isEncoderFailed) {
+			// drains the frames the encoder still holds
+			if (avcodec_send_frame(m_codecContext, nullptr) >= 0) writePackets();
+			av_write_trailer(m_formatContext);
+		}
+		if (m_formatContext != nullptr && !(m_formatContext->oformat->flags & AVFMT_NOFILE)) avio_closep(&m_formatContext->pb);
+
+		av_packet_free(&m_packet);
+		av_frame_free(&m_frame);
+		avcodec_free_context(&m_codecContext);
+		avformat_free_context(m_formatContext);
+		m_formatContext = nullptr;
+	}
+
+	void FrameRecorder::encoderLoop()
+	{
+		std::unique_lock lock(m_mutex);
+		for (;;) {
+			m_condition.wait(lock, [this] { return m_stop || m_encodeCount != 0; });
+			if (m_encodeCount == 0) break;
+
+			const uint32_t slot = m_encodeQueue[m_encodeHead];
+			m_encodeHead = (m_encodeHead + 1) % RING_SIZE;
+			--m_encodeCount;
+
+			lock.unlock();
+			encodeSlot(slot);
+			lock.lock();
+			m_slots[slot].state = SlotState::Free;
+		}
+	}
+
+	void FrameRecorder::encodeSlot(uint32_t slot)
+	{
+		if (m_isEncoderFailed) return;
+
+		// the planes are handed to avcodec in place, it copies what it keeps
+		vmaInvalidateAllocation(m_context.getVmaAllocator(), m_readbackAllocation, m_slotSize * slot, m_slotSize);
+		uint8_t* planes = m_readbackMapped + m_slotSize * slot;
+		const size_t lumaSize = size_t(m_settings.width) * m_settings.height;
+		m_frame->data[0] = planes;
+		m_frame->data[1] = planes + lumaSize;
+		m_frame->data[2] = planes + lumaSize + lumaSize / 4;
+		m_frame->linesize[0] = static_cast<int>(m_settings.width);
+		m_frame->linesize[1] = static_cast<int>(m_settings.width / 2);
+		m_frame->linesize[2] = static_cast<int>(m_settings.width / 2);
+		m_frame->pts = m_slots[slot].pts;
+
+		const int error = avcodec_send_frame(m_codecContext, m_frame);
+		if (error < 0 || !writePackets()) {
+			spdlog::error("Failed to encode frame to {}! Error: {}", m_settings.path, getErrorString(error));
+			m_isEncoderFailed = true;
+			return;
+		}
+		m_encodedFrames.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool FrameRecorder::writePackets()
+	{
+		for (;;) {
+			int error = avcodec_receive_packet(m_codecContext, m_packet);
+			if (error == AVERROR(EAGAIN) || error == AVERROR_EOF) return true;
+			if (error < 0) return false;
+
+			av_packet_rescale_ts(m_packet, m_codecContext->time_base, m_stream->time_base);
+			m_packet->stream_index = m_stream->index;
+			error = av_interleaved_write_frame(m_formatContext, m_packet);
+			if (error < 0) {
+				spdlog::error("Failed to write packet to {}! Error: {}", m_settings.path, getErrorString(error));
+				return false;
+			}
+		}
+	}
+}
@@ -0,0 +1,134 @@
+#include "GpuLinearAllocator.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		// upper bound of every offset alignment limit, keeps all frame regions aligned
+		constexpr vk::DeviceSize REGION_ALIGNMENT = 256;
+
+		inline vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) noexcept
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	GpuLinearAllocator::GpuLinearAllocator(VKContext& context, ResourceRegistry& registry, vk::DeviceSize frameSize)
+		: m_context(context), m_registry(registry), m_frameSize(alignUp(frameSize, REGION_ALIGNMENT))
+	{
+		const vk::PhysicalDeviceLimits limits = m_context.getPhysicalDevice().getProperties().limits;
+		m_uniformAlignment = std::max<vk::DeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+		m_storageAlignment = std::max<vk::DeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
+
+		m_block = createBlock(m_frameSize * MAX_FRAMES_IN_FLIGHT);
+		spdlog::info("Frame linear buffer initialized, {} KiB per frame, uniform alignment {}",
+			m_frameSize >> 10, m_uniformAlignment);
+	}
+
+	GpuLinearAllocator::~GpuLinearAllocator()
+	{
+		m_registry.destroy(m_block.handle);
+		for (const auto& overflowBlocks : m_overflowBlocks) {
+			for (const Block& block : overflowBlocks) m_registry.destroy(block.handle);
+		}
+	}
+
+	GpuLinearAllocator::Block GpuLinearAllocator::createBlock(vk::DeviceSize size)
+	{
+		vk::BufferCreateInfo bufferCreateInfo{};
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+			vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+		bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		// prefers device local host visible memory (resizable BAR) when there is some
+		VmaAllocationCreateInfo allocationCreateInfo{};
+		allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+		allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+		Block block;
+		block.handle = m_registry.createBuffer(bufferCreateInfo, allocationCreateInfo);
+		const BufferResource& buffer = *m_registry.get(block.handle);
+		block.buffer = buffer.buffer;
+		block.allocation = buffer.allocation;
+		block.mapped = static_cast<uint8_t*>(buffer.mapped);
+		block.size = size;
+
+		VkMemoryPropertyFlags memoryProperties = 0;
+		vmaGetAllocationMemoryProperties(m_context.getVmaAllocator(), block.allocation, &memoryProperties);
+		block.isCoherent = (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		return block;
+	}
+
+	void GpuLinearAllocator::beginFrame(uint32_t frameSlot)
+	{
+		// the frame that used the slot's overflow blocks completed, the registry destroys them after the frame in flight
+		auto& overflowBlocks = m_overflowBlocks[frameSlot];
+		for (const Block& block : overflowBlocks) m_registry.destroy(block.handle);
+		overflowBlocks.clear();
+
+		if (m_peak > m_frameSize) {
+			// the other slots' frames may still read the old regions, the registry keeps them alive until then
+			const vk::DeviceSize frameSize = alignUp(std::bit_ceil(m_peak), REGION_ALIGNMENT);
+			spdlog::debug("Frame linear buffer grows from {} to {} KiB per frame", m_frameSize >> 10, frameSize >> 10);
+			m_registry.destroy(m_block.handle);
+			m_block = createBlock(frameSize * MAX_FRAMES_IN_FLIGHT);
+			m_frameSize = frameSize;
+		}
+
+		m_frameSlot = frameSlot;
+		m_frameBegin = m_frameSize * frameSlot;
+		m_offset = m_frameBegin;
+		m_overflowUsed = 0;
+	}
+
+	void GpuLinearAllocator::flush()
+	{
+		flushBlock(m_block, m_frameBegin, m_offset - m_frameBegin);
+		for (const Block& block : m_overflowBlocks[m_frameSlot]) flushBlock(block, 0, block.used);
+	}
+
+	void GpuLinearAllocator::flushBlock(const Block& block, vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		if (block.isCoherent || size == 0) return;
+
+		VkResult result = vmaFlushAllocation(m_context.getVmaAllocator(), block.allocation, offset, size);
+		if (result != VK_SUCCESS) {
+			spdlog::error("Failed to flush frame linear buffer! Error code: {}", vk::to_string(vk::Result(result)));
+			throw std::runtime_error("Failed to flush frame linear buffer!");
+		}
+	}
+
+	GpuAllocation GpuLinearAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+	{
+		auto& overflowBlocks = m_overflowBlocks[m_frameSlot];
+		if (overflowBlocks.empty()) {
+			// regions start at a multiple of REGION_ALIGNMENT, aligning the absolute offset is enough
+			const vk::DeviceSize offset = alignUp(m_offset, alignment);
+			if (offset + size <= m_frameBegin + m_frameSize) {
+				m_offset = offset + size;
+				m_peak = std::max(m_peak, getUsed());
+				m_registry.noteBufferWrite(m_block.handle, offset, size);
+				return GpuAllocation{ m_block.buffer, offset, size, m_block.mapped + offset };
+			}
+		}
+
+		// continue in an overflow block large enough for this request, offset 0 satisfies every alignment
+		vk::DeviceSize offset = overflowBlocks.empty() ? 0 : alignUp(overflowBlocks.back().used, alignment);
+		if (overflowBlocks.empty() || offset + size > overflowBlocks.back().size) {
+			if (overflowBlocks.empty()) spdlog::debug("Frame linear buffer overflow, {} of {} bytes used, {} requested", getUsed(), m_frameSize, size);
+			overflowBlocks.push_back(createBlock(std::max(m_frameSize, alignUp(size, REGION_ALIGNMENT))));
+			offset = 0;
+		}
+
+		Block& block = overflowBlocks.back();
+		m_overflowUsed += offset + size - block.used;
+		block.used = offset + size;
+		m_peak = std::max(m_peak, getUsed());
+		m_registry.noteBufferWrite(block.handle, offset, size);
+		return GpuAllocation{ block.buffer, offset, size, block.mapped + offset };
+	}
+}
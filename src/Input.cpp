@@ -0,0 +1,61 @@
+#include "Input.h"
+
+namespace coldwind {
+	void FrameInput::beginFrame() noexcept
+	{
+		const InputState& previous = m_states[m_current];
+		m_current ^= 1;
+		InputState& state = m_states[m_current];
+		state.keysDown = previous.keysDown;
+		state.mouseButtonsDown = previous.mouseButtonsDown;
+		state.keysPressed.reset();
+		state.mouseButtonsPressed.reset();
+		state.cursorX = previous.cursorX;
+		state.cursorY = previous.cursorY;
+		state.scrollX = 0.0;
+		state.scrollY = 0.0;
+	}
+
+	void FrameInput::onKey(int key, int action) noexcept
+	{
+		if (!isKeyValid(key)) return;
+
+		InputState& state = getWritableState();
+		// GLFW_REPEAT keeps the key down without pressing it again
+		if (action == GLFW_PRESS) {
+			state.keysDown.set(key);
+			state.keysPressed.set(key);
+		}
+		else if (action == GLFW_RELEASE) {
+			state.keysDown.reset(key);
+		}
+	}
+
+	void FrameInput::onMouseButton(int button, int action) noexcept
+	{
+		if (!isButtonValid(button)) return;
+
+		InputState& state = getWritableState();
+		if (action == GLFW_PRESS) {
+			state.mouseButtonsDown.set(button);
+			state.mouseButtonsPressed.set(button);
+		}
+		else {
+			state.mouseButtonsDown.reset(button);
+		}
+	}
+
+	void FrameInput::onCursorMoved(double x, double y) noexcept
+	{
+		InputState& state = getWritableState();
+		state.cursorX = x;
+		state.cursorY = y;
+	}
+
+	void FrameInput::onScrolled(double x, double y) noexcept
+	{
+		InputState& state = getWritableState();
+		state.scrollX += x;
+		state.scrollY += y;
+	}
+}
@@ -8,8 +8,8 @@
 
 namespace coldwind 
 {
-	Instance::Instance(const std::string& appName, uint8_t versionMajor, uint8_t versionMinor, uint8_t versionPatch)
-		: m_AppName(appName), m_AppVersion(VK_MAKE_VERSION(versionMajor, versionMinor, versionPatch))
+	Instance::Instance(const std::string& appName, InstanceMode mode, uint8_t versionMajor, uint8_t versionMinor, uint8_t versionPatch)
+		: m_AppName(appName), m_AppVersion(VK_MAKE_VERSION(versionMajor, versionMinor, versionPatch)), m_mode(mode)
 	{
 		spdlog::set_default_logger(spdlog::stdout_color_mt("console", spdlog::color_mode::automatic));
 #ifdef NDEBUG
@@ -68,11 +68,13 @@ namespace coldwind
 		}
 
 		std::map<const char*, uint8_t> requiredInstanceExtensions;
-		requiredInstanceExtensions.emplace(VK_KHR_SURFACE_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Required));
+		if (m_mode == InstanceMode::Windowed) {
+			requiredInstanceExtensions.emplace(VK_KHR_SURFACE_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Required));
 #ifdef VK_USE_PLATFORM_WIN32_KHR
-		requiredInstanceExtensions.emplace(VK_KHR_WIN32_SURFACE_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Required));
+			requiredInstanceExtensions.emplace(VK_KHR_WIN32_SURFACE_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Required));
 #else
 #endif
+		}
 		if (m_validationLayersEnabled) {
 			requiredInstanceExtensions.emplace(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Optional));
 		}
@@ -0,0 +1,135 @@
+#include "JobSystem.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace coldwind {
+	JobSystem::JobSystem(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			threadCount = std::max(1u, threadCount);
+		}
+
+		m_jobs.jobs.resize(256);
+		m_backgroundJobs.jobs.resize(64);
+		m_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			m_workers.emplace_back(&JobSystem::workerLoop, this);
+		}
+		spdlog::info("Job system started with {} worker threads", threadCount);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_all();
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	void JobSystem::execute(std::function<void()> job, JobCounter* counter)
+	{
+		enqueue(m_jobs, std::move(job), counter);
+	}
+
+	void JobSystem::executeBackground(std::function<void()> job, JobCounter* counter)
+	{
+		enqueue(m_backgroundJobs, std::move(job), counter);
+	}
+
+	void JobSystem::wait(JobCounter& counter)
+	{
+		while (counter.isBusy()) {
+			if (!runPendingJob()) std::this_thread::yield();
+		}
+	}
+
+	void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& job)
+	{
+		if (count == 0) return;
+		batchSize = std::max(1u, batchSize);
+		if (count <= batchSize) {
+			job(0, count);
+			return;
+		}
+
+		JobCounter counter;
+		// the calling thread takes the first batch itself
+		for (uint32_t begin = batchSize; begin < count; begin += batchSize) {
+			const uint32_t end = std::min(count, begin + batchSize);
+			execute([&job, begin, end]() { job(begin, end); }, &counter);
+		}
+		job(0, batchSize);
+		wait(counter);
+	}
+
+	void JobSystem::workerLoop()
+	{
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return m_stop || m_jobs.count != 0 || m_backgroundJobs.count != 0; });
+				if (m_jobs.count != 0) job = m_jobs.pop();
+				else if (m_backgroundJobs.count != 0) job = m_backgroundJobs.pop();
+				else return;
+			}
+			runJob(job);
+		}
+	}
+
+	bool JobSystem::runPendingJob()
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_jobs.count == 0) return false;
+			job = m_jobs.pop();
+		}
+		runJob(job);
+		return true;
+	}
+
+	void JobSystem::enqueue(JobQueue& queue, std::function<void()>&& job, JobCounter* counter)
+	{
+		if (counter != nullptr) counter->pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			queue.push(Job{ std::move(job), counter });
+		}
+		m_condition.notify_one();
+	}
+
+	void JobSystem::JobQueue::push(Job&& job)
+	{
+		if (count == jobs.size()) {
+			std::vector<Job> grown(jobs.size() * 2);
+			for (size_t i = 0; i < count; ++i) {
+				grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+			}
+			jobs = std::move(grown);
+			head = 0;
+		}
+		jobs[(head + count) % jobs.size()] = std::move(job);
+		++count;
+	}
+
+	JobSystem::Job JobSystem::JobQueue::pop() noexcept
+	{
+		Job job = std::move(jobs[head]);
+		head = (head + 1) % jobs.size();
+		--count;
+		return job;
+	}
+
+	void JobSystem::runJob(Job& job)
+	{
+		job.function();
+		if (job.counter != nullptr) job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
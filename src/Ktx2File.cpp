@@ -0,0 +1,244 @@
+#include "Ktx2File.h"
+#include "TextureFormat.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+namespace coldwind {
+	namespace {
+		constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		// key/value data of other tools is skipped, so it is not read beyond this size
+		constexpr uint32_t MAX_KEY_VALUE_DATA = 64 << 10;
+		constexpr char HAS_ALPHA_KEY[] = "ColdWindHasAlpha";
+
+		struct Ktx2Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be tightly packed");
+
+		// levels start at a multiple of both the texel block size and 4
+		[[nodiscard]] uint32_t getLevelAlignment(vk::Format format) noexcept
+		{
+			return std::lcm(getFormatBlockInfo(format).blockBytes, 4u);
+		}
+
+		// Khronos data format descriptor, only the models the baker emits
+		std::vector<uint32_t> buildDataFormatDescriptor(vk::Format format)
+		{
+			struct Sample {
+				uint16_t bitOffset;
+				uint8_t bitLength;
+				uint8_t channelType;
+				uint32_t upper;
+			};
+
+			const bool srgb = format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eBc1RgbaSrgbBlock ||
+				format == vk::Format::eBc3SrgbBlock;
+			const FormatBlockInfo block = getFormatBlockInfo(format);
+			// KHR_DF_SAMPLE_DATATYPE_LINEAR, alpha stays linear in sRGB formats
+			const uint8_t linearAlpha = srgb ? 0x10 : 0x00;
+
+			uint8_t colorModel = 1;
+			std::vector<Sample> samples;
+			if (format == vk::Format::eBc1RgbaUnormBlock || format == vk::Format::eBc1RgbaSrgbBlock) {
+				colorModel = 128;
+				// KHR_DF_CHANNEL_BC1A_ALPHAPRESENT
+				samples.push_back({ 0, 63, 1, UINT32_MAX });
+			}
+			else if (format == vk::Format::eBc3UnormBlock || format == vk::Format::eBc3SrgbBlock) {
+				colorModel = 130;
+				samples.push_back({ 0, 63, static_cast<uint8_t>(15 | linearAlpha), UINT32_MAX });
+				samples.push_back({ 64, 63, 0, UINT32_MAX });
+			}
+			else {
+				samples.push_back({ 0, 7, 0, 255 });
+				samples.push_back({ 8, 7, 1, 255 });
+				samples.push_back({ 16, 7, 2, 255 });
+				samples.push_back({ 24, 7, static_cast<uint8_t>(15 | linearAlpha), 255 });
+			}
+
+			const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+			std::vector<uint32_t> words;
+			words.push_back(4 + blockSize);
+			words.push_back(0);
+			words.push_back(2u | (blockSize << 16));
+			words.push_back(colorModel | (1u << 8) | ((srgb ? 2u : 1u) << 16));
+			words.push_back((block.blockWidth - 1) | ((block.blockHeight - 1) << 8));
+			words.push_back(block.blockBytes);
+			words.push_back(0);
+			for (const auto& sample : samples) {
+				words.push_back(sample.bitOffset | (static_cast<uint32_t>(sample.bitLength) << 16) |
+					(static_cast<uint32_t>(sample.channelType) << 24));
+				words.push_back(0);
+				words.push_back(0);
+				words.push_back(sample.upper);
+			}
+			return words;
+		}
+	}
+
+	Ktx2File::Ktx2File(const std::string& path)
+		: m_path(path), m_stream(path, std::ios::binary)
+	{
+		if (!m_stream) {
+			spdlog::error("Failed to open texture {}!", path);
+			throw std::runtime_error("Failed to open texture!");
+		}
+
+		Ktx2Header header{};
+		if (!m_stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			spdlog::error("Texture {} is not a KTX2 file!", path);
+			throw std::runtime_error("Texture is not a KTX2 file!");
+		}
+		if (header.supercompressionScheme != 0) {
+			spdlog::error("Texture {} uses unsupported supercompression scheme {}!", path, header.supercompressionScheme);
+			throw std::runtime_error("Unsupported KTX2 supercompression scheme!");
+		}
+		if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelHeight == 0) {
+			spdlog::error("Texture {} is not a single layer 2D texture!", path);
+			throw std::runtime_error("Unsupported KTX2 texture type!");
+		}
+
+		m_format = static_cast<vk::Format>(header.vkFormat);
+		m_width = header.pixelWidth;
+		m_height = header.pixelHeight;
+		m_levels.resize(std::max(1u, header.levelCount));
+		if (!m_stream.read(reinterpret_cast<char*>(m_levels.data()), m_levels.size() * sizeof(LevelIndex))) {
+			spdlog::error("Texture {} has a truncated level index!", path);
+			throw std::runtime_error("Truncated KTX2 level index!");
+		}
+
+		for (uint32_t mip = 0; mip < m_levels.size(); ++mip) {
+			const vk::DeviceSize expected = getMipByteSize(m_format, getMipExtent(m_width, mip), getMipExtent(m_height, mip));
+			if (m_levels[mip].byteLength != expected) {
+				spdlog::error("Texture {} mip {} has {} bytes, expected {}!", path, mip, m_levels[mip].byteLength, expected);
+				throw std::runtime_error("Invalid KTX2 level size!");
+			}
+		}
+		if (header.kvdByteLength != 0 && header.kvdByteLength <= MAX_KEY_VALUE_DATA) readKeyValueData(header.kvdByteOffset, header.kvdByteLength);
+		spdlog::debug("Opened texture {}: {}x{}, {} mips, format {}", path, m_width, m_height, m_levels.size(), vk::to_string(m_format));
+	}
+
+	void Ktx2File::readKeyValueData(uint32_t offset, uint32_t length)
+	{
+		std::vector<char> data(length);
+		m_stream.seekg(offset);
+		if (!m_stream.read(data.data(), length)) {
+			spdlog::warn("Texture {} has truncated key/value data", m_path);
+			m_stream.clear();
+			return;
+		}
+
+		// every entry is its length, a NUL terminated key and the value, padded to 4 bytes
+		uint32_t position = 0;
+		while (position + sizeof(uint32_t) <= length) {
+			uint32_t entryLength = 0;
+			std::memcpy(&entryLength, data.data() + position, sizeof(entryLength));
+			position += sizeof(uint32_t);
+			if (entryLength > length - position) break;
+
+			const std::string_view entry(data.data() + position, entryLength);
+			const size_t keyEnd = entry.find('\0');
+			if (keyEnd != std::string_view::npos && entry.substr(0, keyEnd) == HAS_ALPHA_KEY) {
+				const std::string_view value = entry.substr(keyEnd + 1);
+				m_hasAlpha = !value.empty() && value.front() == '1';
+			}
+			position += (entryLength + 3) & ~3u;
+		}
+	}
+
+	bool Ktx2File::readLevel(uint32_t mipLevel, void* dst, vk::DeviceSize size)
+	{
+		if (mipLevel >= m_levels.size() || size < m_levels[mipLevel].byteLength) return false;
+
+		m_stream.clear();
+		m_stream.seekg(static_cast<std::streamoff>(m_levels[mipLevel].byteOffset));
+		if (!m_stream.read(static_cast<char*>(dst), static_cast<std::streamsize>(m_levels[mipLevel].byteLength))) {
+			spdlog::warn("Failed to read mip {} of texture {}!", mipLevel, m_path);
+			return false;
+		}
+		return true;
+	}
+
+	void Ktx2File::write(const std::string& path, vk::Format format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels, std::optional<bool> hasAlpha)
+	{
+		const std::vector<uint32_t> dataFormatDescriptor = buildDataFormatDescriptor(format);
+
+		Ktx2Header header{};
+		std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		header.vkFormat = static_cast<uint32_t>(format);
+		header.typeSize = 1;
+		header.pixelWidth = width;
+		header.pixelHeight = height;
+		header.faceCount = 1;
+		header.levelCount = static_cast<uint32_t>(levels.size());
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(LevelIndex));
+		header.dfdByteLength = static_cast<uint32_t>(dataFormatDescriptor.size() * sizeof(uint32_t));
+
+		std::vector<char> keyValueData;
+		if (hasAlpha) {
+			const std::string entry = std::string(HAS_ALPHA_KEY) + '\0' + (*hasAlpha ? "1" : "0") + '\0';
+			const auto entryLength = static_cast<uint32_t>(entry.size());
+			keyValueData.resize(sizeof(uint32_t) + ((entryLength + 3) & ~3u));
+			std::memcpy(keyValueData.data(), &entryLength, sizeof(entryLength));
+			std::memcpy(keyValueData.data() + sizeof(uint32_t), entry.data(), entry.size());
+			header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+			header.kvdByteLength = static_cast<uint32_t>(keyValueData.size());
+		}
+
+		// level data is stored smallest mip first
+		const uint32_t alignment = getLevelAlignment(format);
+		std::vector<LevelIndex> levelIndex(levels.size());
+		uint64_t offset = header.dfdByteOffset + header.dfdByteLength + header.kvdByteLength;
+		for (size_t i = levels.size(); i-- > 0;) {
+			offset = (offset + alignment - 1) / alignment * alignment;
+			levelIndex[i].byteOffset = offset;
+			levelIndex[i].byteLength = levels[i].size();
+			levelIndex[i].uncompressedByteLength = levels[i].size();
+			offset += levels[i].size();
+		}
+
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			spdlog::error("Failed to create texture {}!", path);
+			throw std::runtime_error("Failed to create texture!");
+		}
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(LevelIndex));
+		stream.write(reinterpret_cast<const char*>(dataFormatDescriptor.data()), header.dfdByteLength);
+		stream.write(keyValueData.data(), static_cast<std::streamsize>(keyValueData.size()));
+
+		const std::vector<char> padding(alignment, 0);
+		for (size_t i = levels.size(); i-- > 0;) {
+			const auto position = static_cast<uint64_t>(stream.tellp());
+			stream.write(padding.data(), static_cast<std::streamsize>(levelIndex[i].byteOffset - position));
+			stream.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+		}
+
+		if (!stream) {
+			spdlog::error("Failed to write texture {}!", path);
+			throw std::runtime_error("Failed to write texture!");
+		}
+	}
+}
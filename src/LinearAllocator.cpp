@@ -0,0 +1,57 @@
+#include "LinearAllocator.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace coldwind {
+	namespace {
+		inline uintptr_t alignUp(uintptr_t value, size_t alignment) noexcept
+		{
+			return (value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		}
+	}
+
+	LinearAllocator::LinearAllocator(size_t capacity)
+		: m_buffer(std::make_unique<std::byte[]>(capacity)), m_capacity(capacity),
+		m_block(m_buffer.get()), m_blockSize(capacity)
+	{
+	}
+
+	void* LinearAllocator::allocate(size_t size, size_t alignment)
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(m_block);
+		uintptr_t address = alignUp(base + m_offset, alignment);
+		if (address + size > base + m_blockSize) {
+			// retire the current block and continue in one large enough for this request
+			m_overflowUsed += m_offset;
+			const size_t blockSize = std::max(m_capacity, size + alignment);
+			m_overflowBlocks.push_back(std::make_unique<std::byte[]>(blockSize));
+			m_block = m_overflowBlocks.back().get();
+			m_blockSize = blockSize;
+			m_offset = 0;
+			address = alignUp(reinterpret_cast<uintptr_t>(m_block), alignment);
+		}
+
+		m_offset = address + size - reinterpret_cast<uintptr_t>(m_block);
+		m_peak = std::max(m_peak, getUsed());
+		return reinterpret_cast<void*>(address);
+	}
+
+	void LinearAllocator::reset()
+	{
+		if (!m_overflowBlocks.empty()) {
+			// alignment padding is counted in the peak, a block of that size fits the same frame again
+			const size_t capacity = std::bit_ceil(m_peak);
+			spdlog::debug("Linear allocator grows from {} to {} bytes", m_capacity, capacity);
+			m_overflowBlocks.clear();
+			m_buffer = std::make_unique<std::byte[]>(capacity);
+			m_capacity = capacity;
+		}
+
+		m_block = m_buffer.get();
+		m_blockSize = m_capacity;
+		m_offset = 0;
+		m_overflowUsed = 0;
+	}
+}
@@ -0,0 +1,671 @@
+#include "PipelineCache.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace coldwind {
+	namespace {
+		enum class EntryStatus : uint8_t {
+			Pending,
+			Ready,
+			Failed
+		};
+
+		// keys are built in a buffer per thread, lookups of existing objects do not allocate
+		class KeyWriter {
+		public:
+			explicit KeyWriter(uint32_t kind) : m_bytes(getBuffer())
+			{
+				m_bytes.clear();
+				add(kind);
+			}
+
+			template<typename T>
+			void add(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				addBytes(&value, sizeof(T));
+			}
+			// only for element types without padding, the bytes are compared
+			template<typename T>
+			void addArray(const T* values, uint32_t count)
+			{
+				add(count);
+				add(values != nullptr);
+				if (values != nullptr) addBytes(values, sizeof(T) * count);
+			}
+			void addString(const char* string)
+			{
+				const size_t length = string != nullptr ? std::strlen(string) : 0;
+				add(length);
+				addBytes(string, length);
+			}
+			void addBytes(const void* data, size_t size)
+			{
+				const auto* bytes = static_cast<const std::byte*>(data);
+				m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+			}
+
+			[[nodiscard]] std::span<const std::byte> getBytes() const noexcept { return m_bytes; }
+
+		private:
+			std::vector<std::byte>& m_bytes;
+
+			static std::vector<std::byte>& getBuffer()
+			{
+				thread_local std::vector<std::byte> buffer;
+				return buffer;
+			}
+		};
+
+		// word at a time mixing with a splitmix64 finalizer, keys are short and compared in full on a hit
+		uint64_t hashKey(std::span<const std::byte> key) noexcept
+		{
+			constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+			uint64_t hash = key.size() * MULTIPLIER;
+			size_t offset = 0;
+			for (; offset + sizeof(uint64_t) <= key.size(); offset += sizeof(uint64_t)) {
+				uint64_t word;
+				std::memcpy(&word, key.data() + offset, sizeof(word));
+				hash = std::rotl(hash ^ word, 27) * MULTIPLIER;
+			}
+			if (offset < key.size()) {
+				uint64_t word = 0;
+				std::memcpy(&word, key.data() + offset, key.size() - offset);
+				hash = std::rotl(hash ^ word, 27) * MULTIPLIER;
+			}
+			hash ^= hash >> 30;
+			hash *= 0xBF58476D1CE4E5B9ull;
+			hash ^= hash >> 27;
+			hash *= 0x94D049BB133111EBull;
+			return hash ^ (hash >> 31);
+		}
+
+		[[noreturn]] void throwUnsupportedChain(const void* next, const char* what)
+		{
+			const auto type = static_cast<const vk::BaseInStructure*>(next)->sType;
+			spdlog::error("Pipeline cache can not key a {} chained with {}!", what, vk::to_string(type));
+			throw std::runtime_error("Unsupported create info chain!");
+		}
+
+		void checkNoChain(const void* next, const char* what)
+		{
+			if (next != nullptr) throwUnsupportedChain(next, what);
+		}
+
+		const vk::PipelineRenderingCreateInfo* findRenderingInfo(const vk::GraphicsPipelineCreateInfo& createInfo)
+		{
+			const vk::PipelineRenderingCreateInfo* rendering = nullptr;
+			for (auto* next = static_cast<const vk::BaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+				if (next->sType != vk::StructureType::ePipelineRenderingCreateInfo) throwUnsupportedChain(next, "graphics pipeline");
+				rendering = reinterpret_cast<const vk::PipelineRenderingCreateInfo*>(next);
+			}
+			return rendering;
+		}
+
+		void writeStage(KeyWriter& key, const vk::PipelineShaderStageCreateInfo& stage)
+		{
+			checkNoChain(stage.pNext, "shader stage");
+			key.add(stage.flags);
+			key.add(stage.stage);
+			key.add(stage.module);
+			key.addString(stage.pName);
+			const vk::SpecializationInfo* specialization = stage.pSpecializationInfo;
+			key.add(specialization != nullptr);
+			if (specialization != nullptr) {
+				key.addArray(specialization->pMapEntries, specialization->mapEntryCount);
+				key.add(specialization->dataSize);
+				key.addBytes(specialization->pData, specialization->dataSize);
+			}
+		}
+
+		// optional sub states are keyed with a presence flag, their own chains are not supported
+		template<typename T, typename Write>
+		void writeState(KeyWriter& key, const T* state, const char* what, Write&& write)
+		{
+			key.add(state != nullptr);
+			if (state == nullptr) return;
+			checkNoChain(state->pNext, what);
+			key.add(state->flags);
+			write(*state);
+		}
+
+		void writeGraphicsKey(KeyWriter& key, const vk::GraphicsPipelineCreateInfo& createInfo)
+		{
+			key.add(createInfo.flags);
+			key.add(createInfo.stageCount);
+			for (uint32_t i = 0; i < createInfo.stageCount; ++i) {
+				writeStage(key, createInfo.pStages[i]);
+			}
+
+			writeState(key, createInfo.pVertexInputState, "vertex input state", [&](const vk::PipelineVertexInputStateCreateInfo& state) {
+				key.addArray(state.pVertexBindingDescriptions, state.vertexBindingDescriptionCount);
+				key.addArray(state.pVertexAttributeDescriptions, state.vertexAttributeDescriptionCount);
+			});
+			writeState(key, createInfo.pInputAssemblyState, "input assembly state", [&](const vk::PipelineInputAssemblyStateCreateInfo& state) {
+				key.add(state.topology);
+				key.add(state.primitiveRestartEnable);
+			});
+			writeState(key, createInfo.pTessellationState, "tessellation state", [&](const vk::PipelineTessellationStateCreateInfo& state) {
+				key.add(state.patchControlPoints);
+			});
+			writeState(key, createInfo.pViewportState, "viewport state", [&](const vk::PipelineViewportStateCreateInfo& state) {
+				key.addArray(state.pViewports, state.viewportCount);
+				key.addArray(state.pScissors, state.scissorCount);
+			});
+			writeState(key, createInfo.pRasterizationState, "rasterization state", [&](const vk::PipelineRasterizationStateCreateInfo& state) {
+				key.add(state.depthClampEnable);
+				key.add(state.rasterizerDiscardEnable);
+				key.add(state.polygonMode);
+				key.add(state.cullMode);
+				key.add(state.frontFace);
+				key.add(state.depthBiasEnable);
+				key.add(state.depthBiasConstantFactor);
+				key.add(state.depthBiasClamp);
+				key.add(state.depthBiasSlopeFactor);
+				key.add(state.lineWidth);
+			});
+			writeState(key, createInfo.pMultisampleState, "multisample state", [&](const vk::PipelineMultisampleStateCreateInfo& state) {
+				key.add(state.rasterizationSamples);
+				key.add(state.sampleShadingEnable);
+				key.add(state.minSampleShading);
+				key.addArray(state.pSampleMask, (static_cast<uint32_t>(state.rasterizationSamples) + 31) / 32);
+				key.add(state.alphaToCoverageEnable);
+				key.add(state.alphaToOneEnable);
+			});
+			writeState(key, createInfo.pDepthStencilState, "depth stencil state", [&](const vk::PipelineDepthStencilStateCreateInfo& state) {
+				key.add(state.depthTestEnable);
+				key.add(state.depthWriteEnable);
+				key.add(state.depthCompareOp);
+				key.add(state.depthBoundsTestEnable);
+				key.add(state.stencilTestEnable);
+				key.add(state.front);
+				key.add(state.back);
+				key.add(state.minDepthBounds);
+				key.add(state.maxDepthBounds);
+			});
+			writeState(key, createInfo.pColorBlendState, "color blend state", [&](const vk::PipelineColorBlendStateCreateInfo& state) {
+				key.add(state.logicOpEnable);
+				key.add(state.logicOp);
+				key.addArray(state.pAttachments, state.attachmentCount);
+				key.add(state.blendConstants);
+			});
+			writeState(key, createInfo.pDynamicState, "dynamic state", [&](const vk::PipelineDynamicStateCreateInfo& state) {
+				key.addArray(state.pDynamicStates, state.dynamicStateCount);
+			});
+
+			key.add(createInfo.layout);
+			key.add(createInfo.renderPass);
+			key.add(createInfo.subpass);
+			const vk::PipelineRenderingCreateInfo* rendering = findRenderingInfo(createInfo);
+			key.add(rendering != nullptr);
+			if (rendering != nullptr) {
+				key.add(rendering->viewMask);
+				key.addArray(rendering->pColorAttachmentFormats, rendering->colorAttachmentCount);
+				key.add(rendering->depthAttachmentFormat);
+				key.add(rendering->stencilAttachmentFormat);
+			}
+		}
+
+		template<typename T>
+		[[nodiscard]] uint64_t toRaw(T object) noexcept
+		{
+			return reinterpret_cast<uint64_t>(static_cast<typename T::CType>(object));
+		}
+
+		template<typename T>
+		[[nodiscard]] T fromRaw(uint64_t raw) noexcept
+		{
+			return T(reinterpret_cast<typename T::CType>(raw));
+		}
+
+		template<typename T>
+		[[nodiscard]] std::vector<T> copyArray(const T* values, uint32_t count)
+		{
+			return values != nullptr ? std::vector<T>(values, values + count) : std::vector<T>();
+		}
+
+		template<typename T>
+		[[nodiscard]] const T* getData(const std::vector<T>& values, const T* source) noexcept
+		{
+			return source != nullptr ? values.data() : nullptr;
+		}
+	}
+
+	struct PipelineCache::Entry {
+		uint64_t hash = 0;
+		std::vector<std::byte> key;
+		ObjectKind kind = ObjectKind::Pipeline;
+		// object is written before the status is released, readers acquire the status first
+		std::atomic<EntryStatus> status{ EntryStatus::Pending };
+		uint64_t object = 0;
+		// deep copy of the create info, only the compile job touches it
+		std::unique_ptr<PipelineState> state;
+	};
+
+	struct PipelineCache::Table {
+		explicit Table(uint32_t capacity) : mask(capacity - 1), slots(std::make_unique<std::atomic<const Entry*>[]>(capacity)) {}
+
+		uint32_t mask;
+		uint32_t count = 0;
+		std::unique_ptr<std::atomic<const Entry*>[]> slots;
+	};
+
+	// owns everything a create info points to, the caller's arrays are gone once the compile runs
+	struct PipelineCache::PipelineState {
+		bool isCompute = false;
+		vk::ComputePipelineCreateInfo compute;
+		vk::GraphicsPipelineCreateInfo graphics;
+
+		// reserved up front, the create infos point into them
+		std::vector<vk::PipelineShaderStageCreateInfo> stages;
+		std::vector<std::string> entryPoints;
+		std::vector<vk::SpecializationInfo> specializations;
+		std::vector<std::vector<vk::SpecializationMapEntry>> mapEntries;
+		std::vector<std::vector<std::byte>> specializationData;
+
+		vk::PipelineVertexInputStateCreateInfo vertexInput;
+		std::vector<vk::VertexInputBindingDescription> vertexBindings;
+		std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+		vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+		vk::PipelineTessellationStateCreateInfo tessellation;
+		vk::PipelineViewportStateCreateInfo viewport;
+		std::vector<vk::Viewport> viewports;
+		std::vector<vk::Rect2D> scissors;
+		vk::PipelineRasterizationStateCreateInfo rasterization;
+		vk::PipelineMultisampleStateCreateInfo multisample;
+		std::vector<vk::SampleMask> sampleMask;
+		vk::PipelineDepthStencilStateCreateInfo depthStencil;
+		vk::PipelineColorBlendStateCreateInfo colorBlend;
+		std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments;
+		vk::PipelineDynamicStateCreateInfo dynamicState;
+		std::vector<vk::DynamicState> dynamicStates;
+		vk::PipelineRenderingCreateInfo rendering;
+		std::vector<vk::Format> colorFormats;
+
+		void copyStages(const vk::PipelineShaderStageCreateInfo* sourceStages, uint32_t count)
+		{
+			stages.reserve(count);
+			entryPoints.reserve(count);
+			specializations.reserve(count);
+			mapEntries.reserve(count);
+			specializationData.reserve(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				vk::PipelineShaderStageCreateInfo& stage = stages.emplace_back(sourceStages[i]);
+				stage.pName = entryPoints.emplace_back(sourceStages[i].pName).c_str();
+
+				const vk::SpecializationInfo* source = sourceStages[i].pSpecializationInfo;
+				if (source == nullptr) continue;
+				const auto& entries = mapEntries.emplace_back(copyArray(source->pMapEntries, source->mapEntryCount));
+				const auto* data = static_cast<const std::byte*>(source->pData);
+				const auto& bytes = specializationData.emplace_back(data, data + source->dataSize);
+				stage.pSpecializationInfo = &specializations.emplace_back(
+					static_cast<uint32_t>(entries.size()), entries.data(), bytes.size(), bytes.data());
+			}
+		}
+
+		void copy(const vk::ComputePipelineCreateInfo& createInfo)
+		{
+			isCompute = true;
+			copyStages(&createInfo.stage, 1);
+			compute = createInfo;
+			compute.stage = stages.front();
+			compute.basePipelineHandle = nullptr;
+			compute.basePipelineIndex = -1;
+		}
+
+		void copy(const vk::GraphicsPipelineCreateInfo& createInfo)
+		{
+			copyStages(createInfo.pStages, createInfo.stageCount);
+			graphics = createInfo;
+			graphics.pNext = nullptr;
+			graphics.pStages = stages.data();
+			graphics.basePipelineHandle = nullptr;
+			graphics.basePipelineIndex = -1;
+
+			if (const auto* source = createInfo.pVertexInputState) {
+				vertexInput = *source;
+				vertexBindings = copyArray(source->pVertexBindingDescriptions, source->vertexBindingDescriptionCount);
+				vertexAttributes = copyArray(source->pVertexAttributeDescriptions, source->vertexAttributeDescriptionCount);
+				vertexInput.pVertexBindingDescriptions = getData(vertexBindings, source->pVertexBindingDescriptions);
+				vertexInput.pVertexAttributeDescriptions = getData(vertexAttributes, source->pVertexAttributeDescriptions);
+				graphics.pVertexInputState = &vertexInput;
+			}
+			if (const auto* source = createInfo.pInputAssemblyState) {
+				inputAssembly = *source;
+				graphics.pInputAssemblyState = &inputAssembly;
+			}
+			if (const auto* source = createInfo.pTessellationState) {
+				tessellation = *source;
+				graphics.pTessellationState = &tessellation;
+			}
+			if (const auto* source = createInfo.pViewportState) {
+				viewport = *source;
+				viewports = copyArray(source->pViewports, source->viewportCount);
+				scissors = copyArray(source->pScissors, source->scissorCount);
+				viewport.pViewports = getData(viewports, source->pViewports);
+				viewport.pScissors = getData(scissors, source->pScissors);
+				graphics.pViewportState = &viewport;
+			}
+			if (const auto* source = createInfo.pRasterizationState) {
+				rasterization = *source;
+				graphics.pRasterizationState = &rasterization;
+			}
+			if (const auto* source = createInfo.pMultisampleState) {
+				multisample = *source;
+				sampleMask = copyArray(source->pSampleMask, (static_cast<uint32_t>(source->rasterizationSamples) + 31) / 32);
+				multisample.pSampleMask = getData(sampleMask, source->pSampleMask);
+				graphics.pMultisampleState = &multisample;
+			}
+			if (const auto* source = createInfo.pDepthStencilState) {
+				depthStencil = *source;
+				graphics.pDepthStencilState = &depthStencil;
+			}
+			if (const auto* source = createInfo.pColorBlendState) {
+				colorBlend = *source;
+				blendAttachments = copyArray(source->pAttachments, source->attachmentCount);
+				colorBlend.pAttachments = getData(blendAttachments, source->pAttachments);
+				graphics.pColorBlendState = &colorBlend;
+			}
+			if (const auto* source = createInfo.pDynamicState) {
+				dynamicState = *source;
+				dynamicStates = copyArray(source->pDynamicStates, source->dynamicStateCount);
+				dynamicState.pDynamicStates = getData(dynamicStates, source->pDynamicStates);
+				graphics.pDynamicState = &dynamicState;
+			}
+			if (const auto* source = findRenderingInfo(createInfo)) {
+				rendering = *source;
+				rendering.pNext = nullptr;
+				colorFormats = copyArray(source->pColorAttachmentFormats, source->colorAttachmentCount);
+				rendering.pColorAttachmentFormats = getData(colorFormats, source->pColorAttachmentFormats);
+				graphics.pNext = &rendering;
+			}
+		}
+	};
+
+	PipelineCache::PipelineCache(VKContext& context, JobSystem& jobSystem)
+		: m_context(context), m_jobSystem(jobSystem)
+	{
+		auto driverCache = context.getDevice()->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+		if (driverCache.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create pipeline cache! Error code: {}", vk::to_string(driverCache.result));
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+		m_driverCache = std::move(driverCache.value);
+
+		m_tables.push_back(std::make_unique<Table>(256));
+		m_table.store(m_tables.back().get(), std::memory_order_release);
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		waitForCompiles();
+
+		auto& device = m_context.getDevice();
+		for (const auto& entry : m_entries) {
+			if (entry->object == 0) continue;
+			switch (entry->kind) {
+			case ObjectKind::ShaderModule: device->destroyShaderModule(fromRaw<vk::ShaderModule>(entry->object)); break;
+			case ObjectKind::Sampler: device->destroySampler(fromRaw<vk::Sampler>(entry->object)); break;
+			case ObjectKind::DescriptorSetLayout: device->destroyDescriptorSetLayout(fromRaw<vk::DescriptorSetLayout>(entry->object)); break;
+			case ObjectKind::PipelineLayout: device->destroyPipelineLayout(fromRaw<vk::PipelineLayout>(entry->object)); break;
+			case ObjectKind::Pipeline: device->destroyPipeline(fromRaw<vk::Pipeline>(entry->object)); break;
+			default: break;
+			}
+		}
+
+		const PipelineCacheStats stats = getStats();
+		spdlog::debug("Pipeline cache held {} pipelines, {:.1f}% hit rate, {} compile stalls avoided", stats.pipelines,
+			stats.getHitRate() * 100.0, stats.compileStallsAvoided);
+	}
+
+	vk::ShaderModule PipelineCache::getShaderModule(std::span<const uint32_t> spirv)
+	{
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::ShaderModule));
+		key.addBytes(spirv.data(), spirv.size_bytes());
+		return fromRaw<vk::ShaderModule>(getObject(ObjectKind::ShaderModule, key.getBytes(), [&] {
+			auto shaderModule = m_context.getDevice()->createShaderModule(vk::ShaderModuleCreateInfo({}, spirv.size_bytes(), spirv.data()));
+			if (shaderModule.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create shader module! Error code: {}", vk::to_string(shaderModule.result));
+				throw std::runtime_error("Failed to create shader module!");
+			}
+			return toRaw(shaderModule.value);
+		}));
+	}
+
+	vk::Sampler PipelineCache::getSampler(const vk::SamplerCreateInfo& createInfo)
+	{
+		checkNoChain(createInfo.pNext, "sampler");
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::Sampler));
+		key.add(createInfo.flags);
+		key.add(createInfo.magFilter);
+		key.add(createInfo.minFilter);
+		key.add(createInfo.mipmapMode);
+		key.add(createInfo.addressModeU);
+		key.add(createInfo.addressModeV);
+		key.add(createInfo.addressModeW);
+		key.add(createInfo.mipLodBias);
+		key.add(createInfo.anisotropyEnable);
+		key.add(createInfo.maxAnisotropy);
+		key.add(createInfo.compareEnable);
+		key.add(createInfo.compareOp);
+		key.add(createInfo.minLod);
+		key.add(createInfo.maxLod);
+		key.add(createInfo.borderColor);
+		key.add(createInfo.unnormalizedCoordinates);
+		return fromRaw<vk::Sampler>(getObject(ObjectKind::Sampler, key.getBytes(), [&] {
+			auto sampler = m_context.getDevice()->createSampler(createInfo);
+			if (sampler.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create sampler! Error code: {}", vk::to_string(sampler.result));
+				throw std::runtime_error("Failed to create sampler!");
+			}
+			return toRaw(sampler.value);
+		}));
+	}
+
+	vk::DescriptorSetLayout PipelineCache::getDescriptorSetLayout(const vk::DescriptorSetLayoutCreateInfo& createInfo)
+	{
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::DescriptorSetLayout));
+		key.add(createInfo.flags);
+		key.add(createInfo.bindingCount);
+		for (uint32_t i = 0; i < createInfo.bindingCount; ++i) {
+			const vk::DescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+			key.add(binding.binding);
+			key.add(binding.descriptorType);
+			key.add(binding.descriptorCount);
+			key.add(binding.stageFlags);
+			const bool hasImmutableSamplers = binding.pImmutableSamplers != nullptr &&
+				(binding.descriptorType == vk::DescriptorType::eSampler || binding.descriptorType == vk::DescriptorType::eCombinedImageSampler);
+			key.add(hasImmutableSamplers);
+			if (hasImmutableSamplers) key.addBytes(binding.pImmutableSamplers, sizeof(vk::Sampler) * binding.descriptorCount);
+		}
+		for (auto* next = static_cast<const vk::BaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+			if (next->sType != vk::StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo) throwUnsupportedChain(next, "descriptor set layout");
+			const auto& bindingFlags = *reinterpret_cast<const vk::DescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+			key.addArray(bindingFlags.pBindingFlags, bindingFlags.bindingCount);
+		}
+		return fromRaw<vk::DescriptorSetLayout>(getObject(ObjectKind::DescriptorSetLayout, key.getBytes(), [&] {
+			auto layout = m_context.getDevice()->createDescriptorSetLayout(createInfo);
+			if (layout.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create descriptor set layout! Error code: {}", vk::to_string(layout.result));
+				throw std::runtime_error("Failed to create descriptor set layout!");
+			}
+			return toRaw(layout.value);
+		}));
+	}
+
+	vk::PipelineLayout PipelineCache::getPipelineLayout(const vk::PipelineLayoutCreateInfo& createInfo)
+	{
+		checkNoChain(createInfo.pNext, "pipeline layout");
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::PipelineLayout));
+		key.add(createInfo.flags);
+		key.addArray(createInfo.pSetLayouts, createInfo.setLayoutCount);
+		key.addArray(createInfo.pPushConstantRanges, createInfo.pushConstantRangeCount);
+		return fromRaw<vk::PipelineLayout>(getObject(ObjectKind::PipelineLayout, key.getBytes(), [&] {
+			auto layout = m_context.getDevice()->createPipelineLayout(createInfo);
+			if (layout.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create pipeline layout! Error code: {}", vk::to_string(layout.result));
+				throw std::runtime_error("Failed to create pipeline layout!");
+			}
+			return toRaw(layout.value);
+		}));
+	}
+
+	vk::Pipeline PipelineCache::getPipeline(const vk::GraphicsPipelineCreateInfo& createInfo, vk::Pipeline fallback)
+	{
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::Pipeline));
+		key.add(vk::PipelineBindPoint::eGraphics);
+		writeGraphicsKey(key, createInfo);
+		return requestPipeline(key.getBytes(), &createInfo, nullptr, fallback);
+	}
+
+	vk::Pipeline PipelineCache::getPipeline(const vk::ComputePipelineCreateInfo& createInfo, vk::Pipeline fallback)
+	{
+		checkNoChain(createInfo.pNext, "compute pipeline");
+		KeyWriter key(static_cast<uint32_t>(ObjectKind::Pipeline));
+		key.add(vk::PipelineBindPoint::eCompute);
+		key.add(createInfo.flags);
+		writeStage(key, createInfo.stage);
+		key.add(createInfo.layout);
+		return requestPipeline(key.getBytes(), nullptr, &createInfo, fallback);
+	}
+
+	void PipelineCache::waitForCompiles()
+	{
+		m_jobSystem.wait(m_compiles);
+	}
+
+	PipelineCacheStats PipelineCache::getStats() const noexcept
+	{
+		PipelineCacheStats stats;
+		stats.shaderModules = m_objectCounts[static_cast<size_t>(ObjectKind::ShaderModule)].load(std::memory_order_relaxed);
+		stats.samplers = m_objectCounts[static_cast<size_t>(ObjectKind::Sampler)].load(std::memory_order_relaxed);
+		stats.descriptorSetLayouts = m_objectCounts[static_cast<size_t>(ObjectKind::DescriptorSetLayout)].load(std::memory_order_relaxed);
+		stats.pipelineLayouts = m_objectCounts[static_cast<size_t>(ObjectKind::PipelineLayout)].load(std::memory_order_relaxed);
+		stats.pipelines = m_objectCounts[static_cast<size_t>(ObjectKind::Pipeline)].load(std::memory_order_relaxed);
+		stats.pendingCompiles = m_compiles.pending.load(std::memory_order_relaxed);
+		stats.failedCompiles = m_failedCompiles.load(std::memory_order_relaxed);
+		stats.lookups = m_lookups.load(std::memory_order_relaxed);
+		stats.hits = m_hits.load(std::memory_order_relaxed);
+		stats.compileStallsAvoided = m_compileStallsAvoided.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	const PipelineCache::Entry* PipelineCache::find(std::span<const std::byte> key, uint64_t hash) const noexcept
+	{
+		// linear probing, tables are at most half full so an empty slot ends every probe
+		const Table* table = m_table.load(std::memory_order_acquire);
+		for (uint32_t slot = static_cast<uint32_t>(hash) & table->mask;; slot = (slot + 1) & table->mask) {
+			const Entry* entry = table->slots[slot].load(std::memory_order_acquire);
+			if (entry == nullptr) return nullptr;
+			if (entry->hash == hash && std::ranges::equal(entry->key, key)) return entry;
+		}
+	}
+
+	PipelineCache::Entry& PipelineCache::insert(ObjectKind kind, std::span<const std::byte> key, uint64_t hash, uint64_t object,
+		std::unique_ptr<PipelineState> state)
+	{
+		const auto place = [](Table& table, const Entry& entry) {
+			uint32_t slot = static_cast<uint32_t>(entry.hash) & table.mask;
+			while (table.slots[slot].load(std::memory_order_relaxed) != nullptr) slot = (slot + 1) & table.mask;
+			table.slots[slot].store(&entry, std::memory_order_release);
+			++table.count;
+		};
+
+		Table* table = m_table.load(std::memory_order_relaxed);
+		if ((table->count + 1) * 2 > table->mask + 1) {
+			// readers of the old table miss the entries added from now on and retry under the lock
+			auto grown = std::make_unique<Table>((table->mask + 1) * 2);
+			for (const auto& existing : m_entries) place(*grown, *existing);
+			table = grown.get();
+			m_tables.push_back(std::move(grown));
+			m_table.store(table, std::memory_order_release);
+		}
+
+		auto entry = std::make_unique<Entry>();
+		entry->hash = hash;
+		entry->key.assign(key.begin(), key.end());
+		entry->kind = kind;
+		entry->object = object;
+		entry->state = std::move(state);
+		entry->status.store(entry->state != nullptr ? EntryStatus::Pending : EntryStatus::Ready, std::memory_order_relaxed);
+		m_entries.push_back(std::move(entry));
+		place(*table, *m_entries.back());
+		m_objectCounts[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+		return *m_entries.back();
+	}
+
+	template<typename Create>
+	uint64_t PipelineCache::getObject(ObjectKind kind, std::span<const std::byte> key, Create&& create)
+	{
+		const uint64_t hash = hashKey(key);
+		m_lookups.fetch_add(1, std::memory_order_relaxed);
+		const Entry* entry = find(key, hash);
+		if (entry == nullptr) {
+			std::lock_guard lock(m_mutex);
+			entry = find(key, hash);
+			if (entry == nullptr) return insert(kind, key, hash, create()).object;
+		}
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+		return entry->object;
+	}
+
+	vk::Pipeline PipelineCache::requestPipeline(std::span<const std::byte> key, const vk::GraphicsPipelineCreateInfo* graphics,
+		const vk::ComputePipelineCreateInfo* compute, vk::Pipeline fallback)
+	{
+		const uint64_t hash = hashKey(key);
+		m_lookups.fetch_add(1, std::memory_order_relaxed);
+		const Entry* entry = find(key, hash);
+		if (entry == nullptr) {
+			std::lock_guard lock(m_mutex);
+			entry = find(key, hash);
+			if (entry == nullptr) {
+				auto state = std::make_unique<PipelineState>();
+				if (graphics != nullptr) state->copy(*graphics);
+				else state->copy(*compute);
+				Entry& inserted = insert(ObjectKind::Pipeline, key, hash, 0, std::move(state));
+				// a background job, a frame thread waiting on its own jobs never picks up a compile
+				m_jobSystem.executeBackground([this, &inserted]() { compile(inserted); }, &m_compiles);
+				m_compileStallsAvoided.fetch_add(1, std::memory_order_relaxed);
+				return fallback;
+			}
+		}
+
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+		switch (entry->status.load(std::memory_order_acquire)) {
+		case EntryStatus::Ready:
+			return fromRaw<vk::Pipeline>(entry->object);
+		case EntryStatus::Pending:
+			m_compileStallsAvoided.fetch_add(1, std::memory_order_relaxed);
+			return fallback;
+		default:
+			return fallback;
+		}
+	}
+
+	void PipelineCache::compile(Entry& entry)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		const PipelineState& state = *entry.state;
+		auto& device = m_context.getDevice();
+		const auto pipeline = state.isCompute ? device->createComputePipeline(m_driverCache.get(), state.compute)
+			: device->createGraphicsPipeline(m_driverCache.get(), state.graphics);
+		entry.state.reset();
+
+		if (pipeline.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to compile pipeline! Error code: {}", vk::to_string(pipeline.result));
+			m_failedCompiles.fetch_add(1, std::memory_order_relaxed);
+			entry.status.store(EntryStatus::Failed, std::memory_order_release);
+			return;
+		}
+		entry.object = toRaw(pipeline.value);
+		entry.status.store(EntryStatus::Ready, std::memory_order_release);
+		spdlog::debug("Compiled pipeline in {:.2f} ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+	}
+}
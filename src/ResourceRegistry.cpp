@@ -0,0 +1,219 @@
+#include "ResourceRegistry.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		// bump allocations leave at most this much alignment padding between writes, such writes are merged
+		constexpr vk::DeviceSize MERGED_WRITE_GAP = 256;
+	}
+
+	ResourceRegistry::ResourceRegistry(VKContext& context)
+		: m_context(context)
+	{
+	}
+
+	ResourceRegistry::~ResourceRegistry()
+	{
+		static_cast<void>(m_context.getDevice()->waitIdle());
+		collect(UINT64_MAX);
+
+		auto& device = m_context.getDevice();
+		for (const auto& pipeline : m_pipelines.getValues()) device->destroyPipeline(pipeline.pipeline);
+		for (const auto& sampler : m_samplers.getValues()) device->destroySampler(sampler.sampler);
+		for (const auto& view : m_imageViews.getValues()) device->destroyImageView(view.view);
+		for (const auto& image : m_images.getValues()) {
+			if (image.allocation != nullptr) vmaDestroyImage(m_context.getVmaAllocator(), image.image, image.allocation);
+		}
+		for (const auto& buffer : m_buffers.getValues()) {
+			vmaDestroyBuffer(m_context.getVmaAllocator(), buffer.buffer, buffer.allocation);
+		}
+	}
+
+	BufferHandle ResourceRegistry::createBuffer(const vk::BufferCreateInfo& createInfo, const VmaAllocationCreateInfo& allocationCreateInfo)
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VmaAllocation allocation = nullptr;
+		VmaAllocationInfo allocationInfo{};
+		VkResult result = vmaCreateBuffer(m_context.getVmaAllocator(), &static_cast<const VkBufferCreateInfo&>(createInfo),
+			&allocationCreateInfo, &buffer, &allocation, &allocationInfo);
+		if (result != VK_SUCCESS) {
+			spdlog::error("Failed to create buffer of {} bytes! Error code: {}", createInfo.size, vk::to_string(vk::Result(result)));
+			throw std::runtime_error("Failed to create buffer!");
+		}
+		return m_buffers.insert(BufferResource{ buffer, allocation, createInfo.size, createInfo.usage, allocationInfo.pMappedData });
+	}
+
+	ImageHandle ResourceRegistry::createImage(const vk::ImageCreateInfo& createInfo, const VmaAllocationCreateInfo& allocationCreateInfo)
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = nullptr;
+		VkResult result = vmaCreateImage(m_context.getVmaAllocator(), &static_cast<const VkImageCreateInfo&>(createInfo),
+			&allocationCreateInfo, &image, &allocation, nullptr);
+		if (result != VK_SUCCESS) {
+			spdlog::error("Failed to create {}x{} {} image! Error code: {}", createInfo.extent.width, createInfo.extent.height,
+				vk::to_string(createInfo.format), vk::to_string(vk::Result(result)));
+			throw std::runtime_error("Failed to create image!");
+		}
+		return m_images.insert(ImageResource{ image, allocation, createInfo.format, createInfo.extent, createInfo.mipLevels, createInfo.arrayLayers,
+			createInfo.usage, createInfo.initialLayout });
+	}
+
+	ImageViewHandle ResourceRegistry::createImageView(ImageHandle image, vk::ImageViewCreateInfo viewInfo)
+	{
+		const ImageResource* imageResource = m_images.get(image);
+		if (imageResource == nullptr) {
+			spdlog::error("Can not create a view of stale image handle {}:{}!", image.index, image.generation);
+			throw std::runtime_error("Stale image handle!");
+		}
+
+		viewInfo.image = imageResource->image;
+		auto view = m_context.getDevice()->createImageView(viewInfo);
+		if (view.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create image view! Error code: {}", vk::to_string(view.result));
+			throw std::runtime_error("Failed to create image view!");
+		}
+		return m_imageViews.insert(ImageViewResource{ view.value, image });
+	}
+
+	SamplerHandle ResourceRegistry::createSampler(const vk::SamplerCreateInfo& createInfo)
+	{
+		auto sampler = m_context.getDevice()->createSampler(createInfo);
+		if (sampler.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create sampler! Error code: {}", vk::to_string(sampler.result));
+			throw std::runtime_error("Failed to create sampler!");
+		}
+		return m_samplers.insert(SamplerResource{ sampler.value });
+	}
+
+	PipelineHandle ResourceRegistry::addPipeline(vk::Pipeline pipeline, vk::PipelineBindPoint bindPoint)
+	{
+		return m_pipelines.insert(PipelineResource{ pipeline, bindPoint });
+	}
+
+	ImageHandle ResourceRegistry::addImage(vk::Image image, VmaAllocation allocation, const vk::ImageCreateInfo& createInfo)
+	{
+		return m_images.insert(ImageResource{ image, allocation, createInfo.format, createInfo.extent, createInfo.mipLevels, createInfo.arrayLayers,
+			createInfo.usage, createInfo.initialLayout });
+	}
+
+	ImageHandle ResourceRegistry::importImage(vk::Image image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage)
+	{
+		return m_images.insert(ImageResource{ image, nullptr, format, vk::Extent3D(extent, 1), 1, 1, usage });
+	}
+
+	void ResourceRegistry::destroy(BufferHandle handle)
+	{
+		BufferResource buffer;
+		if (m_buffers.erase(handle, &buffer)) retireBuffer(buffer.buffer, buffer.allocation);
+	}
+
+	void ResourceRegistry::destroy(ImageHandle handle)
+	{
+		ImageResource image;
+		if (m_images.erase(handle, &image) && image.allocation != nullptr) retireImage(image.image, image.allocation);
+	}
+
+	void ResourceRegistry::destroy(ImageViewHandle handle)
+	{
+		ImageViewResource view;
+		if (m_imageViews.erase(handle, &view)) retire(view.view);
+	}
+
+	void ResourceRegistry::destroy(SamplerHandle handle)
+	{
+		SamplerResource sampler;
+		if (m_samplers.erase(handle, &sampler)) retire(sampler.sampler);
+	}
+
+	void ResourceRegistry::destroy(PipelineHandle handle)
+	{
+		PipelineResource pipeline;
+		if (m_pipelines.erase(handle, &pipeline)) retire(pipeline.pipeline);
+	}
+
+	void ResourceRegistry::setImageLayout(ImageHandle handle, vk::ImageLayout layout) noexcept
+	{
+		if (ImageResource* image = m_images.get(handle)) image->layout = layout;
+	}
+
+	void ResourceRegistry::noteBufferWrite(BufferHandle handle, vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		if (!m_bufferWrites.empty()) {
+			BufferWrite& last = m_bufferWrites.back();
+			if (last.buffer == handle && offset >= last.offset && offset <= last.offset + last.size + MERGED_WRITE_GAP) {
+				last.size = std::max(last.size, offset + size - last.offset);
+				return;
+			}
+		}
+		m_bufferWrites.push_back(BufferWrite{ handle, offset, size });
+	}
+
+	void ResourceRegistry::noteImageWrite(ImageHandle handle)
+	{
+		if (std::find(m_imageWrites.begin(), m_imageWrites.end(), handle) == m_imageWrites.end()) m_imageWrites.push_back(handle);
+	}
+
+	void ResourceRegistry::retireBuffer(vk::Buffer buffer, VmaAllocation allocation)
+	{
+		if (!buffer) return;
+		retireObject(toRaw(buffer), allocation, [](VKContext& context, uint64_t raw, VmaAllocation allocation) {
+			vmaDestroyBuffer(context.getVmaAllocator(), reinterpret_cast<VkBuffer>(raw), allocation);
+		});
+	}
+
+	void ResourceRegistry::retireImage(vk::Image image, VmaAllocation allocation)
+	{
+		if (!image) return;
+		retireObject(toRaw(image), allocation, [](VKContext& context, uint64_t raw, VmaAllocation allocation) {
+			vmaDestroyImage(context.getVmaAllocator(), reinterpret_cast<VkImage>(raw), allocation);
+		});
+	}
+
+	void ResourceRegistry::collect(uint64_t completedValue)
+	{
+		// one pass over the completed prefix, the list is ordered by retire value
+		const auto end = std::find_if(m_retired.begin(), m_retired.end(),
+			[completedValue](const RetiredObject& retired) { return retired.retireValue > completedValue; });
+		for (auto it = m_retired.begin(); it != end; ++it) {
+			it->destroy(m_context, it->raw, it->allocation);
+		}
+		m_retired.erase(m_retired.begin(), end);
+	}
+
+	void ResourceRegistry::collect(vk::Semaphore timelineSemaphore)
+	{
+		const uint64_t completedFrames = m_context.getSemaphoreCounterValue(timelineSemaphore);
+		if (completedFrames != 0) collect(completedFrames - 1);
+	}
+
+	void ResourceRegistry::beginFrame(uint64_t frameNumber, vk::Semaphore timelineSemaphore)
+	{
+		// the fence wait of frameNumber's slot completed every frame up to frameNumber - MAX_FRAMES_IN_FLIGHT,
+		// the timeline semaphore also tells about the frames after it
+		if (timelineSemaphore) collect(timelineSemaphore);
+		else if (frameNumber >= MAX_FRAMES_IN_FLIGHT) collect(frameNumber - MAX_FRAMES_IN_FLIGHT);
+		setRetireValue(frameNumber);
+		m_bufferWrites.clear();
+		m_imageWrites.clear();
+	}
+
+	ResourceRegistryStats ResourceRegistry::getStats() const noexcept
+	{
+		ResourceRegistryStats stats;
+		stats.buffers = m_buffers.size();
+		stats.images = m_images.size();
+		stats.imageViews = m_imageViews.size();
+		stats.samplers = m_samplers.size();
+		stats.pipelines = m_pipelines.size();
+		stats.pendingDestructions = static_cast<uint32_t>(m_retired.size());
+		return stats;
+	}
+
+	void ResourceRegistry::retireObject(uint64_t raw, VmaAllocation allocation, DestroyFunction destroy)
+	{
+		m_retired.push_back(RetiredObject{ m_retireValue, raw, allocation, destroy });
+	}
+}
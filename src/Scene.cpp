@@ -0,0 +1,296 @@
+#include "Scene.h"
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		template<typename T>
+		inline void moveLastTo(std::vector<T>& values, uint32_t dense)
+		{
+			if (dense + 1 != values.size()) values[dense] = std::move(values.back());
+			values.pop_back();
+		}
+	}
+
+	Scene::Scene(uint32_t capacity)
+	{
+		m_pool.reserve(capacity);
+		m_localPositions.reserve(capacity);
+		m_localRotations.reserve(capacity);
+		m_localScales.reserve(capacity);
+		m_localBoundsCenters.reserve(capacity);
+		m_localBoundsExtents.reserve(capacity);
+		m_parents.reserve(capacity);
+		m_firstChildren.reserve(capacity);
+		m_nextSiblings.reserve(capacity);
+		m_previousSiblings.reserve(capacity);
+		m_depths.reserve(capacity);
+		m_instances.reserve(capacity);
+		m_worldBounds.reserve(capacity);
+		m_dirtyFlags.reserve(capacity);
+		m_updateStamps.reserve(capacity);
+	}
+
+	SceneNode Scene::createNode(SceneNode parent)
+	{
+		const uint32_t parentDense = parent.isValid() ? getDenseChecked(parent) : NO_NODE;
+
+		const SceneNode node = m_pool.allocate();
+		const uint32_t dense = m_pool.size() - 1;
+		m_localPositions.emplace_back(0.0f);
+		m_localRotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+		m_localScales.emplace_back(1.0f);
+		m_localBoundsCenters.emplace_back(0.0f, 0.0f, 0.0f, 1.0f);
+		m_localBoundsExtents.emplace_back(0.0f);
+		m_parents.push_back(NO_NODE);
+		m_firstChildren.push_back(NO_NODE);
+		m_nextSiblings.push_back(NO_NODE);
+		m_previousSiblings.push_back(NO_NODE);
+		m_depths.push_back(0);
+		m_instances.emplace_back();
+		m_worldBounds.emplace_back();
+		m_dirtyFlags.push_back(0);
+		m_updateStamps.push_back(m_updateStamp);
+
+		if (parentDense != NO_NODE) {
+			link(dense, parent.index);
+			m_depths[dense] = m_depths[parentDense] + 1;
+		}
+		markDirty(dense);
+		return node;
+	}
+
+	void Scene::destroyNode(SceneNode node)
+	{
+		const uint32_t dense = m_pool.getDenseIndex(node);
+		if (dense == UINT32_MAX) return;
+		unlink(dense);
+
+		// gather the subtree first, releasing nodes reorders the dense arrays
+		std::vector<SceneNode> subtree;
+		m_traversalStack.clear();
+		m_traversalStack.push_back(node.index);
+		while (!m_traversalStack.empty()) {
+			const uint32_t slot = m_traversalStack.back();
+			m_traversalStack.pop_back();
+			const uint32_t current = denseOf(slot);
+			subtree.push_back(m_pool.getHandle(current));
+			for (uint32_t child = m_firstChildren[current]; child != NO_NODE; child = m_nextSiblings[denseOf(child)]) {
+				m_traversalStack.push_back(child);
+			}
+		}
+
+		for (const SceneNode removed : subtree) {
+			removeDense(m_pool.release(removed));
+		}
+	}
+
+	void Scene::setParent(SceneNode node, SceneNode parent)
+	{
+		const uint32_t dense = getDenseChecked(node);
+		const uint32_t parentDense = parent.isValid() ? getDenseChecked(parent) : NO_NODE;
+
+		for (uint32_t ancestor = parentDense; ancestor != NO_NODE;
+			ancestor = m_parents[ancestor] == NO_NODE ? NO_NODE : denseOf(m_parents[ancestor])) {
+			if (ancestor == dense) {
+				spdlog::error("Can not parent scene node {} to its own descendant {}!", node.index, parent.index);
+				throw std::runtime_error("Scene hierarchy cycle!");
+			}
+		}
+
+		unlink(dense);
+		if (parentDense != NO_NODE) link(dense, parent.index);
+		updateDepths(node.index);
+		markDirty(dense);
+	}
+
+	void Scene::setLocalTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		const uint32_t dense = getDenseChecked(node);
+		m_localPositions[dense] = position;
+		m_localRotations[dense] = rotation;
+		m_localScales[dense] = scale;
+		markDirty(dense);
+	}
+
+	void Scene::setLocalPosition(SceneNode node, const glm::vec3& position)
+	{
+		const uint32_t dense = getDenseChecked(node);
+		m_localPositions[dense] = position;
+		markDirty(dense);
+	}
+
+	void Scene::setLocalBounds(SceneNode node, const glm::vec3& min, const glm::vec3& max)
+	{
+		const uint32_t dense = getDenseChecked(node);
+		m_localBoundsCenters[dense] = glm::vec4((min + max) * 0.5f, 1.0f);
+		m_localBoundsExtents[dense] = glm::vec4((max - min) * 0.5f, 0.0f);
+		markDirty(dense);
+	}
+
+	void Scene::setRenderData(SceneNode node, uint32_t meshIndex, uint32_t materialIndex)
+	{
+		const uint32_t dense = getDenseChecked(node);
+		m_instances[dense].meshIndex = meshIndex;
+		m_instances[dense].materialIndex = materialIndex;
+		// only the instance data changed, the subtree does not need a transform update
+		m_modifiedInstances.push_back(dense);
+	}
+
+	void Scene::update(JobSystem& jobSystem)
+	{
+		++m_updateStamp;
+		for (auto& bucket : m_depthBuckets) {
+			bucket.clear();
+		}
+
+		for (const SceneNode node : m_dirtyNodes) {
+			const uint32_t dense = m_pool.getDenseIndex(node);
+			if (dense == UINT32_MAX) continue;
+			m_dirtyFlags[dense] = 0;
+			collectSubtree(node.index);
+		}
+		m_dirtyNodes.clear();
+
+		// parents are finished before their children, nodes of one level are independent
+		m_changedInstances.clear();
+		for (const auto& bucket : m_depthBuckets) {
+			if (bucket.empty()) continue;
+			jobSystem.parallelFor(static_cast<uint32_t>(bucket.size()), 1024, [this, &bucket](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; ++i) {
+					updateNode(bucket[i]);
+				}
+			});
+			m_changedInstances.insert(m_changedInstances.end(), bucket.begin(), bucket.end());
+		}
+
+		for (const uint32_t dense : m_modifiedInstances) {
+			if (dense < m_pool.size() && m_updateStamps[dense] != m_updateStamp) m_changedInstances.push_back(dense);
+		}
+		m_modifiedInstances.clear();
+	}
+
+	uint32_t Scene::getDenseChecked(SceneNode node) const
+	{
+		const uint32_t dense = m_pool.getDenseIndex(node);
+		if (dense == UINT32_MAX) {
+			spdlog::error("Stale scene node handle {}:{}!", node.index, node.generation);
+			throw std::runtime_error("Stale scene node handle!");
+		}
+		return dense;
+	}
+
+	void Scene::markDirty(uint32_t dense)
+	{
+		if (m_dirtyFlags[dense]) return;
+		m_dirtyFlags[dense] = 1;
+		m_dirtyNodes.push_back(m_pool.getHandle(dense));
+	}
+
+	void Scene::link(uint32_t dense, uint32_t parentSlot) noexcept
+	{
+		const uint32_t parentDense = denseOf(parentSlot);
+		const uint32_t slot = m_pool.getSlot(dense);
+		const uint32_t firstChild = m_firstChildren[parentDense];
+
+		m_parents[dense] = parentSlot;
+		m_previousSiblings[dense] = NO_NODE;
+		m_nextSiblings[dense] = firstChild;
+		if (firstChild != NO_NODE) m_previousSiblings[denseOf(firstChild)] = slot;
+		m_firstChildren[parentDense] = slot;
+	}
+
+	void Scene::unlink(uint32_t dense) noexcept
+	{
+		const uint32_t parentSlot = m_parents[dense];
+		if (parentSlot == NO_NODE) return;
+
+		const uint32_t previous = m_previousSiblings[dense];
+		const uint32_t next = m_nextSiblings[dense];
+		if (previous != NO_NODE) m_nextSiblings[denseOf(previous)] = next;
+		else m_firstChildren[denseOf(parentSlot)] = next;
+		if (next != NO_NODE) m_previousSiblings[denseOf(next)] = previous;
+
+		m_parents[dense] = NO_NODE;
+		m_previousSiblings[dense] = NO_NODE;
+		m_nextSiblings[dense] = NO_NODE;
+	}
+
+	void Scene::updateDepths(uint32_t slot)
+	{
+		m_traversalStack.clear();
+		m_traversalStack.push_back(slot);
+		while (!m_traversalStack.empty()) {
+			const uint32_t dense = denseOf(m_traversalStack.back());
+			m_traversalStack.pop_back();
+			m_depths[dense] = m_parents[dense] == NO_NODE ? 0 : m_depths[denseOf(m_parents[dense])] + 1;
+			for (uint32_t child = m_firstChildren[dense]; child != NO_NODE; child = m_nextSiblings[denseOf(child)]) {
+				m_traversalStack.push_back(child);
+			}
+		}
+	}
+
+	void Scene::collectSubtree(uint32_t slot)
+	{
+		m_traversalStack.clear();
+		m_traversalStack.push_back(slot);
+		while (!m_traversalStack.empty()) {
+			const uint32_t dense = denseOf(m_traversalStack.back());
+			m_traversalStack.pop_back();
+
+			// already collected through a dirty ancestor or descendant root, its subtree is too
+			if (m_updateStamps[dense] == m_updateStamp) continue;
+			m_updateStamps[dense] = m_updateStamp;
+
+			const uint32_t depth = m_depths[dense];
+			if (depth >= m_depthBuckets.size()) m_depthBuckets.resize(depth + 1);
+			m_depthBuckets[depth].push_back(dense);
+
+			for (uint32_t child = m_firstChildren[dense]; child != NO_NODE; child = m_nextSiblings[denseOf(child)]) {
+				m_traversalStack.push_back(child);
+			}
+		}
+	}
+
+	void Scene::removeDense(uint32_t dense)
+	{
+		moveLastTo(m_localPositions, dense);
+		moveLastTo(m_localRotations, dense);
+		moveLastTo(m_localScales, dense);
+		moveLastTo(m_localBoundsCenters, dense);
+		moveLastTo(m_localBoundsExtents, dense);
+		moveLastTo(m_parents, dense);
+		moveLastTo(m_firstChildren, dense);
+		moveLastTo(m_nextSiblings, dense);
+		moveLastTo(m_previousSiblings, dense);
+		moveLastTo(m_depths, dense);
+		moveLastTo(m_instances, dense);
+		moveLastTo(m_worldBounds, dense);
+		moveLastTo(m_dirtyFlags, dense);
+		moveLastTo(m_updateStamps, dense);
+
+		if (dense < m_pool.size()) m_modifiedInstances.push_back(dense);
+	}
+
+	void Scene::updateNode(uint32_t dense) noexcept
+	{
+		glm::mat4 local = glm::mat4_cast(m_localRotations[dense]);
+		const glm::vec3& scale = m_localScales[dense];
+		local[0] *= scale.x;
+		local[1] *= scale.y;
+		local[2] *= scale.z;
+		local[3] = glm::vec4(m_localPositions[dense], 1.0f);
+
+		const uint32_t parentSlot = m_parents[dense];
+		const glm::mat4 world = parentSlot == NO_NODE ? local : m_instances[denseOf(parentSlot)].model * local;
+		m_instances[dense].model = world;
+
+		// transformed box of the local box: |M| * extent around the transformed center
+		const glm::vec4& extent = m_localBoundsExtents[dense];
+		const glm::vec4 center = world * m_localBoundsCenters[dense];
+		const glm::vec4 worldExtent = glm::abs(world[0]) * extent.x + glm::abs(world[1]) * extent.y + glm::abs(world[2]) * extent.z;
+		m_worldBounds[dense].min = center - worldExtent;
+		m_worldBounds[dense].max = center + worldExtent;
+	}
+}
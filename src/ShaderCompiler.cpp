@@ -0,0 +1,89 @@
+#include "ShaderCompiler.h"
+#include <spdlog/spdlog.h>
+
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+
+#include <mutex>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		EShLanguage getShaderLanguage(vk::ShaderStageFlagBits stage)
+		{
+			switch (stage) {
+			case vk::ShaderStageFlagBits::eVertex: return EShLangVertex;
+			case vk::ShaderStageFlagBits::eTessellationControl: return EShLangTessControl;
+			case vk::ShaderStageFlagBits::eTessellationEvaluation: return EShLangTessEvaluation;
+			case vk::ShaderStageFlagBits::eGeometry: return EShLangGeometry;
+			case vk::ShaderStageFlagBits::eFragment: return EShLangFragment;
+			case vk::ShaderStageFlagBits::eCompute: return EShLangCompute;
+			default:
+				spdlog::error("Shader stage {} can not be compiled!", vk::to_string(stage));
+				throw std::runtime_error("Unsupported shader stage!");
+			}
+		}
+
+		// every Vulkan version requires the SPIR-V version that was current at its release
+		void getShaderTarget(uint32_t apiVersion, glslang::EShTargetClientVersion& client, glslang::EShTargetLanguageVersion& spirv) noexcept
+		{
+			const uint32_t minor = VK_API_VERSION_MAJOR(apiVersion) > 1 ? UINT32_MAX : VK_API_VERSION_MINOR(apiVersion);
+			if (minor >= 3) {
+				client = glslang::EShTargetVulkan_1_3;
+				spirv = glslang::EShTargetSpv_1_6;
+			}
+			else if (minor == 2) {
+				client = glslang::EShTargetVulkan_1_2;
+				spirv = glslang::EShTargetSpv_1_5;
+			}
+			else if (minor == 1) {
+				client = glslang::EShTargetVulkan_1_1;
+				spirv = glslang::EShTargetSpv_1_3;
+			}
+			else {
+				client = glslang::EShTargetVulkan_1_0;
+				spirv = glslang::EShTargetSpv_1_0;
+			}
+		}
+	}
+
+	std::vector<uint32_t> compileShader(vk::ShaderStageFlagBits stage, std::string_view source, const std::string& name,
+		uint32_t apiVersion)
+	{
+		// glslang keeps process wide tables, they live until the process exits
+		static std::once_flag initialized;
+		std::call_once(initialized, [] { glslang::InitializeProcess(); });
+
+		const EShLanguage language = getShaderLanguage(stage);
+		const char* text = source.data();
+		const int length = static_cast<int>(source.size());
+		const char* fileName = name.c_str();
+		glslang::EShTargetClientVersion clientVersion;
+		glslang::EShTargetLanguageVersion spirvVersion;
+		getShaderTarget(apiVersion, clientVersion, spirvVersion);
+
+		glslang::TShader shader(language);
+		shader.setStringsWithLengthsAndNames(&text, &length, &fileName, 1);
+		shader.setEnvInput(glslang::EShSourceGlsl, language, glslang::EShClientVulkan, 100);
+		shader.setEnvClient(glslang::EShClientVulkan, clientVersion);
+		shader.setEnvTarget(glslang::EShTargetSpv, spirvVersion);
+		const auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+		if (!shader.parse(GetDefaultResources(), 100, false, messages)) {
+			spdlog::error("Failed to compile shader {}:\n{}", name, shader.getInfoLog());
+			throw std::runtime_error("Failed to compile shader!");
+		}
+
+		glslang::TProgram program;
+		program.addShader(&shader);
+		if (!program.link(messages)) {
+			spdlog::error("Failed to link shader {}:\n{}", name, program.getInfoLog());
+			throw std::runtime_error("Failed to link shader!");
+		}
+
+		std::vector<uint32_t> spirv;
+		glslang::GlslangToSpv(*program.getIntermediate(language), spirv);
+		spdlog::debug("Compiled shader {} to {} bytes of SPIR-V", name, spirv.size() * sizeof(uint32_t));
+		return spirv;
+	}
+}
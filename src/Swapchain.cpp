@@ -2,18 +2,41 @@
 #include <spdlog/spdlog.h>
 
 namespace coldwind {
-	SwapChain::SwapChain(VKContext& context, Window& window)
+	SwapChain::SwapChain(VKContext& context, Window& window, ResourceRegistry& registry)
+		: m_registry(registry)
 	{
 		createSwapchain(context, window);
 	}
 
+	SwapChain::~SwapChain()
+	{
+		for (const ImageHandle image : m_swapChainImageHandles) m_registry.destroy(image);
+	}
+
 	void SwapChain::createSwapchain(VKContext& context, Window& window)
 	{
-		if (window.getWindowExtent2D() == m_swapChainExtent2D) return;
+		if (window.getWindowExtent2D() == m_swapChainExtent2D && !m_isOutOfDate) return;
+		m_isOutOfDate = false;
 
 		vk::PhysicalDevice physicalDevice = context.getPhysicalDevice();
 		auto& surface = window.getSurface();
 		if (m_swapChainExtent2D == vk::Extent2D()) {
+			// the present queue was chosen for the first window's surface, later windows must be presentable from it too
+			auto presentSupport = physicalDevice.getSurfaceSupportKHR(context.getPresentQueueFamilyIndex(), surface.get());
+			if (presentSupport.result != vk::Result::eSuccess || !presentSupport.value) {
+				spdlog::error("Present queue family {} can not present to the window surface!", context.getPresentQueueFamilyIndex());
+				throw std::runtime_error("Surface not supported by the present queue!");
+			}
+
+			for (auto& semaphore : m_imageAvailableSemaphores) {
+				auto semaphoreCreateResult = context.getDevice()->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+				if (semaphoreCreateResult.result != vk::Result::eSuccess) {
+					spdlog::error("Failed to create swapchain semaphore! Error code: {}", vk::to_string(semaphoreCreateResult.result));
+					throw std::runtime_error("Failed to create swapchain semaphore!");
+				}
+				semaphore = std::move(semaphoreCreateResult.value);
+			}
+
 			auto surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
 			if (surfaceFormats.result != vk::Result::eSuccess) {
 				spdlog::error("Failed to get surface formats! Error code: {}", vk::to_string(surfaceFormats.result));
@@ -75,6 +98,13 @@ namespace coldwind {
 		}
 
 		vk::ImageUsageFlags imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+		if (surfaceCapabilities.value.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) {
+			imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
+		}
+		// lets a FrameRecorder read presented images back
+		if (surfaceCapabilities.value.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc) {
+			imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
 		uint32_t queueFamilyIndices[] = { context.getGraphicQueueFamilyIndex(), context.getPresentQueueFamilyIndex() };
 
 		vk::SwapchainCreateInfoKHR swapchainCreateInfo;
@@ -85,6 +115,7 @@ namespace coldwind {
 		swapchainCreateInfo.imageExtent = m_swapChainExtent2D;
 		swapchainCreateInfo.imageArrayLayers = 1;
 		swapchainCreateInfo.imageUsage = imageUsage;
+		m_imageUsage = imageUsage;
 		if (context.getGraphicQueueFamilyIndex() != context.getPresentQueueFamilyIndex()) {
 			swapchainCreateInfo.imageSharingMode = vk::SharingMode::eConcurrent;
 			swapchainCreateInfo.queueFamilyIndexCount = 2;
@@ -99,13 +130,23 @@ namespace coldwind {
 		swapchainCreateInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
 		swapchainCreateInfo.presentMode = m_presentMode;
 		swapchainCreateInfo.clipped = VK_TRUE;
-		swapchainCreateInfo.oldSwapchain = nullptr;
+		swapchainCreateInfo.oldSwapchain = m_swapChain.get();
 
 		auto& device = context.getDevice();
 		auto returnValue = device->createSwapchainKHRUnique(swapchainCreateInfo);
 
 		if (returnValue.result == vk::Result::eSuccess) {
 			spdlog::debug("Succeed to create swapchain!");
+			// frame completion says nothing about presents, the ones still waiting on the old render finished
+			// semaphores are drained before those are retired, rendering is still left to the retire values
+			if (m_swapChain) {
+				const auto result = context.getPresentQueue().waitIdle();
+				if (result != vk::Result::eSuccess) {
+					spdlog::error("Failed to drain the present queue! Error code: {}", vk::to_string(result));
+					throw std::runtime_error("Failed to drain the present queue!");
+				}
+			}
+			m_registry.retire(std::move(m_swapChain));
 			m_swapChain = std::move(returnValue.value);
 		}
 		else {
@@ -130,12 +171,19 @@ namespace coldwind {
 			viewInfo.subresourceRange.baseArrayLayer = 0;
 			viewInfo.subresourceRange.layerCount = 1;
 
+			for (auto& imageView : m_swapChainImageViews) m_registry.retire(std::move(imageView));
+			for (auto& semaphore : m_renderFinishedSemaphores) m_registry.retire(std::move(semaphore));
+			for (const ImageHandle image : m_swapChainImageHandles) m_registry.destroy(image);
+
 			size_t swapchainImageSize = swapchainImages.value.size();
 			spdlog::info("Swapchain image count: {}", swapchainImageSize);
 			m_swapChainImages.resize(swapchainImageSize);
+			m_swapChainImageHandles.resize(swapchainImageSize);
 			m_swapChainImageViews.resize(swapchainImageSize);
+			m_renderFinishedSemaphores.resize(swapchainImageSize);
 			for (size_t i = 0; i < swapchainImageSize; ++i) {
 				m_swapChainImages[i] = swapchainImages.value[i];
+				m_swapChainImageHandles[i] = m_registry.importImage(m_swapChainImages[i], m_surfaceFormat.format, m_swapChainExtent2D, imageUsage);
 				viewInfo.image = m_swapChainImages[i];
 				auto imageViewCreateResult = device->createImageViewUnique(viewInfo);
 				if (imageViewCreateResult.result != vk::Result::eSuccess) {
@@ -146,6 +194,63 @@ namespace coldwind {
 					m_swapChainImageViews[i] = std::move(imageViewCreateResult.value);
 					spdlog::debug("Succeed to create swapchain image view!");
 				}
+
+				auto semaphoreCreateResult = device->createSemaphoreUnique(vk::SemaphoreCreateInfo());
+				if (semaphoreCreateResult.result != vk::Result::eSuccess) {
+					spdlog::error("Failed to create swapchain semaphore! Error code: {}", vk::to_string(semaphoreCreateResult.result));
+					throw std::runtime_error("Failed to create swapchain semaphore!");
+				}
+				m_renderFinishedSemaphores[i] = std::move(semaphoreCreateResult.value);
+			}
+		}
+	}
+
+	vk::Result SwapChain::acquireNextImage(VKContext& context, uint32_t frameSlot, uint32_t& imageIndex)
+	{
+		auto result = context.getDevice()->acquireNextImageKHR(m_swapChain.get(), UINT64_MAX,
+			m_imageAvailableSemaphores[frameSlot].get(), nullptr);
+		if (result.result == vk::Result::eErrorOutOfDateKHR || result.result == vk::Result::eSuboptimalKHR) {
+			m_isOutOfDate = true;
+		}
+		else if (result.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to acquire swapchain image! Error code: {}", vk::to_string(result.result));
+			throw std::runtime_error("Failed to acquire swapchain image!");
+		}
+		imageIndex = result.value;
+		return result.result;
+	}
+
+	void SwapChain::present(VKContext& context, std::span<SwapChain* const> swapChains, std::span<const uint32_t> imageIndices,
+		LinearAllocator& scratch)
+	{
+		const uint32_t count = static_cast<uint32_t>(swapChains.size());
+		if (count == 0) return;
+
+		auto* waitSemaphores = scratch.allocateArray<vk::Semaphore>(count);
+		auto* swapchains = scratch.allocateArray<vk::SwapchainKHR>(count);
+		auto* results = scratch.allocateArray<vk::Result>(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			waitSemaphores[i] = swapChains[i]->m_renderFinishedSemaphores[imageIndices[i]].get();
+			swapchains[i] = swapChains[i]->m_swapChain.get();
+		}
+
+		vk::PresentInfoKHR presentInfo{};
+		presentInfo.waitSemaphoreCount = count;
+		presentInfo.pWaitSemaphores = waitSemaphores;
+		presentInfo.swapchainCount = count;
+		presentInfo.pSwapchains = swapchains;
+		presentInfo.pImageIndices = imageIndices.data();
+		presentInfo.pResults = results;
+		auto result = context.getPresentQueue().presentKHR(presentInfo);
+		if (result != vk::Result::eSuccess && result != vk::Result::eErrorOutOfDateKHR && result != vk::Result::eSuboptimalKHR) {
+			spdlog::error("Failed to present swapchain images! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to present swapchain images!");
+		}
+
+		// the call reports the worst result, each swapchain's own result decides its recreation
+		for (uint32_t i = 0; i < count; ++i) {
+			if (results[i] == vk::Result::eErrorOutOfDateKHR || results[i] == vk::Result::eSuboptimalKHR) {
+				swapChains[i]->m_isOutOfDate = true;
 			}
 		}
 	}
@@ -0,0 +1,64 @@
+#include "TextureLoader.h"
+#include "Ktx2File.h"
+#include <spdlog/spdlog.h>
+
+#include <memory>
+#include <stdexcept>
+
+namespace coldwind {
+	TextureLoader::TextureLoader(VKContext& context, JobSystem& jobSystem, TextureStreamer& streamer)
+		: m_context(context), m_streamer(streamer), m_transcoder(jobSystem)
+	{
+	}
+
+	StreamedTextureId TextureLoader::loadKtx2(const std::string& path, uint32_t baseResidentMips)
+	{
+		auto source = std::make_shared<Ktx2File>(path);
+		const vk::Format sourceFormat = source->getFormat();
+
+		// uncompressed sources only need BC3 when the alpha channel is used. Baked files record it, others
+		// have their base level scanned, smaller mips average sparse cutouts away
+		bool alpha = false;
+		if (getFormatBlockInfo(sourceFormat).blockWidth == 1) {
+			if (const std::optional<bool> recordedAlpha = source->hasAlpha()) {
+				alpha = *recordedAlpha;
+			}
+			else {
+				std::vector<uint8_t> texels(source->getLevelSize(0));
+				if (source->readLevel(0, texels.data(), texels.size())) {
+					alpha = TextureTranscoder::hasAlpha(texels.data(), texels.size() / 4);
+				}
+			}
+		}
+
+		const vk::Format targetFormat = TextureTranscoder::selectTargetFormat(m_context.getPhysicalDevice(), sourceFormat, alpha);
+		if (targetFormat == vk::Format::eUndefined || !TextureTranscoder::canTranscode(sourceFormat, targetFormat)) {
+			spdlog::error("Texture {} format {} is not supported by the device!", path, vk::to_string(sourceFormat));
+			throw std::runtime_error("Texture format is not supported by the device!");
+		}
+		spdlog::debug("Texture {} stored as {}, sampled as {}", path, vk::to_string(sourceFormat), vk::to_string(targetFormat));
+
+		StreamedTextureCreateInfo createInfo{};
+		createInfo.format = targetFormat;
+		createInfo.width = source->getWidth();
+		createInfo.height = source->getHeight();
+		createInfo.mipLevels = source->getMipLevels();
+		createInfo.baseResidentMips = baseResidentMips;
+
+		const uint32_t width = source->getWidth();
+		const uint32_t height = source->getHeight();
+		auto scratch = std::make_shared<std::vector<uint8_t>>();
+		TextureTranscoder* transcoder = &m_transcoder;
+		createInfo.loadMip = [source, scratch, transcoder, sourceFormat, targetFormat, width, height](
+			uint32_t mipLevel, void* dst, vk::DeviceSize size) {
+			if (sourceFormat == targetFormat) return source->readLevel(mipLevel, dst, size);
+
+			scratch->resize(source->getLevelSize(mipLevel));
+			if (!source->readLevel(mipLevel, scratch->data(), scratch->size())) return false;
+			return transcoder->transcode(scratch->data(), sourceFormat, static_cast<uint8_t*>(dst), targetFormat,
+				getMipExtent(width, mipLevel), getMipExtent(height, mipLevel));
+		};
+
+		return m_streamer.createTexture(std::move(createInfo));
+	}
+}
@@ -0,0 +1,614 @@
+#include "TextureStreamer.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace coldwind {
+	namespace {
+		// copy offsets must be a multiple of the texel block size and of 4
+		constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+		constexpr uint32_t MAX_STREAMED_MIP_LEVELS = 16;
+
+		inline vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) noexcept
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	TextureStreamer::TextureStreamer(VKContext& context, ResourceRegistry& registry, JobSystem& jobSystem,
+		uint32_t maxTextures, vk::DeviceSize stagingSize)
+		: m_context(context), m_registry(registry), m_jobSystem(jobSystem), m_maxTextures(maxTextures),
+		m_stagingSlotSize(alignUp(stagingSize / MAX_FRAMES_IN_FLIGHT, STAGING_ALIGNMENT))
+	{
+		m_textures.reserve(m_maxTextures);
+		m_freeIds.reserve(m_maxTextures);
+		m_candidates.reserve(m_maxTextures);
+
+		createHostBuffer(m_staging, m_stagingSlotSize * MAX_FRAMES_IN_FLIGHT, vk::BufferUsageFlagBits::eTransferSrc);
+		for (auto& feedback : m_feedback) {
+			createHostBuffer(feedback, getFeedbackBufferSize(), vk::BufferUsageFlagBits::eStorageBuffer);
+			std::memset(feedback.mapped, 0xFF, getFeedbackBufferSize());
+			vmaFlushAllocation(m_context.getVmaAllocator(), feedback.allocation, 0, VK_WHOLE_SIZE);
+		}
+
+		auto& device = m_context.getDevice();
+		vk::CommandPoolCreateInfo commandPoolCreateInfo{};
+		commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+		commandPoolCreateInfo.queueFamilyIndex = m_context.getTransferQueueFamilyIndex();
+		auto commandPool = device->createCommandPoolUnique(commandPoolCreateInfo);
+		if (commandPool.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create texture streaming command pool! Error code: {}", vk::to_string(commandPool.result));
+			throw std::runtime_error("Failed to create texture streaming command pool!");
+		}
+		m_commandPool = std::move(commandPool.value);
+
+		vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.commandPool = m_commandPool.get();
+		commandBufferAllocateInfo.level = vk::CommandBufferLevel::ePrimary;
+		commandBufferAllocateInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+		auto commandBuffers = device->allocateCommandBuffers(commandBufferAllocateInfo);
+		if (commandBuffers.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to allocate texture streaming command buffers! Error code: {}", vk::to_string(commandBuffers.result));
+			throw std::runtime_error("Failed to allocate texture streaming command buffers!");
+		}
+
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			auto fence = device->createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+			if (fence.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create texture streaming fence! Error code: {}", vk::to_string(fence.result));
+				throw std::runtime_error("Failed to create texture streaming fence!");
+			}
+			m_batches[i].commandBuffer = commandBuffers.value[i];
+			m_batches[i].fence = std::move(fence.value);
+			m_batches[i].uploads.reserve(m_maxTextures);
+		}
+
+		m_stats.budgetBytes = m_context.getDeviceLocalBudget() / 2;
+		spdlog::info("Texture streamer initialized, budget: {} MiB, staging: {} MiB",
+			m_stats.budgetBytes >> 20, (m_stagingSlotSize * MAX_FRAMES_IN_FLIGHT) >> 20);
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		// load jobs write to the staging buffer
+		for (auto& batch : m_batches) {
+			m_jobSystem.wait(batch.loads);
+		}
+		static_cast<void>(m_context.getDevice()->waitIdle());
+
+		for (auto& texture : m_textures) {
+			destroyImage(texture.resident);
+			destroyImage(texture.pending);
+		}
+
+		destroyHostBuffer(m_staging);
+		for (auto& feedback : m_feedback) {
+			destroyHostBuffer(feedback);
+		}
+	}
+
+	StreamedTextureId TextureStreamer::createTexture(StreamedTextureCreateInfo createInfo)
+	{
+		if (createInfo.width == 0 || createInfo.height == 0 || !createInfo.loadMip ||
+			createInfo.mipLevels == 0 || createInfo.mipLevels > MAX_STREAMED_MIP_LEVELS) {
+			spdlog::error("Invalid streamed texture {}x{} with {} mips!", createInfo.width, createInfo.height, createInfo.mipLevels);
+			throw std::runtime_error("Invalid streamed texture!");
+		}
+
+		StreamedTextureId id;
+		if (!m_freeIds.empty()) {
+			id = m_freeIds.back();
+			m_freeIds.pop_back();
+		}
+		else if (m_textures.size() < m_maxTextures) {
+			id = static_cast<StreamedTextureId>(m_textures.size());
+			m_textures.emplace_back();
+		}
+		else {
+			spdlog::error("Texture streamer is full, capacity: {}", m_maxTextures);
+			throw std::runtime_error("Texture streamer is full!");
+		}
+
+		auto& texture = m_textures[id];
+		const uint32_t baseResidentMips = std::clamp(createInfo.baseResidentMips, 1u, createInfo.mipLevels);
+		texture.baseMip = createInfo.mipLevels - baseResidentMips;
+		texture.info = std::move(createInfo);
+		texture.resident = TextureImage{};
+		texture.resident.topMip = texture.info.mipLevels;
+		texture.hasPending = false;
+		texture.alive = true;
+		texture.requestedMip = UINT32_MAX;
+		texture.lastRequestedFrame = m_frameNumber;
+		m_lru.push_front(id);
+		texture.lruIter = m_lru.begin();
+		return id;
+	}
+
+	void TextureStreamer::destroyTexture(StreamedTextureId id)
+	{
+		if (id >= m_textures.size() || !m_textures[id].alive) return;
+
+		auto& texture = m_textures[id];
+		texture.alive = false;
+		m_lru.erase(texture.lruIter);
+		m_stats.committedBytes -= texture.hasPending ? texture.pending.bytes : texture.resident.bytes;
+
+		// an in flight upload still references the pending image, completeUploads() releases the id
+		if (texture.hasPending) return;
+
+		retireImage(texture.resident);
+		texture.info = StreamedTextureCreateInfo{};
+		m_freeIds.push_back(id);
+	}
+
+	void TextureStreamer::requestMip(StreamedTextureId id, uint32_t mipLevel) noexcept
+	{
+		if (id >= m_textures.size()) return;
+		auto& texture = m_textures[id];
+		if (texture.alive) texture.requestedMip = std::min(texture.requestedMip, mipLevel);
+	}
+
+	uint32_t TextureStreamer::estimateMipLevel(uint32_t width, uint32_t height, float screenWidth, float screenHeight) noexcept
+	{
+		const float ratio = std::max(
+			static_cast<float>(width) / std::max(screenWidth, 1.0f),
+			static_cast<float>(height) / std::max(screenHeight, 1.0f));
+		if (ratio <= 1.0f) return 0;
+		return static_cast<uint32_t>(std::floor(std::log2(ratio)));
+	}
+
+	vk::ImageView TextureStreamer::getImageView(StreamedTextureId id) const noexcept
+	{
+		if (id >= m_textures.size() || !m_textures[id].alive) return nullptr;
+		return m_textures[id].resident.view.get();
+	}
+
+	uint32_t TextureStreamer::getResidentMip(StreamedTextureId id) const noexcept
+	{
+		if (id >= m_textures.size() || !m_textures[id].alive) return 0;
+		return m_textures[id].resident.topMip;
+	}
+
+	void TextureStreamer::update(uint64_t frameNumber)
+	{
+		m_frameNumber = frameNumber;
+		m_stats.uploadsThisFrame = 0;
+		m_stats.evictionsThisFrame = 0;
+		m_stats.uploadedBytesThisFrame = 0;
+
+		readFeedback(static_cast<uint32_t>(frameNumber % MAX_FRAMES_IN_FLIGHT));
+		completeUploads();
+		submitLoadedBatch();
+
+		m_candidates.clear();
+		m_stats.residentTextures = 0;
+		for (StreamedTextureId id = 0; id < m_textures.size(); ++id) {
+			auto& texture = m_textures[id];
+			if (!texture.alive) continue;
+			if (texture.resident.view) ++m_stats.residentTextures;
+
+			if (texture.requestedMip != UINT32_MAX) {
+				texture.lastRequestedFrame = frameNumber;
+				m_lru.splice(m_lru.begin(), m_lru, texture.lruIter);
+			}
+			const uint32_t targetMip = std::min(texture.requestedMip, texture.baseMip);
+			if (!texture.hasPending && targetMip < texture.resident.topMip) {
+				m_candidates.push_back(id);
+			}
+		}
+
+		TransferBatch* batch = m_candidates.empty() ? nullptr : acquireBatch();
+		if (batch != nullptr) {
+			// textures without any resident mip first, then the largest missing detail
+			std::sort(m_candidates.begin(), m_candidates.end(), [this](StreamedTextureId a, StreamedTextureId b) {
+				const auto& textureA = m_textures[a];
+				const auto& textureB = m_textures[b];
+				const bool emptyA = !textureA.resident.view;
+				const bool emptyB = !textureB.resident.view;
+				if (emptyA != emptyB) return emptyA;
+				const uint32_t gapA = textureA.resident.topMip - std::min(textureA.requestedMip, textureA.baseMip);
+				const uint32_t gapB = textureB.resident.topMip - std::min(textureB.requestedMip, textureB.baseMip);
+				return gapA > gapB;
+			});
+
+			for (StreamedTextureId id : m_candidates) {
+				auto& texture = m_textures[id];
+				// only the added mips go through staging, the resident ones are copied on the GPU
+				const vk::DeviceSize stagingLeft = batch->stagingBegin + m_stagingSlotSize - batch->stagingOffset;
+				uint32_t targetMip = std::min(texture.requestedMip, texture.baseMip);
+				while (targetMip < texture.resident.topMip && getLevelBytes(texture.info, targetMip, texture.resident.topMip) > stagingLeft) ++targetMip;
+				if (targetMip >= texture.resident.topMip) continue;
+
+				// base mips are always loaded, finer mips only within budget
+				const vk::DeviceSize newBytes = getImageBytes(texture.info, targetMip);
+				const vk::DeviceSize committed = m_stats.committedBytes - texture.resident.bytes + newBytes;
+				if (targetMip < texture.baseMip && committed > m_stats.budgetBytes &&
+					!evictFor(committed - m_stats.budgetBytes, id, *batch)) {
+					// nothing to evict, fall back to the base mips unless those are resident already
+					targetMip = texture.baseMip;
+					if (targetMip >= texture.resident.topMip) continue;
+				}
+				static_cast<void>(scheduleReallocation(id, targetMip, *batch));
+			}
+
+			if (!batch->uploads.empty()) {
+				batch->isLoading = true;
+				// evictions alone load nothing and are submitted right away
+				submitLoadedBatch();
+			}
+		}
+
+		for (auto& texture : m_textures) {
+			texture.requestedMip = UINT32_MAX;
+		}
+	}
+
+	void TextureStreamer::readFeedback(uint32_t frameSlot)
+	{
+		HostBuffer& feedback = m_feedback[frameSlot];
+		vmaInvalidateAllocation(m_context.getVmaAllocator(), feedback.allocation, 0, VK_WHOLE_SIZE);
+
+		const uint32_t* sampledMips = reinterpret_cast<const uint32_t*>(feedback.mapped);
+		for (StreamedTextureId id = 0; id < m_textures.size(); ++id) {
+			if (m_textures[id].alive && sampledMips[id] != UINT32_MAX) {
+				m_textures[id].requestedMip = std::min(m_textures[id].requestedMip, sampledMips[id]);
+			}
+		}
+
+		std::memset(feedback.mapped, 0xFF, m_textures.size() * sizeof(uint32_t));
+		vmaFlushAllocation(m_context.getVmaAllocator(), feedback.allocation, 0, VK_WHOLE_SIZE);
+	}
+
+	void TextureStreamer::completeUploads()
+	{
+		auto& device = m_context.getDevice();
+		for (auto& batch : m_batches) {
+			if (!batch.submitted || device->getFenceStatus(batch.fence.get()) != vk::Result::eSuccess) continue;
+
+			batch.submitted = false;
+			for (const Upload& upload : batch.uploads) {
+				auto& texture = m_textures[upload.id];
+				if (!texture.hasPending) continue;
+
+				retireImage(texture.resident);
+				texture.resident = std::move(texture.pending);
+				texture.pending = TextureImage{};
+				texture.hasPending = false;
+
+				if (!texture.alive) {
+					retireImage(texture.resident);
+					texture.info = StreamedTextureCreateInfo{};
+					m_freeIds.push_back(upload.id);
+					continue;
+				}
+				// the batch left the image in eGeneral, a running capture reads its contents back
+				m_registry.setImageLayout(texture.resident.image, vk::ImageLayout::eGeneral);
+				m_registry.noteImageWrite(texture.resident.image);
+			}
+			batch.uploads.clear();
+		}
+	}
+
+	TextureStreamer::TransferBatch* TextureStreamer::acquireBatch()
+	{
+		TransferBatch& batch = m_batches[m_batchIndex];
+		if (batch.submitted || batch.isLoading) return nullptr;
+
+		batch.stagingBegin = m_batchIndex * m_stagingSlotSize;
+		batch.stagingOffset = batch.stagingBegin;
+		batch.uploads.clear();
+		return &batch;
+	}
+
+	void TextureStreamer::submitLoadedBatch()
+	{
+		TransferBatch& batch = m_batches[m_batchIndex];
+		if (!batch.isLoading || batch.loads.isBusy()) return;
+		batch.isLoading = false;
+
+		static_cast<void>(batch.commandBuffer.reset());
+		auto result = batch.commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to begin texture streaming command buffer! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to begin texture streaming command buffer!");
+		}
+		// resident images were written by earlier batches on this queue, the copies below read them
+		vk::MemoryBarrier memoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead);
+		batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), memoryBarrier, nullptr, nullptr);
+
+		// failed or destroyed uploads are dropped from the batch, completeUploads() only sees recorded ones
+		size_t recorded = 0;
+		for (const Upload& upload : batch.uploads) {
+			const auto& texture = m_textures[upload.id];
+			if (!upload.isLoaded || !texture.alive) {
+				abandonUpload(upload);
+				continue;
+			}
+			recordUpload(batch, upload);
+			batch.uploads[recorded++] = upload;
+		}
+		batch.uploads.resize(recorded);
+		if (recorded != 0 && batch.stagingOffset != batch.stagingBegin) {
+			vmaFlushAllocation(m_context.getVmaAllocator(), m_staging.allocation,
+				batch.stagingBegin, batch.stagingOffset - batch.stagingBegin);
+		}
+
+		result = batch.commandBuffer.end();
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to end texture streaming command buffer! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to end texture streaming command buffer!");
+		}
+		if (recorded == 0) return;
+
+		auto& device = m_context.getDevice();
+		static_cast<void>(device->resetFences(batch.fence.get()));
+
+		vk::SubmitInfo submitInfo{};
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		result = m_context.getTransferQueue().submit(submitInfo, batch.fence.get());
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to submit texture streaming uploads! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to submit texture streaming uploads!");
+		}
+
+		batch.submitted = true;
+		m_batchIndex = (m_batchIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+	}
+
+	void TextureStreamer::recordUpload(TransferBatch& batch, const Upload& upload)
+	{
+		const auto& texture = m_textures[upload.id];
+		const auto& info = texture.info;
+		const TextureImage& source = texture.resident;
+		const TextureImage& target = texture.pending;
+		const uint32_t levelCount = info.mipLevels - target.topMip;
+		const vk::Image targetImage = m_registry.get(target.image)->image;
+
+		vk::ImageMemoryBarrier barrier{};
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = targetImage;
+		barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1);
+		barrier.srcAccessMask = vk::AccessFlags();
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.oldLayout = vk::ImageLayout::eUndefined;
+		barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		// levels both images hold, the old image stays in eGeneral while frames keep sampling it
+		std::array<vk::ImageCopy, MAX_STREAMED_MIP_LEVELS> imageCopies{};
+		uint32_t imageCopyCount = 0;
+		if (source.image.isValid()) {
+			for (uint32_t mip = std::max(source.topMip, target.topMip); mip < info.mipLevels; ++mip) {
+				vk::ImageCopy& copy = imageCopies[imageCopyCount++];
+				copy.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mip - source.topMip, 0, 1);
+				copy.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mip - target.topMip, 0, 1);
+				copy.extent = vk::Extent3D(getMipExtent(info.width, mip), getMipExtent(info.height, mip), 1);
+			}
+		}
+		if (imageCopyCount != 0) {
+			batch.commandBuffer.copyImage(m_registry.get(source.image)->image, vk::ImageLayout::eGeneral, targetImage, vk::ImageLayout::eTransferDstOptimal,
+				vk::ArrayProxy<const vk::ImageCopy>(imageCopyCount, imageCopies.data()));
+		}
+
+		// levels the load job wrote to staging
+		std::array<vk::BufferImageCopy, MAX_STREAMED_MIP_LEVELS> bufferCopies{};
+		uint32_t bufferCopyCount = 0;
+		vk::DeviceSize offset = upload.stagingOffset;
+		for (uint32_t mip = upload.loadBegin; mip < upload.loadEnd; ++mip) {
+			const uint32_t width = getMipExtent(info.width, mip);
+			const uint32_t height = getMipExtent(info.height, mip);
+			vk::BufferImageCopy& copy = bufferCopies[bufferCopyCount++];
+			copy.bufferOffset = offset;
+			copy.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mip - target.topMip, 0, 1);
+			copy.imageExtent = vk::Extent3D(width, height, 1);
+			offset += alignUp(getMipByteSize(info.format, width, height), STAGING_ALIGNMENT);
+		}
+		if (bufferCopyCount != 0) {
+			batch.commandBuffer.copyBufferToImage(m_staging.buffer, targetImage, vk::ImageLayout::eTransferDstOptimal,
+				vk::ArrayProxy<const vk::BufferImageCopy>(bufferCopyCount, bufferCopies.data()));
+		}
+
+		// the image is only published after the batch fence signaled, so no destination stage is needed
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlags();
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eGeneral;
+		batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+
+	void TextureStreamer::abandonUpload(const Upload& upload)
+	{
+		auto& texture = m_textures[upload.id];
+		// destroyTexture() already took the pending bytes off the committed total
+		if (texture.alive) {
+			m_stats.committedBytes = m_stats.committedBytes - texture.pending.bytes + texture.resident.bytes;
+		}
+		destroyImage(texture.pending);
+		texture.hasPending = false;
+
+		if (!texture.alive) {
+			retireImage(texture.resident);
+			texture.info = StreamedTextureCreateInfo{};
+			m_freeIds.push_back(upload.id);
+		}
+	}
+
+	vk::DeviceSize TextureStreamer::getLevelBytes(const StreamedTextureCreateInfo& info, uint32_t beginMip, uint32_t endMip) const noexcept
+	{
+		vk::DeviceSize bytes = 0;
+		for (uint32_t mip = beginMip; mip < endMip; ++mip) {
+			bytes += alignUp(getMipByteSize(info.format, getMipExtent(info.width, mip), getMipExtent(info.height, mip)), STAGING_ALIGNMENT);
+		}
+		return bytes;
+	}
+
+	bool TextureStreamer::scheduleReallocation(StreamedTextureId id, uint32_t topMip, TransferBatch& batch)
+	{
+		auto& texture = m_textures[id];
+		const auto& info = texture.info;
+		const uint32_t levelCount = info.mipLevels - topMip;
+		const vk::DeviceSize bytes = getImageBytes(info, topMip);
+		// growing loads the added mips, shrinking copies everything from the resident image
+		const uint32_t loadEnd = std::max(topMip, texture.resident.topMip);
+		const vk::DeviceSize stagingBytes = getLevelBytes(info, topMip, loadEnd);
+		if (batch.stagingOffset + stagingBytes > batch.stagingBegin + m_stagingSlotSize) return false;
+
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.imageType = vk::ImageType::e2D;
+		imageCreateInfo.format = info.format;
+		imageCreateInfo.extent = vk::Extent3D(getMipExtent(info.width, topMip), getMipExtent(info.height, topMip), 1);
+		imageCreateInfo.mipLevels = levelCount;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+		imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+		// transfer source for the next residency change
+		imageCreateInfo.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+		imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+		uint32_t queueFamilyIndices[] = { m_context.getGraphicQueueFamilyIndex(), m_context.getTransferQueueFamilyIndex() };
+		if (queueFamilyIndices[0] != queueFamilyIndices[1]) {
+			imageCreateInfo.sharingMode = vk::SharingMode::eConcurrent;
+			imageCreateInfo.queueFamilyIndexCount = 2;
+			imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+		else {
+			imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+		}
+
+		VmaAllocationCreateInfo allocationCreateInfo{};
+		allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+		TextureImage image;
+		image.topMip = topMip;
+		image.bytes = bytes;
+		// allocated here rather than through the registry, running out of memory only skips the residency change
+		VkImage vkImage = VK_NULL_HANDLE;
+		VmaAllocation allocation = nullptr;
+		VkResult result = vmaCreateImage(m_context.getVmaAllocator(), &static_cast<const VkImageCreateInfo&>(imageCreateInfo),
+			&allocationCreateInfo, &vkImage, &allocation, nullptr);
+		if (result != VK_SUCCESS) {
+			spdlog::warn("Failed to allocate streamed texture {} at mip {}! Error code: {}", id, topMip, vk::to_string(vk::Result(result)));
+			return false;
+		}
+		image.image = m_registry.addImage(vkImage, allocation, imageCreateInfo);
+
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo.image = vkImage;
+		viewInfo.viewType = vk::ImageViewType::e2D;
+		viewInfo.format = info.format;
+		viewInfo.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1);
+		auto imageViewCreateResult = m_context.getDevice()->createImageViewUnique(viewInfo);
+		if (imageViewCreateResult.result != vk::Result::eSuccess) {
+			spdlog::warn("Failed to create streamed texture view! Error code: {}", vk::to_string(imageViewCreateResult.result));
+			destroyImage(image);
+			return false;
+		}
+		image.view = std::move(imageViewCreateResult.value);
+
+		Upload& upload = batch.uploads.emplace_back();
+		upload.id = id;
+		upload.loadBegin = topMip;
+		upload.loadEnd = loadEnd;
+		upload.stagingOffset = batch.stagingOffset;
+		upload.isLoaded = stagingBytes == 0;
+		if (stagingBytes != 0) {
+			// disk reads and transcoding stay off the frame thread, submitLoadedBatch() waits for them
+			m_jobSystem.executeBackground([this, &upload, &info]() {
+				vk::DeviceSize offset = upload.stagingOffset;
+				for (uint32_t mip = upload.loadBegin; mip < upload.loadEnd; ++mip) {
+					const vk::DeviceSize size = getMipByteSize(info.format, getMipExtent(info.width, mip), getMipExtent(info.height, mip));
+					if (!info.loadMip(mip, m_staging.mapped + offset, size)) {
+						spdlog::warn("Failed to load mip {} of streamed texture {}!", mip, upload.id);
+						return;
+					}
+					offset += alignUp(size, STAGING_ALIGNMENT);
+				}
+				upload.isLoaded = true;
+			}, &batch.loads);
+		}
+
+		m_stats.committedBytes = m_stats.committedBytes - texture.resident.bytes + bytes;
+		m_stats.uploadedBytesThisFrame += stagingBytes;
+		++m_stats.uploadsThisFrame;
+
+		batch.stagingOffset += stagingBytes;
+		texture.pending = std::move(image);
+		texture.hasPending = true;
+		return true;
+	}
+
+	bool TextureStreamer::evictFor(vk::DeviceSize bytesNeeded, StreamedTextureId requester, TransferBatch& batch)
+	{
+		vk::DeviceSize bytesFreed = 0;
+		for (auto iter = m_lru.rbegin(); iter != m_lru.rend() && bytesFreed < bytesNeeded; ++iter) {
+			const StreamedTextureId id = *iter;
+			auto& victim = m_textures[id];
+			if (id == requester || victim.hasPending || victim.resident.topMip >= victim.baseMip) continue;
+			// anything sampled by a frame still in flight is not a victim
+			if (victim.lastRequestedFrame + MAX_FRAMES_IN_FLIGHT >= m_frameNumber) break;
+
+			// the smaller image is a GPU copy of the remaining mips
+			const vk::DeviceSize oldBytes = victim.resident.bytes;
+			if (!scheduleReallocation(id, victim.resident.topMip + 1, batch)) break;
+			bytesFreed += oldBytes - victim.pending.bytes;
+			++m_stats.evictionsThisFrame;
+		}
+		return bytesFreed >= bytesNeeded;
+	}
+
+	void TextureStreamer::createHostBuffer(HostBuffer& hostBuffer, vk::DeviceSize size, vk::BufferUsageFlags usage)
+	{
+		vk::BufferCreateInfo bufferCreateInfo{};
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = usage;
+		bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		VmaAllocationCreateInfo allocationCreateInfo{};
+		allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+		allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT |
+			((usage & vk::BufferUsageFlagBits::eTransferSrc) ?
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VmaAllocationInfo allocationInfo{};
+		VkResult result = vmaCreateBuffer(m_context.getVmaAllocator(), &static_cast<const VkBufferCreateInfo&>(bufferCreateInfo),
+			&allocationCreateInfo, &buffer, &hostBuffer.allocation, &allocationInfo);
+		if (result != VK_SUCCESS) {
+			spdlog::error("Failed to create texture streaming buffer! Error code: {}", vk::to_string(vk::Result(result)));
+			throw std::runtime_error("Failed to create texture streaming buffer!");
+		}
+		hostBuffer.buffer = buffer;
+		hostBuffer.mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+	}
+
+	void TextureStreamer::destroyHostBuffer(HostBuffer& hostBuffer) noexcept
+	{
+		if (hostBuffer.buffer) {
+			vmaDestroyBuffer(m_context.getVmaAllocator(), hostBuffer.buffer, hostBuffer.allocation);
+		}
+		hostBuffer = HostBuffer{};
+	}
+
+	void TextureStreamer::destroyImage(TextureImage& image)
+	{
+		// only for images no submitted batch uses, the registry still defers the image itself
+		image.view.reset();
+		m_registry.destroy(image.image);
+		image = TextureImage{};
+	}
+
+	void TextureStreamer::retireImage(TextureImage& image)
+	{
+		if (!image.image.isValid()) return;
+		m_registry.retire(std::move(image.view));
+		m_registry.destroy(image.image);
+		image = TextureImage{};
+	}
+}
@@ -0,0 +1,470 @@
+#include "TextureTranscoder.h"
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COLDWIND_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define COLDWIND_TARGET_SSE41
+#else
+#define COLDWIND_TARGET_SSE41 __attribute__((target("sse4.1")))
+#endif
+#endif
+
+namespace coldwind {
+	namespace {
+		enum class BlockCodec : uint8_t {
+			None,
+			Rgba8,
+			BC1,
+			BC3
+		};
+
+		BlockCodec getBlockCodec(vk::Format format) noexcept
+		{
+			switch (format) {
+			case vk::Format::eR8G8B8A8Unorm:
+			case vk::Format::eR8G8B8A8Srgb:
+				return BlockCodec::Rgba8;
+			case vk::Format::eBc1RgbUnormBlock:
+			case vk::Format::eBc1RgbSrgbBlock:
+			case vk::Format::eBc1RgbaUnormBlock:
+			case vk::Format::eBc1RgbaSrgbBlock:
+				return BlockCodec::BC1;
+			case vk::Format::eBc3UnormBlock:
+			case vk::Format::eBc3SrgbBlock:
+				return BlockCodec::BC3;
+			default:
+				return BlockCodec::None;
+			}
+		}
+
+		bool isSrgbFormat(vk::Format format) noexcept
+		{
+			return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eBc1RgbSrgbBlock ||
+				format == vk::Format::eBc1RgbaSrgbBlock || format == vk::Format::eBc3SrgbBlock;
+		}
+
+		/// pixels are packed as r | g << 8 | b << 16 | a << 24
+
+		inline uint16_t toRgb565(uint32_t color) noexcept
+		{
+			const uint32_t r = color & 0xFF;
+			const uint32_t g = (color >> 8) & 0xFF;
+			const uint32_t b = (color >> 16) & 0xFF;
+			return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+		}
+
+		inline uint32_t fromRgb565(uint16_t color) noexcept
+		{
+			const uint32_t r = (color >> 11) & 31;
+			const uint32_t g = (color >> 5) & 63;
+			const uint32_t b = color & 31;
+			return ((r << 3) | (r >> 2)) | ((g << 2) | (g >> 4)) << 8 | ((b << 3) | (b >> 2)) << 16 | 0xFF000000u;
+		}
+
+		inline uint32_t blendColor(uint32_t a, uint32_t b, uint32_t weightA, uint32_t weightB, uint32_t divisor) noexcept
+		{
+			uint32_t result = 0xFF000000u;
+			for (uint32_t shift = 0; shift < 24; shift += 8) {
+				const uint32_t channel = (((a >> shift) & 0xFF) * weightA + ((b >> shift) & 0xFF) * weightB) / divisor;
+				result |= channel << shift;
+			}
+			return result;
+		}
+
+		struct ColorEndpoints {
+			uint16_t color0 = 0;
+			uint16_t color1 = 0;
+			uint32_t palette[4] = {};
+		};
+
+		void computeColorEndpoints(uint32_t minColor, uint32_t maxColor, ColorEndpoints& endpoints) noexcept
+		{
+			// inset the bounding box by 1/16 of its extent, the extremes are usually outliers
+			uint32_t insetMin = 0;
+			uint32_t insetMax = 0;
+			for (uint32_t shift = 0; shift < 24; shift += 8) {
+				const uint32_t low = (minColor >> shift) & 0xFF;
+				const uint32_t high = (maxColor >> shift) & 0xFF;
+				const uint32_t inset = (high - low) >> 4;
+				insetMin |= (low + inset) << shift;
+				insetMax |= (high - inset) << shift;
+			}
+
+			endpoints.color0 = toRgb565(insetMax);
+			endpoints.color1 = toRgb565(insetMin);
+			if (endpoints.color0 < endpoints.color1) std::swap(endpoints.color0, endpoints.color1);
+
+			endpoints.palette[0] = fromRgb565(endpoints.color0);
+			endpoints.palette[1] = fromRgb565(endpoints.color1);
+			endpoints.palette[2] = blendColor(endpoints.palette[0], endpoints.palette[1], 2, 1, 3);
+			endpoints.palette[3] = blendColor(endpoints.palette[0], endpoints.palette[1], 1, 2, 3);
+		}
+
+		inline uint32_t colorDistance(uint32_t a, uint32_t b) noexcept
+		{
+			uint32_t distance = 0;
+			for (uint32_t shift = 0; shift < 24; shift += 8) {
+				const int delta = static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF);
+				distance += static_cast<uint32_t>(delta < 0 ? -delta : delta);
+			}
+			return distance;
+		}
+
+		void computeColorBoundsScalar(const uint32_t pixels[16], uint32_t& minColor, uint32_t& maxColor) noexcept
+		{
+			uint8_t low[4] = { 255, 255, 255, 255 };
+			uint8_t high[4] = { 0, 0, 0, 0 };
+			for (uint32_t i = 0; i < 16; ++i) {
+				for (uint32_t channel = 0; channel < 4; ++channel) {
+					const uint8_t value = static_cast<uint8_t>(pixels[i] >> (channel * 8));
+					low[channel] = std::min(low[channel], value);
+					high[channel] = std::max(high[channel], value);
+				}
+			}
+			std::memcpy(&minColor, low, 4);
+			std::memcpy(&maxColor, high, 4);
+		}
+
+		uint32_t computeColorIndicesScalar(const uint32_t pixels[16], const uint32_t palette[4]) noexcept
+		{
+			uint32_t indices = 0;
+			for (uint32_t i = 0; i < 16; ++i) {
+				uint32_t bestIndex = 0;
+				uint32_t bestDistance = colorDistance(pixels[i], palette[0]);
+				for (uint32_t k = 1; k < 4; ++k) {
+					const uint32_t distance = colorDistance(pixels[i], palette[k]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = k;
+					}
+				}
+				indices |= bestIndex << (i * 2);
+			}
+			return indices;
+		}
+
+#ifdef COLDWIND_X86
+		COLDWIND_TARGET_SSE41 void computeColorBoundsSSE41(const uint32_t pixels[16], uint32_t& minColor, uint32_t& maxColor) noexcept
+		{
+			const __m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+			const __m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 4));
+			const __m128i row2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 8));
+			const __m128i row3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 12));
+
+			__m128i low = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+			__m128i high = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+			low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+			low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+			high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+			high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+
+			minColor = static_cast<uint32_t>(_mm_cvtsi128_si32(low));
+			maxColor = static_cast<uint32_t>(_mm_cvtsi128_si32(high));
+		}
+
+		// sum of absolute rgb differences of 4 pixels against one palette entry
+		COLDWIND_TARGET_SSE41 inline __m128i colorDistanceSSE41(__m128i pixels, __m128i color) noexcept
+		{
+			const __m128i difference = _mm_and_si128(
+				_mm_or_si128(_mm_subs_epu8(pixels, color), _mm_subs_epu8(color, pixels)),
+				_mm_set1_epi32(0x00FFFFFF));
+			const __m128i pairs = _mm_maddubs_epi16(difference, _mm_set1_epi8(1));
+			return _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+		}
+
+		COLDWIND_TARGET_SSE41 uint32_t computeColorIndicesSSE41(const uint32_t pixels[16], const uint32_t palette[4]) noexcept
+		{
+			const __m128i color0 = _mm_set1_epi32(static_cast<int>(palette[0]));
+			const __m128i color1 = _mm_set1_epi32(static_cast<int>(palette[1]));
+			const __m128i color2 = _mm_set1_epi32(static_cast<int>(palette[2]));
+			const __m128i color3 = _mm_set1_epi32(static_cast<int>(palette[3]));
+			const __m128i indexWeights = _mm_setr_epi32(1, 4, 16, 64);
+
+			uint32_t indices = 0;
+			for (uint32_t row = 0; row < 4; ++row) {
+				const __m128i rowPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + row * 4));
+
+				// strict less than keeps the lowest index on ties, matching the scalar kernel
+				__m128i bestDistance = colorDistanceSSE41(rowPixels, color0);
+				__m128i bestIndex = _mm_setzero_si128();
+				__m128i distance = colorDistanceSSE41(rowPixels, color1);
+				bestIndex = _mm_blendv_epi8(bestIndex, _mm_set1_epi32(1), _mm_cmplt_epi32(distance, bestDistance));
+				bestDistance = _mm_min_epi32(distance, bestDistance);
+				distance = colorDistanceSSE41(rowPixels, color2);
+				bestIndex = _mm_blendv_epi8(bestIndex, _mm_set1_epi32(2), _mm_cmplt_epi32(distance, bestDistance));
+				bestDistance = _mm_min_epi32(distance, bestDistance);
+				distance = colorDistanceSSE41(rowPixels, color3);
+				bestIndex = _mm_blendv_epi8(bestIndex, _mm_set1_epi32(3), _mm_cmplt_epi32(distance, bestDistance));
+
+				// pack the four 2 bit indices of the row into one byte
+				__m128i packed = _mm_mullo_epi32(bestIndex, indexWeights);
+				packed = _mm_add_epi32(packed, _mm_shuffle_epi32(packed, _MM_SHUFFLE(2, 3, 0, 1)));
+				packed = _mm_add_epi32(packed, _mm_shuffle_epi32(packed, _MM_SHUFFLE(1, 0, 3, 2)));
+				indices |= static_cast<uint32_t>(_mm_cvtsi128_si32(packed)) << (row * 8);
+			}
+			return indices;
+		}
+#endif
+
+		void writeColorBlock(const uint32_t pixels[16], uint32_t minColor, uint32_t maxColor, bool simd, uint8_t* out) noexcept
+		{
+			ColorEndpoints endpoints;
+			computeColorEndpoints(minColor, maxColor, endpoints);
+
+			uint32_t indices = 0;
+			// equal endpoints would select the 3 color mode of BC1, index 0 is exact anyway
+			if (endpoints.color0 != endpoints.color1) {
+#ifdef COLDWIND_X86
+				indices = simd ? computeColorIndicesSSE41(pixels, endpoints.palette) : computeColorIndicesScalar(pixels, endpoints.palette);
+#else
+				indices = computeColorIndicesScalar(pixels, endpoints.palette);
+#endif
+			}
+
+			out[0] = static_cast<uint8_t>(endpoints.color0);
+			out[1] = static_cast<uint8_t>(endpoints.color0 >> 8);
+			out[2] = static_cast<uint8_t>(endpoints.color1);
+			out[3] = static_cast<uint8_t>(endpoints.color1 >> 8);
+			std::memcpy(out + 4, &indices, 4);
+		}
+
+		void writeAlphaBlock(const uint32_t pixels[16], uint8_t minAlpha, uint8_t maxAlpha, uint8_t* out) noexcept
+		{
+			out[0] = maxAlpha;
+			out[1] = minAlpha;
+
+			// 8 value mode, index 0 is alpha0, 1 is alpha1, 2..7 interpolate from alpha0 towards alpha1
+			uint64_t indices = 0;
+			if (maxAlpha > minAlpha) {
+				const uint32_t range = maxAlpha - minAlpha;
+				for (uint32_t i = 0; i < 16; ++i) {
+					const uint32_t alpha = pixels[i] >> 24;
+					const uint32_t step = ((alpha - minAlpha) * 7 + range / 2) / range;
+					const uint64_t index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+					indices |= index << (i * 3);
+				}
+			}
+			for (uint32_t i = 0; i < 6; ++i) {
+				out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+			}
+		}
+
+		void encodeBlock(const uint32_t pixels[16], BlockCodec codec, bool simd, uint8_t* out) noexcept
+		{
+			uint32_t minColor = 0;
+			uint32_t maxColor = 0;
+#ifdef COLDWIND_X86
+			if (simd) computeColorBoundsSSE41(pixels, minColor, maxColor);
+			else computeColorBoundsScalar(pixels, minColor, maxColor);
+#else
+			computeColorBoundsScalar(pixels, minColor, maxColor);
+#endif
+
+			if (codec == BlockCodec::BC3) {
+				writeAlphaBlock(pixels, static_cast<uint8_t>(minColor >> 24), static_cast<uint8_t>(maxColor >> 24), out);
+				out += 8;
+			}
+			writeColorBlock(pixels, minColor, maxColor, simd, out);
+		}
+
+		void decodeColorBlock(const uint8_t* block, bool forceFourColor, uint32_t pixels[16]) noexcept
+		{
+			const uint16_t color0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+			const uint16_t color1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+			uint32_t palette[4];
+			palette[0] = fromRgb565(color0);
+			palette[1] = fromRgb565(color1);
+			if (color0 > color1 || forceFourColor) {
+				palette[2] = blendColor(palette[0], palette[1], 2, 1, 3);
+				palette[3] = blendColor(palette[0], palette[1], 1, 2, 3);
+			}
+			else {
+				palette[2] = blendColor(palette[0], palette[1], 1, 1, 2);
+				palette[3] = 0;
+			}
+
+			uint32_t indices;
+			std::memcpy(&indices, block + 4, 4);
+			for (uint32_t i = 0; i < 16; ++i) {
+				pixels[i] = palette[(indices >> (i * 2)) & 3];
+			}
+		}
+
+		void decodeAlphaBlock(const uint8_t* block, uint32_t pixels[16]) noexcept
+		{
+			const uint32_t alpha0 = block[0];
+			const uint32_t alpha1 = block[1];
+			uint32_t palette[8] = { alpha0, alpha1 };
+			if (alpha0 > alpha1) {
+				for (uint32_t k = 2; k < 8; ++k) palette[k] = ((8 - k) * alpha0 + (k - 1) * alpha1) / 7;
+			}
+			else {
+				for (uint32_t k = 2; k < 6; ++k) palette[k] = ((6 - k) * alpha0 + (k - 1) * alpha1) / 5;
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 6; ++i) indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+			for (uint32_t i = 0; i < 16; ++i) {
+				pixels[i] = (pixels[i] & 0x00FFFFFFu) | palette[(indices >> (i * 3)) & 7] << 24;
+			}
+		}
+
+		void decodeBlock(const uint8_t* block, BlockCodec codec, uint32_t pixels[16]) noexcept
+		{
+			if (codec == BlockCodec::BC3) {
+				decodeColorBlock(block + 8, true, pixels);
+				decodeAlphaBlock(block, pixels);
+			}
+			else {
+				decodeColorBlock(block, false, pixels);
+			}
+		}
+
+		void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint32_t pixels[16]) noexcept
+		{
+			// edge blocks repeat the last row/column
+			for (uint32_t y = 0; y < 4; ++y) {
+				const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x) {
+					const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+					std::memcpy(&pixels[y * 4 + x], rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+				}
+			}
+		}
+
+		void storeBlock(const uint32_t pixels[16], uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* rgba) noexcept
+		{
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x) {
+					std::memcpy(rgba + (static_cast<size_t>(blockY * 4 + y) * width + blockX * 4 + x) * 4, &pixels[y * 4 + x], 4);
+				}
+			}
+		}
+
+		bool cpuSupportsSSE41() noexcept
+		{
+#if defined(COLDWIND_X86) && defined(_MSC_VER)
+			int cpuInfo[4];
+			__cpuid(cpuInfo, 1);
+			return (cpuInfo[2] & (1 << 19)) != 0;
+#elif defined(COLDWIND_X86)
+			return __builtin_cpu_supports("sse4.1");
+#else
+			return false;
+#endif
+		}
+	}
+
+	TextureTranscoder::TextureTranscoder(JobSystem& jobSystem)
+		: m_jobSystem(jobSystem), m_simdEnabled(isSimdSupported())
+	{
+		spdlog::debug("Texture transcoder SIMD kernels: {}", m_simdEnabled ? "SSE4.1" : "disabled");
+	}
+
+	vk::Format TextureTranscoder::selectTargetFormat(vk::PhysicalDevice physicalDevice, vk::Format sourceFormat, bool hasAlpha)
+	{
+		const auto isSampleable = [physicalDevice](vk::Format format) {
+			const auto features = physicalDevice.getFormatProperties(format).optimalTilingFeatures;
+			return (features & vk::FormatFeatureFlagBits::eSampledImage) && (features & vk::FormatFeatureFlagBits::eTransferDst);
+		};
+
+		const bool srgb = isSrgbFormat(sourceFormat);
+		const vk::Format rgba8 = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+		const vk::Format bc1 = srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+		const vk::Format bc3 = srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+
+		switch (getBlockCodec(sourceFormat)) {
+		case BlockCodec::Rgba8:
+			if (!hasAlpha && isSampleable(bc1)) return bc1;
+			if (isSampleable(bc3)) return bc3;
+			return isSampleable(rgba8) ? rgba8 : vk::Format::eUndefined;
+		case BlockCodec::BC1:
+		case BlockCodec::BC3:
+			if (isSampleable(sourceFormat)) return sourceFormat;
+			return isSampleable(rgba8) ? rgba8 : vk::Format::eUndefined;
+		default:
+			return isSampleable(sourceFormat) ? sourceFormat : vk::Format::eUndefined;
+		}
+	}
+
+	bool TextureTranscoder::canTranscode(vk::Format sourceFormat, vk::Format targetFormat) noexcept
+	{
+		if (sourceFormat == targetFormat) return true;
+		if (isSrgbFormat(sourceFormat) != isSrgbFormat(targetFormat)) return false;
+
+		const BlockCodec source = getBlockCodec(sourceFormat);
+		const BlockCodec target = getBlockCodec(targetFormat);
+		if (source == BlockCodec::None || target == BlockCodec::None) return false;
+		return source == BlockCodec::Rgba8 || target == BlockCodec::Rgba8;
+	}
+
+	bool TextureTranscoder::hasAlpha(const uint8_t* rgba, size_t pixelCount) noexcept
+	{
+		for (size_t i = 0; i < pixelCount; ++i) {
+			if (rgba[i * 4 + 3] != 255) return true;
+		}
+		return false;
+	}
+
+	bool TextureTranscoder::isSimdSupported() noexcept
+	{
+		static const bool supported = cpuSupportsSSE41();
+		return supported;
+	}
+
+	bool TextureTranscoder::transcode(const uint8_t* src, vk::Format sourceFormat, uint8_t* dst, vk::Format targetFormat,
+		uint32_t width, uint32_t height)
+	{
+		if (!canTranscode(sourceFormat, targetFormat)) {
+			spdlog::warn("Can not transcode texture from {} to {}!", vk::to_string(sourceFormat), vk::to_string(targetFormat));
+			return false;
+		}
+		if (sourceFormat == targetFormat) {
+			std::memcpy(dst, src, getMipByteSize(sourceFormat, width, height));
+			return true;
+		}
+
+		const BlockCodec source = getBlockCodec(sourceFormat);
+		const BlockCodec target = getBlockCodec(targetFormat);
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+		const bool simd = m_simdEnabled;
+		const uint32_t rowsPerJob = std::max(1u, 4096u / blocksX);
+
+		if (source == BlockCodec::Rgba8) {
+			const uint32_t blockBytes = getFormatBlockInfo(targetFormat).blockBytes;
+			m_jobSystem.parallelFor(blocksY, rowsPerJob, [=](uint32_t begin, uint32_t end) {
+				uint32_t pixels[16];
+				for (uint32_t blockY = begin; blockY < end; ++blockY) {
+					uint8_t* out = dst + static_cast<size_t>(blockY) * blocksX * blockBytes;
+					for (uint32_t blockX = 0; blockX < blocksX; ++blockX, out += blockBytes) {
+						loadBlock(src, width, height, blockX, blockY, pixels);
+						encodeBlock(pixels, target, simd, out);
+					}
+				}
+			});
+		}
+		else {
+			const uint32_t blockBytes = getFormatBlockInfo(sourceFormat).blockBytes;
+			m_jobSystem.parallelFor(blocksY, rowsPerJob, [=](uint32_t begin, uint32_t end) {
+				uint32_t pixels[16];
+				for (uint32_t blockY = begin; blockY < end; ++blockY) {
+					const uint8_t* block = src + static_cast<size_t>(blockY) * blocksX * blockBytes;
+					for (uint32_t blockX = 0; blockX < blocksX; ++blockX, block += blockBytes) {
+						decodeBlock(block, source, pixels);
+						storeBlock(pixels, width, height, blockX, blockY, dst);
+					}
+				}
+			});
+		}
+		return true;
+	}
+}
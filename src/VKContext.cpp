@@ -1,14 +1,143 @@
 ﻿#define VMA_IMPLEMENTATION
 #include "VKContext.h"
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <stdexcept>
 #include <set>
+#include <string>
 
 namespace coldwind
 {
+	namespace {
+		// every feature struct the negotiation knows, linked into one pNext chain
+		struct FeatureChain {
+			vk::PhysicalDeviceFeatures2 features;
+			vk::PhysicalDeviceVulkan11Features vulkan11;
+			vk::PhysicalDeviceVulkan12Features vulkan12;
+			vk::PhysicalDeviceVulkan13Features vulkan13;
+			// through VK_KHR_synchronization2 and VK_KHR_dynamic_rendering on 1.2 devices
+			vk::PhysicalDeviceSynchronization2Features synchronization2;
+			vk::PhysicalDeviceDynamicRenderingFeatures dynamicRendering;
+			// through VK_KHR_timeline_semaphore, VK_EXT_descriptor_indexing and VK_KHR_buffer_device_address on 1.1 devices
+			vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore;
+			vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexing;
+			vk::PhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddress;
+			vk::PhysicalDeviceMemoryPriorityFeaturesEXT memoryPriority;
+			vk::PhysicalDevicePageableDeviceLocalMemoryFeaturesEXT pageableDeviceLocalMemory;
+
+			FeatureChain() = default;
+			FeatureChain(const FeatureChain&) = delete;
+			FeatureChain& operator=(const FeatureChain&) = delete;
+
+			// links only the structs the device's version and extensions define
+			void link(uint32_t apiVersion, const std::set<std::string>& extensions)
+			{
+				void** next = &features.pNext;
+				const auto append = [&next](auto& feature) {
+					feature.pNext = nullptr;
+					*next = &feature;
+					next = &feature.pNext;
+				};
+				if (apiVersion >= VK_API_VERSION_1_2) {
+					append(vulkan11);
+					append(vulkan12);
+				}
+				else {
+					if (extensions.contains(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) append(timelineSemaphore);
+					if (extensions.contains(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) append(descriptorIndexing);
+					if (extensions.contains(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)) append(bufferDeviceAddress);
+				}
+				if (apiVersion >= VK_API_VERSION_1_3) {
+					append(vulkan13);
+				}
+				else {
+					if (extensions.contains(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) append(synchronization2);
+					if (extensions.contains(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) append(dynamicRendering);
+				}
+				if (extensions.contains(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME)) append(memoryPriority);
+				if (extensions.contains(VK_EXT_PAGEABLE_DEVICE_LOCAL_MEMORY_EXTENSION_NAME)) append(pageableDeviceLocalMemory);
+			}
+		};
+
+		std::set<std::string> getDeviceExtensions(vk::PhysicalDevice physicalDevice)
+		{
+			auto [result, extensionProperties] = physicalDevice.enumerateDeviceExtensionProperties();
+			if (result != vk::Result::eSuccess) {
+				spdlog::error("Failed to enumerate physical device extension properties! Error code: {}", vk::to_string(result));
+				throw std::runtime_error("Failed to enumerate physical device extension properties!");
+			}
+			std::set<std::string> extensions;
+			for (const auto& extension : extensionProperties) {
+				extensions.emplace(extension.extensionName.data());
+			}
+			return extensions;
+		}
+
+		DeviceCapabilities getCapabilities(const FeatureChain& supported, uint32_t apiVersion, const std::set<std::string>& extensions)
+		{
+			const auto& vulkan12 = supported.vulkan12;
+			DeviceCapabilities capabilities;
+			capabilities.apiVersion = apiVersion;
+			if (apiVersion >= VK_API_VERSION_1_2) {
+				capabilities.timelineSemaphore = vulkan12.timelineSemaphore;
+				capabilities.bufferDeviceAddress = vulkan12.bufferDeviceAddress;
+				capabilities.descriptorIndexing = vulkan12.descriptorIndexing && vulkan12.runtimeDescriptorArray &&
+					vulkan12.descriptorBindingPartiallyBound && vulkan12.descriptorBindingVariableDescriptorCount &&
+					vulkan12.descriptorBindingSampledImageUpdateAfterBind && vulkan12.shaderSampledImageArrayNonUniformIndexing;
+			}
+			else {
+				// structs of missing extensions are not linked and keep their false defaults
+				const auto& descriptorIndexing = supported.descriptorIndexing;
+				capabilities.timelineSemaphore = supported.timelineSemaphore.timelineSemaphore;
+				capabilities.bufferDeviceAddress = supported.bufferDeviceAddress.bufferDeviceAddress;
+				capabilities.descriptorIndexing = descriptorIndexing.runtimeDescriptorArray &&
+					descriptorIndexing.descriptorBindingPartiallyBound && descriptorIndexing.descriptorBindingVariableDescriptorCount &&
+					descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind && descriptorIndexing.shaderSampledImageArrayNonUniformIndexing;
+			}
+			if (apiVersion >= VK_API_VERSION_1_3) {
+				capabilities.synchronization2 = supported.vulkan13.synchronization2;
+				capabilities.dynamicRendering = supported.vulkan13.dynamicRendering;
+			}
+			else {
+				capabilities.synchronization2 = supported.synchronization2.synchronization2;
+				capabilities.dynamicRendering = supported.dynamicRendering.dynamicRendering;
+			}
+			capabilities.memoryBudget = extensions.contains(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			capabilities.memoryPriority = supported.memoryPriority.memoryPriority;
+			capabilities.pageableDeviceLocalMemory = capabilities.memoryPriority && supported.pageableDeviceLocalMemory.pageableDeviceLocalMemory;
+			capabilities.samplerAnisotropy = supported.features.features.samplerAnisotropy;
+			return capabilities;
+		}
+
+		std::vector<const char*> getEnabledExtensions(const DeviceCapabilities& capabilities, bool isWindowed)
+		{
+			std::vector<const char*> extensions;
+			if (isWindowed) extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+			if (capabilities.memoryBudget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			if (capabilities.memoryPriority) extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+			if (capabilities.pageableDeviceLocalMemory) extensions.push_back(VK_EXT_PAGEABLE_DEVICE_LOCAL_MEMORY_EXTENSION_NAME);
+			if (capabilities.apiVersion < VK_API_VERSION_1_3) {
+				if (capabilities.synchronization2) extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+				if (capabilities.dynamicRendering) extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+			}
+			if (capabilities.apiVersion < VK_API_VERSION_1_2) {
+				if (capabilities.timelineSemaphore) extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+				if (capabilities.descriptorIndexing) extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+				if (capabilities.bufferDeviceAddress) extensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+			}
+			return extensions;
+		}
+	}
+
 	VKContext::VKContext(Instance& instance, Window& window)
 	{
-		init(instance, window);
+		init(instance, &window);
+	}
+
+	VKContext::VKContext(Instance& instance)
+		: m_isHeadless(true)
+	{
+		init(instance, nullptr);
 	}
 
 	VKContext::~VKContext()
@@ -16,7 +145,7 @@ namespace coldwind
 		vmaDestroyAllocator(m_vmaAllocator);
 	}
 
-	void VKContext::selectPhysicalDevice(Instance& instance, Window& window)
+	void VKContext::selectPhysicalDevice(Instance& instance, Window* window)
 	{
 		auto [result, physicalDeviceList] = instance.getVKInstance()->enumeratePhysicalDevices();
 		if (result == vk::Result::eSuccess) {
@@ -30,15 +159,14 @@ namespace coldwind
 			throw std::runtime_error("Failed to enumerate physical devices!");
 		}
 
-		std::map<const char*, uint8_t> requiredDeviceExtensions;
-		requiredDeviceExtensions.emplace(VK_KHR_SWAPCHAIN_EXTENSION_NAME, static_cast<uint8_t>(RequirementType::Required));
-
-		std::vector<const char*> deviceExtensions;
 		struct PhysicalDeviceAndQueueFamilyIndex {
 			vk::PhysicalDevice physicalDevice;
 			std::optional<uint32_t> graphicsQueue;
 			std::optional<uint32_t> presentQueue;
+			std::optional<uint32_t> transferQueue;
 			vk::PhysicalDeviceProperties  physicalDeviceProperties;
+			DeviceCapabilities capabilities;
+			std::vector<const char*> extensions;
 		};
 
 		std::multimap<uint64_t, PhysicalDeviceAndQueueFamilyIndex, std::greater<uint64_t>> usableDevices;
@@ -52,52 +180,48 @@ namespace coldwind
 			spdlog::debug("Device driver version: {}", physicalDeviceProperties.driverVersion);
 			spdlog::debug("Supported newest API version: {}.{}.{}", 
 				VK_VERSION_MAJOR(physicalDeviceProperties.apiVersion), VK_VERSION_MINOR(physicalDeviceProperties.apiVersion), VK_VERSION_PATCH(physicalDeviceProperties.apiVersion));
-			size_t score = getDeviceScore(physicalDeviceProperties);
-
-			/// check device extension support
-			std::map<const char*, uint8_t> deviceExtensionsMap = requiredDeviceExtensions;
-			checkDeviceExtensionSupport(physicalDevice, deviceExtensionsMap);
-			deviceExtensions.clear();
-			bool usable = true;
-			for (const auto& [extension, stats] : deviceExtensionsMap) {
-				if ((stats & static_cast<uint8_t>(SupportStatus::Supported)) != static_cast<uint8_t>(SupportStatus::Supported)) {
-					if ((stats & static_cast<uint8_t>(RequirementType::Optional)) == static_cast<uint8_t>(RequirementType::Optional)) {
-						spdlog::debug("\tOptional device extension {} not support!", extension);
-					}
-					else {
-						spdlog::warn("\tRequired device extension {} not support!", extension);
-						usable = false;
-					}
-				}
-				else {
-					deviceExtensions.push_back(extension);
-				}
-			}
-			if (!usable) continue;
-
-			auto& surface = window.getSurface();
-			const auto formats = physicalDevice.getSurfaceFormatsKHR(surface.get());
-			if (formats.result != vk::Result::eSuccess) {
-				spdlog::warn("\tFailed to get surface formats! Error code: {}", vk::to_string(formats.result));
+			// PhysicalDeviceFeatures2 is core since 1.1
+			if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_1) {
+				spdlog::warn("\tDevice only supports Vulkan 1.0!");
 				continue;
 			}
-			if (formats.value.empty()) {
-				spdlog::warn("\tSurface format is empty!");
+
+			/// check device extension support
+			const auto availableExtensions = getDeviceExtensions(physicalDevice);
+			if (window != nullptr && !availableExtensions.contains(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+				spdlog::warn("\tRequired device extension {} not support!", VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 				continue;
 			}
 
-			const auto presentMode = physicalDevice.getSurfacePresentModesKHR(surface.get());
-			if (presentMode.result != vk::Result::eSuccess) {
-				spdlog::warn("\tFailed to get surface present modes! Error code: {}", vk::to_string(presentMode.result));
-				continue;
-			} 
-			if (presentMode.value.empty()) {
-				spdlog::warn("\tSurface present mode is empty!");
-				continue;
+			if (window != nullptr) {
+				auto& surface = window->getSurface();
+				const auto formats = physicalDevice.getSurfaceFormatsKHR(surface.get());
+				if (formats.result != vk::Result::eSuccess) {
+					spdlog::warn("\tFailed to get surface formats! Error code: {}", vk::to_string(formats.result));
+					continue;
+				}
+				if (formats.value.empty()) {
+					spdlog::warn("\tSurface format is empty!");
+					continue;
+				}
+
+				const auto presentMode = physicalDevice.getSurfacePresentModesKHR(surface.get());
+				if (presentMode.result != vk::Result::eSuccess) {
+					spdlog::warn("\tFailed to get surface present modes! Error code: {}", vk::to_string(presentMode.result));
+					continue;
+				} 
+				if (presentMode.value.empty()) {
+					spdlog::warn("\tSurface present mode is empty!");
+					continue;
+				}
 			}
 
-			/// check device feature support
-			auto physicalDeviceFeatures = physicalDevice.getFeatures();
+			/// check device feature support, the whole chain the device's version and extensions define
+			const uint32_t apiVersion = std::min(physicalDeviceProperties.apiVersion, USING_VK_API_VERSION);
+			FeatureChain supportedFeatures;
+			supportedFeatures.link(apiVersion, availableExtensions);
+			physicalDevice.getFeatures2(&supportedFeatures.features);
+			const auto& physicalDeviceFeatures = supportedFeatures.features.features;
 
 			// required feature
 			if (physicalDeviceFeatures.geometryShader != VK_TRUE) {
@@ -117,24 +241,40 @@ namespace coldwind
 			PhysicalDeviceAndQueueFamilyIndex physicalDeviceAndQueueFamily{};
 			physicalDeviceAndQueueFamily.physicalDevice = physicalDevice;
 			physicalDeviceAndQueueFamily.physicalDeviceProperties = physicalDeviceProperties;
+			physicalDeviceAndQueueFamily.capabilities = getCapabilities(supportedFeatures, apiVersion, availableExtensions);
+			physicalDeviceAndQueueFamily.extensions = getEnabledExtensions(physicalDeviceAndQueueFamily.capabilities, window != nullptr);
 
 			const auto queueFamilyProperties = physicalDevice.getQueueFamilyProperties();
 			for (size_t i = 0, queueFamilyCount = queueFamilyProperties.size(); i < queueFamilyCount; ++i) {
-				if (queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) {
-					physicalDeviceAndQueueFamily.graphicsQueue = i;
-				}
-				auto presentSupport = physicalDevice.getSurfaceSupportKHR(i, surface.get());
-				if (presentSupport.result == vk::Result::eSuccess && presentSupport.value == VK_TRUE) {
-					physicalDeviceAndQueueFamily.presentQueue = i;
+				if (!physicalDeviceAndQueueFamily.graphicsQueue.has_value() ||
+					!physicalDeviceAndQueueFamily.presentQueue.has_value()) {
+					if (queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) {
+						physicalDeviceAndQueueFamily.graphicsQueue = i;
+						if (window == nullptr) physicalDeviceAndQueueFamily.presentQueue = i;
+					}
+					if (window != nullptr) {
+						auto presentSupport = physicalDevice.getSurfaceSupportKHR(i, window->getSurface().get());
+						if (presentSupport.result == vk::Result::eSuccess && presentSupport.value == VK_TRUE) {
+							physicalDeviceAndQueueFamily.presentQueue = i;
+						}
+					}
 				}
-				if (physicalDeviceAndQueueFamily.graphicsQueue.has_value() &&
-					physicalDeviceAndQueueFamily.presentQueue.has_value()) {
-					break;
+				// prefer a dedicated transfer family (DMA engine) for streaming uploads
+				const auto queueFlags = queueFamilyProperties[i].queueFlags;
+				if ((queueFlags & vk::QueueFlagBits::eTransfer) &&
+					!(queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+					physicalDeviceAndQueueFamily.transferQueue = i;
 				}
 			}
+			if (!physicalDeviceAndQueueFamily.transferQueue.has_value()) {
+				physicalDeviceAndQueueFamily.transferQueue = physicalDeviceAndQueueFamily.graphicsQueue;
+			}
 
 			if (physicalDeviceAndQueueFamily.graphicsQueue.has_value() &&
 				physicalDeviceAndQueueFamily.presentQueue.has_value()) {
+				const uint64_t score = getDeviceScore(physicalDeviceProperties, physicalDeviceAndQueueFamily.capabilities,
+					physicalDevice.getMemoryProperties());
+				spdlog::debug("\tDevice score: {}", score);
 				usableDevices.emplace(score, physicalDeviceAndQueueFamily);
 			}
 		}
@@ -147,6 +287,9 @@ namespace coldwind
 		m_physicalDevice = usableDevices.begin()->second.physicalDevice;
 		m_graphicsAndComputeQueueFamilyIndex = usableDevices.begin()->second.graphicsQueue.value();
 		m_presentQueueFamilyIndex = usableDevices.begin()->second.presentQueue.value();
+		m_transferQueueFamilyIndex = usableDevices.begin()->second.transferQueue.value();
+		m_capabilities = usableDevices.begin()->second.capabilities;
+		m_deviceExtensions = usableDevices.begin()->second.extensions;
 		const auto& physicalDeviceProperties = usableDevices.begin()->second.physicalDeviceProperties;
 
 		spdlog::info("Using device {}: {}, made by vendor {}",
@@ -154,38 +297,42 @@ namespace coldwind
 			physicalDeviceProperties.deviceName.data(),
 			physicalDeviceProperties.vendorID
 		);
+		spdlog::info("Queue family index, graphics: {}, present: {}, transfer: {}",
+			m_graphicsAndComputeQueueFamilyIndex, m_presentQueueFamilyIndex, m_transferQueueFamilyIndex);
+		spdlog::info("Vulkan {}.{}, timeline semaphores: {}, synchronization2: {}, dynamic rendering: {}, buffer device address: {}, "
+			"descriptor indexing: {}, memory budget: {}, memory priority: {}, pageable device local memory: {}",
+			VK_VERSION_MAJOR(m_capabilities.apiVersion), VK_VERSION_MINOR(m_capabilities.apiVersion), m_capabilities.timelineSemaphore,
+			m_capabilities.synchronization2, m_capabilities.dynamicRendering, m_capabilities.bufferDeviceAddress,
+			m_capabilities.descriptorIndexing, m_capabilities.memoryBudget, m_capabilities.memoryPriority, m_capabilities.pageableDeviceLocalMemory);
 	}
 
-	void VKContext::checkDeviceExtensionSupport(vk::PhysicalDevice physicalDevice, std::map<const char*, uint8_t>& requiredDeviceExtensions)
-	{
-		auto [result, physicalDeviceExtensionProperties] = physicalDevice.enumerateDeviceExtensionProperties();
-		if (result == vk::Result::eSuccess) {
-			for (const auto& supportExtension : physicalDeviceExtensionProperties) {
-				auto iter = requiredDeviceExtensions.find(supportExtension.extensionName);
-				if (iter != requiredDeviceExtensions.end()) {
-					iter->second |= static_cast<uint8_t>(SupportStatus::Supported);
-					spdlog::debug("Found supported extension {}!", supportExtension.extensionName.data());
-				}
-			}
-		}
-		else {
-			spdlog::error("Failed to enumerate physical device extension properties! Error code: {}", vk::to_string(result));
-			throw std::runtime_error("Failed to enumerate physical device extension properties!");
-		}
-	}
-
-	uint64_t VKContext::getDeviceScore(const vk::PhysicalDeviceProperties& deviceProperties) const noexcept
+	uint64_t VKContext::getDeviceScore(const vk::PhysicalDeviceProperties& deviceProperties, const DeviceCapabilities& capabilities,
+		const vk::PhysicalDeviceMemoryProperties& memoryProperties) const noexcept
 	{
+		// device type dominates, capabilities and memory break ties between devices of one type
 		uint64_t score = 0;
-		if (deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) score += 1600;
-		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eIntegratedGpu) score += 800;
-		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eVirtualGpu) score += 400;
-		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eCpu) score += 200;
-		else score += 100;
+		if (deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) score += 10000;
+		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eIntegratedGpu) score += 5000;
+		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eVirtualGpu) score += 2500;
+		else if (deviceProperties.deviceType == vk::PhysicalDeviceType::eCpu) score += 1000;
+		else score += 500;
 
-		score += deviceProperties.limits.maxComputeWorkGroupInvocations;
-		score += deviceProperties.limits.maxImageDimension2D;
-		score += deviceProperties.limits.maxBoundDescriptorSets;
+		if (capabilities.apiVersion >= VK_API_VERSION_1_3) score += 300;
+		if (capabilities.timelineSemaphore) score += 400;
+		if (capabilities.synchronization2) score += 400;
+		if (capabilities.dynamicRendering) score += 400;
+		if (capabilities.bufferDeviceAddress) score += 400;
+		if (capabilities.descriptorIndexing) score += 400;
+		if (capabilities.memoryPriority) score += 200;
+		if (capabilities.pageableDeviceLocalMemory) score += 200;
+
+		vk::DeviceSize deviceLocalBytes = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+			if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+				deviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+			}
+		}
+		score += std::min<uint64_t>(deviceLocalBytes / (1024ull * 1024ull * 1024ull) * 100, 2400);
 
 		return score;
 	}
@@ -197,7 +344,7 @@ namespace coldwind
 		deviceCreateInfo.ppEnabledLayerNames = nullptr;
 
 		float queuePriority = 1.0f;
-		std::set<uint32_t> uniqueQueueFamilies = { m_graphicsAndComputeQueueFamilyIndex, m_presentQueueFamilyIndex };
+		std::set<uint32_t> uniqueQueueFamilies = { m_graphicsAndComputeQueueFamilyIndex, m_presentQueueFamilyIndex, m_transferQueueFamilyIndex };
 
 		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -210,17 +357,47 @@ namespace coldwind
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-		std::vector<const char*> enableDeviceExtensions = {
-			VK_KHR_SWAPCHAIN_EXTENSION_NAME
-		};
-		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enableDeviceExtensions.size());
-		deviceCreateInfo.ppEnabledExtensionNames = enableDeviceExtensions.data();
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
 
-		vk::PhysicalDeviceFeatures enableDeviceFeatures;
-		enableDeviceFeatures.geometryShader = VK_TRUE;
-		enableDeviceFeatures.tessellationShader = VK_TRUE;
-		enableDeviceFeatures.samplerAnisotropy = VK_TRUE;
-		deviceCreateInfo.pEnabledFeatures = &enableDeviceFeatures;
+		// enable exactly what selectPhysicalDevice() found, through the same chain layout
+		std::set<std::string> enabledExtensions(m_deviceExtensions.begin(), m_deviceExtensions.end());
+		FeatureChain enabledFeatures;
+		enabledFeatures.link(m_capabilities.apiVersion, enabledExtensions);
+		auto& features = enabledFeatures.features.features;
+		features.geometryShader = VK_TRUE;
+		features.tessellationShader = VK_TRUE;
+		features.samplerAnisotropy = m_capabilities.samplerAnisotropy;
+		auto& vulkan12 = enabledFeatures.vulkan12;
+		vulkan12.timelineSemaphore = m_capabilities.timelineSemaphore;
+		vulkan12.bufferDeviceAddress = m_capabilities.bufferDeviceAddress;
+		if (m_capabilities.descriptorIndexing) {
+			vulkan12.descriptorIndexing = VK_TRUE;
+			vulkan12.runtimeDescriptorArray = VK_TRUE;
+			vulkan12.descriptorBindingPartiallyBound = VK_TRUE;
+			vulkan12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			vulkan12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			vulkan12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		}
+		enabledFeatures.timelineSemaphore.timelineSemaphore = m_capabilities.timelineSemaphore;
+		enabledFeatures.bufferDeviceAddress.bufferDeviceAddress = m_capabilities.bufferDeviceAddress;
+		if (m_capabilities.descriptorIndexing) {
+			auto& descriptorIndexing = enabledFeatures.descriptorIndexing;
+			descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+			descriptorIndexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			descriptorIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		}
+		enabledFeatures.vulkan13.synchronization2 = m_capabilities.synchronization2;
+		enabledFeatures.vulkan13.dynamicRendering = m_capabilities.dynamicRendering;
+		enabledFeatures.synchronization2.synchronization2 = m_capabilities.synchronization2;
+		enabledFeatures.dynamicRendering.dynamicRendering = m_capabilities.dynamicRendering;
+		enabledFeatures.memoryPriority.memoryPriority = m_capabilities.memoryPriority;
+		enabledFeatures.pageableDeviceLocalMemory.pageableDeviceLocalMemory = m_capabilities.pageableDeviceLocalMemory;
+		// the features live in the chain, pEnabledFeatures must stay null
+		deviceCreateInfo.pNext = &enabledFeatures.features;
+		deviceCreateInfo.pEnabledFeatures = nullptr;
 
 		auto [result, device] = m_physicalDevice.createDeviceUnique(deviceCreateInfo);
 		if (result != vk::Result::eSuccess) {
@@ -234,13 +411,34 @@ namespace coldwind
 
 		m_graphicsAndComputeQueue = m_device->getQueue(m_graphicsAndComputeQueueFamilyIndex, 0);
 		m_presentQueue = m_device->getQueue(m_presentQueueFamilyIndex, 0);
+		m_transferQueue = m_device->getQueue(m_transferQueueFamilyIndex, 0);
+
+		// the loader only exports core commands, 1.1 devices provide the KHR one
+		if (m_capabilities.timelineSemaphore) {
+			const char* name = m_capabilities.apiVersion >= VK_API_VERSION_1_2 ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR";
+			m_getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(m_device->getProcAddr(name));
+		}
+	}
+
+	uint64_t VKContext::getSemaphoreCounterValue(vk::Semaphore semaphore) const
+	{
+		uint64_t value = 0;
+		const auto result = m_getSemaphoreCounterValue != nullptr ?
+			vk::Result(m_getSemaphoreCounterValue(m_device.get(), semaphore, &value)) : vk::Result::eErrorFeatureNotPresent;
+		if (result != vk::Result::eSuccess) {
+			spdlog::error("Failed to read timeline semaphore value! Error code: {}", vk::to_string(result));
+			throw std::runtime_error("Failed to read timeline semaphore value!");
+		}
+		return value;
 	}
 
 	inline void VKContext::initVmaAllocator(Instance& instance)
 	{
 		VmaAllocatorCreateInfo vmaAllocatorCreateInfo{};
-		vmaAllocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
-		vmaAllocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+		if (m_capabilities.memoryBudget) vmaAllocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		if (m_capabilities.memoryPriority) vmaAllocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT;
+		if (m_capabilities.bufferDeviceAddress) vmaAllocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+		vmaAllocatorCreateInfo.vulkanApiVersion = m_capabilities.apiVersion;
 		vmaAllocatorCreateInfo.physicalDevice = m_physicalDevice;
 		vmaAllocatorCreateInfo.device = m_device.get();
 		vmaAllocatorCreateInfo.instance = instance.getVKInstance().get();
@@ -253,5 +451,39 @@ namespace coldwind
 			throw std::runtime_error("Failed to create vma allocator!");
 		}
 	}
+
+	vk::DeviceSize VKContext::getDeviceLocalBudget() const noexcept
+	{
+		const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+		vmaGetMemoryProperties(m_vmaAllocator, &memoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(m_vmaAllocator, budgets);
+
+		vk::DeviceSize budget = 0;
+		for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+			if (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				budget += budgets[i].budget;
+			}
+		}
+		return budget;
+	}
+
+	vk::DeviceSize VKContext::getDeviceLocalUsage() const noexcept
+	{
+		const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+		vmaGetMemoryProperties(m_vmaAllocator, &memoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(m_vmaAllocator, budgets);
+
+		vk::DeviceSize usage = 0;
+		for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+			if (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				usage += budgets[i].usage;
+			}
+		}
+		return usage;
+	}
 }
 
@@ -8,6 +8,11 @@
 #include <GLFW/glfw3native.h>
 
 namespace coldwind {
+	namespace {
+		// GLFW is shared by every window, initialized with the first and terminated with the last
+		uint32_t g_windowCount = 0;
+	}
+
 	Window::Window(Instance& instance, uint32_t width, uint32_t height, const std::string& title)
         : m_title(title)
     { 
@@ -22,21 +27,24 @@ namespace coldwind {
 
 	vk::Extent2D Window::getWindowExtent2D() const noexcept
 	{
-		int width, height;
-		glfwGetFramebufferSize(m_window, &width, &height);
-		return vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		const uint64_t extent = m_framebufferExtent.load(std::memory_order_acquire);
+		return vk::Extent2D(static_cast<uint32_t>(extent >> 32), static_cast<uint32_t>(extent));
 	}
 
 	bool Window::isMinimized() const noexcept
 	{
-		int width, height;
-		glfwGetFramebufferSize(m_window, &width, &height);
-		return width == 0 || height == 0;
+		const vk::Extent2D extent = getWindowExtent2D();
+		return extent.width == 0 || extent.height == 0;
+	}
+
+	void Window::setFramebufferExtent(uint32_t width, uint32_t height) noexcept
+	{
+		m_framebufferExtent.store(static_cast<uint64_t>(width) << 32 | height, std::memory_order_release);
 	}
 
 	void Window::initWindow(uint32_t width, uint32_t height)
 	{
-		if (glfwInit() != GLFW_TRUE) {
+		if (g_windowCount == 0 && glfwInit() != GLFW_TRUE) {
 			const char* errorDescription;
 			glfwGetError(&errorDescription);
 			spdlog::error("Failed to init GLFW! Error: {}", errorDescription ? errorDescription : "Unknown error");
@@ -50,18 +58,24 @@ namespace coldwind {
 			const char* errorDescription;
 			glfwGetError(&errorDescription);
 			spdlog::error("Failed to create window! Error: {}", errorDescription ? errorDescription : "Unknown error");
+			if (g_windowCount == 0) glfwTerminate();
 			throw std::runtime_error("Failed to create window!");
 		}
 		else {
+			++g_windowCount;
 			spdlog::debug("Succeed to create window!");
 		}
+
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(m_window, &framebufferWidth, &framebufferHeight);
+		setFramebufferExtent(static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight));
 	}
 
 	void Window::destroyWindow()
 	{
 		glfwDestroyWindow(m_window);
 		m_window = nullptr;
-		glfwTerminate();
+		if (--g_windowCount == 0) glfwTerminate();
 
 		spdlog::debug("Succeed to destroy window!");
 	}
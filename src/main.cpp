@@ -1,9 +1,21 @@
 ﻿#include "ColdWindEngine.h"
 
+#include <string>
+
 int main(int argc, char** argv)
 {
 	try {
 		coldwind::ColdWindEngine app("Hello", 800, 600);
+		// --capture <path> [frames] writes the first frames for ColdWindCaptureReplay
+		if (argc >= 3 && std::string(argv[1]) == "--capture") {
+			app.captureFrames(argv[2], argc >= 4 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1);
+		}
+		// --record <path> records the main window, e.g. to recording.mp4 or an rtmp:// URL
+		if (argc >= 3 && std::string(argv[1]) == "--record") {
+			coldwind::RecordingSettings settings;
+			settings.path = argv[2];
+			app.startRecording(settings);
+		}
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -0,0 +1,201 @@
+#include "Bvh.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+/// Measures BVH build, refit and query times against a linear scan over the same boxes
+/// and checks that both return the same objects.
+///
+/// usage: ColdWindBvhBenchmark [--objects N] [--threads N]
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double getMilliseconds(Clock::time_point begin)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+	}
+
+	coldwind::Aabb makeBox(std::mt19937& random, float worldSize)
+	{
+		std::uniform_real_distribution<float> position(-worldSize, worldSize);
+		std::uniform_real_distribution<float> size(0.1f, 2.0f);
+		const glm::vec4 center(position(random), position(random) * 0.1f, position(random), 0.0f);
+		const glm::vec4 extent(size(random), size(random), size(random), 0.0f);
+		return coldwind::Aabb{ center - extent, center + extent };
+	}
+
+	bool isOutside(const coldwind::Frustum& frustum, const coldwind::Aabb& bounds)
+	{
+		for (const auto& plane : frustum.planes) {
+			const float x = plane.x >= 0.0f ? bounds.max.x : bounds.min.x;
+			const float y = plane.y >= 0.0f ? bounds.max.y : bounds.min.y;
+			const float z = plane.z >= 0.0f ? bounds.max.z : bounds.min.z;
+			if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) return true;
+		}
+		return false;
+	}
+
+	bool isSameSet(std::vector<uint32_t> a, std::vector<uint32_t> b)
+	{
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		return a == b;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t objectCount = 500000;
+	uint32_t threadCount = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const std::string argument = argv[i];
+		if (argument == "--objects") objectCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+		else if (argument == "--threads") threadCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+	}
+
+	constexpr float WORLD_SIZE = 2000.0f;
+	constexpr uint32_t QUERY_COUNT = 64;
+
+	coldwind::JobSystem jobSystem(threadCount);
+	std::mt19937 random(42);
+	std::vector<coldwind::Aabb> boxes(objectCount);
+	for (auto& box : boxes) box = makeBox(random, WORLD_SIZE);
+
+	coldwind::Bvh bvh;
+	auto begin = Clock::now();
+	bvh.build(boxes, jobSystem);
+	spdlog::info("Built {} objects into {} nodes in {:.2f} ms, {} worker threads + caller",
+		objectCount, bvh.getNodeCount(), getMilliseconds(begin), jobSystem.getThreadCount());
+
+	bool isValid = true;
+	std::vector<uint32_t> result;
+	std::vector<uint32_t> expected;
+	std::uniform_real_distribution<float> position(-WORLD_SIZE, WORLD_SIZE);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// frustum culling
+	std::vector<coldwind::Frustum> frustums(QUERY_COUNT);
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	for (auto& frustum : frustums) {
+		const glm::vec3 eye(position(random), 10.0f, position(random));
+		const glm::vec3 target = eye + glm::vec3(unit(random), unit(random) * 0.2f, unit(random));
+		frustum = coldwind::Frustum::fromViewProjection(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+	double bvhTime = 0.0;
+	double linearTime = 0.0;
+	size_t visible = 0;
+	for (const auto& frustum : frustums) {
+		result.clear();
+		begin = Clock::now();
+		bvh.cullFrustum(frustum, result);
+		bvhTime += getMilliseconds(begin);
+
+		expected.clear();
+		begin = Clock::now();
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			if (!isOutside(frustum, boxes[i])) expected.push_back(i);
+		}
+		linearTime += getMilliseconds(begin);
+		visible += result.size();
+		isValid &= isSameSet(result, expected);
+	}
+	spdlog::info("Frustum cull: {:.3f} ms bvh, {:.3f} ms linear, {} visible on average",
+		bvhTime / QUERY_COUNT, linearTime / QUERY_COUNT, visible / QUERY_COUNT);
+
+	// sphere queries
+	bvhTime = 0.0;
+	linearTime = 0.0;
+	for (uint32_t query = 0; query < QUERY_COUNT; ++query) {
+		const glm::vec3 center(position(random), 0.0f, position(random));
+		const float radius = 50.0f;
+		result.clear();
+		begin = Clock::now();
+		bvh.querySphere(center, radius, result);
+		bvhTime += getMilliseconds(begin);
+
+		expected.clear();
+		begin = Clock::now();
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			const glm::vec4 closest = glm::max(boxes[i].min, glm::min(glm::vec4(center, 0.0f), boxes[i].max));
+			const glm::vec3 offset = glm::vec3(closest) - center;
+			if (glm::dot(offset, offset) <= radius * radius) expected.push_back(i);
+		}
+		linearTime += getMilliseconds(begin);
+		isValid &= isSameSet(result, expected);
+	}
+	spdlog::info("Sphere query: {:.3f} ms bvh, {:.3f} ms linear", bvhTime / QUERY_COUNT, linearTime / QUERY_COUNT);
+
+	// ray casts
+	bvhTime = 0.0;
+	linearTime = 0.0;
+	for (uint32_t query = 0; query < QUERY_COUNT; ++query) {
+		coldwind::Ray ray;
+		ray.origin = glm::vec3(position(random), 0.0f, position(random));
+		ray.direction = glm::normalize(glm::vec3(unit(random), unit(random) * 0.05f, unit(random)));
+		begin = Clock::now();
+		const coldwind::RayHit hit = bvh.raycast(ray, 1.0e6f);
+		bvhTime += getMilliseconds(begin);
+
+		begin = Clock::now();
+		float closest = 1.0e6f;
+		const glm::vec3 inverseDirection = 1.0f / ray.direction;
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			float tMin = 0.0f;
+			float tMax = closest;
+			for (int axis = 0; axis < 3; ++axis) {
+				const float t1 = (boxes[i].min[axis] - ray.origin[axis]) * inverseDirection[axis];
+				const float t2 = (boxes[i].max[axis] - ray.origin[axis]) * inverseDirection[axis];
+				tMin = std::max(tMin, std::min(t1, t2));
+				tMax = std::min(tMax, std::max(t1, t2));
+			}
+			if (tMin <= tMax) closest = tMin;
+		}
+		linearTime += getMilliseconds(begin);
+		isValid &= hit.isHit() ? hit.distance == closest : closest == 1.0e6f;
+	}
+	spdlog::info("Ray cast: {:.3f} ms bvh, {:.3f} ms linear", bvhTime / QUERY_COUNT, linearTime / QUERY_COUNT);
+
+	// move a tenth of the objects and refit
+	const uint32_t movedCount = objectCount / 10;
+	begin = Clock::now();
+	for (uint32_t i = 0; i < movedCount; ++i) {
+		const uint32_t object = static_cast<uint32_t>(random() % objectCount);
+		const glm::vec4 offset(unit(random) * 5.0f, 0.0f, unit(random) * 5.0f, 0.0f);
+		boxes[object].min = boxes[object].min + offset;
+		boxes[object].max = boxes[object].max + offset;
+		bvh.updateObject(object, boxes[object]);
+	}
+	bvh.refit();
+	spdlog::info("Refit after moving {} objects in {:.2f} ms", movedCount, getMilliseconds(begin));
+
+	for (uint32_t query = 0; query < QUERY_COUNT; ++query) {
+		coldwind::Aabb bounds = makeBox(random, WORLD_SIZE);
+		bounds.min = bounds.min - glm::vec4(40.0f);
+		bounds.max = bounds.max + glm::vec4(40.0f);
+		result.clear();
+		bvh.queryAabb(bounds, result);
+		expected.clear();
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			if (boxes[i].min.x <= bounds.max.x && boxes[i].max.x >= bounds.min.x &&
+				boxes[i].min.y <= bounds.max.y && boxes[i].max.y >= bounds.min.y &&
+				boxes[i].min.z <= bounds.max.z && boxes[i].max.z >= bounds.min.z) {
+				expected.push_back(i);
+			}
+		}
+		isValid &= isSameSet(result, expected);
+	}
+
+	if (!isValid) {
+		spdlog::error("BVH query results differ from the linear scan!");
+		return EXIT_FAILURE;
+	}
+	spdlog::info("All BVH queries match the linear scan");
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "FrameCapture.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// Replays a frame capture written by the engine in a loop on a headless device and reports GPU time per pass.
+/// Only the command stream is captured, the dynamic resolution upscale and frame recording are not part of the timings.
+/// The best scoring device is used, set VK_DRIVER_FILES (VK_ICD_FILENAMES on older loaders) to pick one,
+/// e.g. the lavapipe ICD on machines without a GPU.
+///
+/// usage: ColdWindCaptureReplay <capture> [--loops N]
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct PassTiming {
+		std::string name;
+		double minMilliseconds = std::numeric_limits<double>::max();
+		double maxMilliseconds = 0.0;
+		double totalMilliseconds = 0.0;
+	};
+
+	// the whole argument must be a number
+	[[nodiscard]] bool parseCount(const char* text, uint32_t& value) noexcept
+	{
+		const char* end = text + std::strlen(text);
+		const auto [last, error] = std::from_chars(text, end, value);
+		return error == std::errc() && last == end;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		spdlog::error("usage: ColdWindCaptureReplay <capture> [--loops N]");
+		return EXIT_FAILURE;
+	}
+	const std::string capturePath = argv[1];
+	uint32_t loopCount = 100;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		const std::string argument = argv[i];
+		if (argument == "--loops" && !parseCount(argv[i + 1], loopCount)) {
+			spdlog::error("usage: ColdWindCaptureReplay <capture> [--loops N]");
+			return EXIT_FAILURE;
+		}
+	}
+	loopCount = std::max(1u, loopCount);
+
+	try {
+		coldwind::Instance instance("ColdWindCaptureReplay", coldwind::InstanceMode::Headless);
+		coldwind::VKContext context(instance);
+		coldwind::ResourceRegistry registry(context);
+		coldwind::CaptureReplayer replayer(context, registry, capturePath);
+		auto& device = context.getDevice();
+
+		// pass timings are laid out frame after frame, two timestamps per pass
+		std::vector<PassTiming> timings;
+		std::vector<uint32_t> firstQueries;
+		for (uint32_t frame = 0; frame < replayer.getFrameCount(); ++frame) {
+			firstQueries.push_back(static_cast<uint32_t>(timings.size() * 2));
+			for (const auto& name : replayer.getFrame(frame).commands.getPassNames()) {
+				timings.push_back(PassTiming{ "frame " + std::to_string(frame) + " " + name });
+			}
+		}
+
+		const auto queueFamilies = context.getPhysicalDevice().getQueueFamilyProperties();
+		const bool hasTimestamps = !timings.empty() && queueFamilies[context.getGraphicQueueFamilyIndex()].timestampValidBits != 0;
+		const double timestampPeriod = context.getPhysicalDevice().getProperties().limits.timestampPeriod;
+		if (!hasTimestamps) spdlog::warn("No GPU timestamps for the capture's passes, only the loop time is measured");
+
+		vk::UniqueQueryPool queryPool;
+		const uint32_t queryCount = static_cast<uint32_t>(timings.size() * 2);
+		if (hasTimestamps) {
+			auto pool = device->createQueryPoolUnique(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, queryCount));
+			if (pool.result != vk::Result::eSuccess) {
+				spdlog::error("Failed to create timestamp query pool! Error code: {}", vk::to_string(pool.result));
+				return EXIT_FAILURE;
+			}
+			queryPool = std::move(pool.value);
+		}
+
+		auto commandPool = device->createCommandPoolUnique(vk::CommandPoolCreateInfo({}, context.getGraphicQueueFamilyIndex()));
+		auto fence = device->createFenceUnique(vk::FenceCreateInfo());
+		if (commandPool.result != vk::Result::eSuccess || fence.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to create replay command pool or fence!");
+			return EXIT_FAILURE;
+		}
+		auto commandBuffers = device->allocateCommandBuffers(
+			vk::CommandBufferAllocateInfo(commandPool.value.get(), vk::CommandBufferLevel::ePrimary, 1));
+		if (commandBuffers.result != vk::Result::eSuccess) {
+			spdlog::error("Failed to allocate replay command buffer! Error code: {}", vk::to_string(commandBuffers.result));
+			return EXIT_FAILURE;
+		}
+		const vk::CommandBuffer commandBuffer = commandBuffers.value[0];
+
+		std::vector<uint64_t> timestamps(queryCount);
+		double minLoopMilliseconds = std::numeric_limits<double>::max();
+		double totalLoopMilliseconds = 0.0;
+		for (uint32_t loop = 0; loop < loopCount; ++loop) {
+			// every loop records again, each frame's buffer writes are copies from the replayer's staging buffer
+			static_cast<void>(device->resetCommandPool(commandPool.value.get()));
+			static_cast<void>(commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)));
+			if (hasTimestamps) commandBuffer.resetQueryPool(queryPool.get(), 0, queryCount);
+			replayer.recordRestoreLayouts(commandBuffer);
+			for (uint32_t frame = 0; frame < replayer.getFrameCount(); ++frame) {
+				replayer.recordFrame(frame, commandBuffer, queryPool.get(), firstQueries[frame], queryCount);
+			}
+			static_cast<void>(commandBuffer.end());
+
+			const auto begin = Clock::now();
+			vk::SubmitInfo submitInfo{};
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			auto result = context.getGraphicsQueue().submit(submitInfo, fence.value.get());
+			if (result == vk::Result::eSuccess) result = device->waitForFences(fence.value.get(), VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) {
+				spdlog::error("Failed to replay capture! Error code: {}", vk::to_string(result));
+				return EXIT_FAILURE;
+			}
+			const double loopMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+			minLoopMilliseconds = std::min(minLoopMilliseconds, loopMilliseconds);
+			totalLoopMilliseconds += loopMilliseconds;
+			static_cast<void>(device->resetFences(fence.value.get()));
+
+			if (!hasTimestamps) continue;
+			result = device->getQueryPoolResults(queryPool.get(), 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+				sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+			if (result != vk::Result::eSuccess) {
+				spdlog::error("Failed to read pass timestamps! Error code: {}", vk::to_string(result));
+				return EXIT_FAILURE;
+			}
+			for (size_t pass = 0; pass < timings.size(); ++pass) {
+				const double milliseconds = static_cast<double>(timestamps[2 * pass + 1] - timestamps[2 * pass]) * timestampPeriod * 1e-6;
+				timings[pass].minMilliseconds = std::min(timings[pass].minMilliseconds, milliseconds);
+				timings[pass].maxMilliseconds = std::max(timings[pass].maxMilliseconds, milliseconds);
+				timings[pass].totalMilliseconds += milliseconds;
+			}
+		}
+
+		spdlog::info("Replayed {} frames {} times, submit to completion min {:.3f} ms, avg {:.3f} ms", replayer.getFrameCount(),
+			loopCount, minLoopMilliseconds, totalLoopMilliseconds / loopCount);
+		if (hasTimestamps) {
+			for (const auto& timing : timings) {
+				spdlog::info("  {:<40} min {:8.3f} ms  avg {:8.3f} ms  max {:8.3f} ms", timing.name, timing.minMilliseconds,
+					timing.totalMilliseconds / loopCount, timing.maxMilliseconds);
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		spdlog::error("Replay failed: {}", e.what());
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
@@ -0,0 +1,276 @@
+#include "Ktx2File.h"
+#include "TextureTranscoder.h"
+
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/// Offline texture baker: decodes any image FFmpeg understands, builds the mip chain
+/// and writes a KTX2 file encoded with the same block kernels the engine uses at load time.
+///
+/// usage: ColdWindTextureBaker <input> <output.ktx2> [--format auto|bc1|bc3|rgba8] [--srgb] [--threads N]
+///        ColdWindTextureBaker --benchmark [--threads N]
+
+namespace {
+	struct Image {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> rgba;
+	};
+
+	// the whole argument must be a number
+	[[nodiscard]] bool parseCount(const char* text, uint32_t& value) noexcept
+	{
+		const char* end = text + std::strlen(text);
+		const auto [last, error] = std::from_chars(text, end, value);
+		return error == std::errc() && last == end;
+	}
+
+	bool decodeImage(const std::string& path, Image& image)
+	{
+		AVFormatContext* formatContext = nullptr;
+		if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) < 0) {
+			spdlog::error("Failed to open image {}!", path);
+			return false;
+		}
+		avformat_find_stream_info(formatContext, nullptr);
+
+		const AVCodec* codec = nullptr;
+		const int streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+		if (streamIndex < 0 || codec == nullptr) {
+			spdlog::error("Image {} has no decodable picture!", path);
+			avformat_close_input(&formatContext);
+			return false;
+		}
+
+		AVCodecContext* codecContext = avcodec_alloc_context3(codec);
+		avcodec_parameters_to_context(codecContext, formatContext->streams[streamIndex]->codecpar);
+		AVPacket* packet = av_packet_alloc();
+		AVFrame* frame = av_frame_alloc();
+
+		bool decoded = false;
+		if (avcodec_open2(codecContext, codec, nullptr) == 0) {
+			while (!decoded && av_read_frame(formatContext, packet) >= 0) {
+				if (packet->stream_index == streamIndex && avcodec_send_packet(codecContext, packet) == 0) {
+					decoded = avcodec_receive_frame(codecContext, frame) == 0;
+				}
+				av_packet_unref(packet);
+			}
+			if (!decoded && avcodec_send_packet(codecContext, nullptr) == 0) {
+				decoded = avcodec_receive_frame(codecContext, frame) == 0;
+			}
+		}
+
+		if (decoded) {
+			image.width = static_cast<uint32_t>(frame->width);
+			image.height = static_cast<uint32_t>(frame->height);
+			image.rgba.resize(static_cast<size_t>(image.width) * image.height * 4);
+
+			SwsContext* swsContext = sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+				frame->width, frame->height, AV_PIX_FMT_RGBA, SWS_POINT, nullptr, nullptr, nullptr);
+			uint8_t* dstData[4] = { image.rgba.data(), nullptr, nullptr, nullptr };
+			int dstLinesize[4] = { static_cast<int>(image.width * 4), 0, 0, 0 };
+			sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, dstData, dstLinesize);
+			sws_freeContext(swsContext);
+		}
+		else {
+			spdlog::error("Failed to decode image {}!", path);
+		}
+
+		av_frame_free(&frame);
+		av_packet_free(&packet);
+		avcodec_free_context(&codecContext);
+		avformat_close_input(&formatContext);
+		return decoded;
+	}
+
+	[[nodiscard]] float srgbToLinear(float value) noexcept
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	[[nodiscard]] uint8_t linearToSrgb(float value) noexcept
+	{
+		const float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(std::clamp(encoded, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	// 2x2 box filter, odd extents repeat the last row/column
+	// sRGB color is averaged in linear space, alpha is always linear
+	Image downsample(const Image& source, bool srgb)
+	{
+		static const std::array<float, 256> toLinear = [] {
+			std::array<float, 256> table{};
+			for (uint32_t i = 0; i < 256; ++i) table[i] = srgbToLinear(static_cast<float>(i) / 255.0f);
+			return table;
+		}();
+
+		Image result;
+		result.width = std::max(1u, source.width / 2);
+		result.height = std::max(1u, source.height / 2);
+		result.rgba.resize(static_cast<size_t>(result.width) * result.height * 4);
+		for (uint32_t y = 0; y < result.height; ++y) {
+			const uint32_t y0 = std::min(y * 2, source.height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+			for (uint32_t x = 0; x < result.width; ++x) {
+				const uint32_t x0 = std::min(x * 2, source.width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+				for (uint32_t channel = 0; channel < 4; ++channel) {
+					const uint8_t texels[4] = {
+						source.rgba[(static_cast<size_t>(y0) * source.width + x0) * 4 + channel],
+						source.rgba[(static_cast<size_t>(y0) * source.width + x1) * 4 + channel],
+						source.rgba[(static_cast<size_t>(y1) * source.width + x0) * 4 + channel],
+						source.rgba[(static_cast<size_t>(y1) * source.width + x1) * 4 + channel],
+					};
+					uint8_t& output = result.rgba[(static_cast<size_t>(y) * result.width + x) * 4 + channel];
+					if (srgb && channel < 3) {
+						const float sum = toLinear[texels[0]] + toLinear[texels[1]] + toLinear[texels[2]] + toLinear[texels[3]];
+						output = linearToSrgb(sum * 0.25f);
+					}
+					else {
+						const uint32_t sum = texels[0] + texels[1] + texels[2] + texels[3];
+						output = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	void runBenchmark(coldwind::JobSystem& jobSystem)
+	{
+		constexpr uint32_t SIZE = 4096;
+		constexpr uint32_t ITERATIONS = 8;
+
+		Image image;
+		image.width = SIZE;
+		image.height = SIZE;
+		image.rgba.resize(static_cast<size_t>(SIZE) * SIZE * 4);
+		std::mt19937 random(42);
+		for (uint32_t y = 0; y < SIZE; ++y) {
+			for (uint32_t x = 0; x < SIZE; ++x) {
+				uint8_t* pixel = &image.rgba[(static_cast<size_t>(y) * SIZE + x) * 4];
+				pixel[0] = static_cast<uint8_t>(x >> 4);
+				pixel[1] = static_cast<uint8_t>(y >> 4);
+				pixel[2] = static_cast<uint8_t>(random() & 0x3F);
+				pixel[3] = static_cast<uint8_t>((x ^ y) & 0xFF);
+			}
+		}
+
+		coldwind::TextureTranscoder transcoder(jobSystem);
+		std::vector<uint8_t> output(coldwind::getMipByteSize(vk::Format::eR8G8B8A8Unorm, SIZE, SIZE));
+		const double megaPixels = static_cast<double>(SIZE) * SIZE * ITERATIONS / 1.0e6;
+
+		const auto measure = [&](vk::Format source, vk::Format target, const uint8_t* input) {
+			const auto begin = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < ITERATIONS; ++i) {
+				static_cast<void>(transcoder.transcode(input, source, output.data(), target, SIZE, SIZE));
+			}
+			const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+			return megaPixels / seconds.count();
+		};
+
+		spdlog::info("Transcode benchmark, {}x{} x{}, {} worker threads + caller", SIZE, SIZE, ITERATIONS, jobSystem.getThreadCount());
+		for (const vk::Format format : { vk::Format::eBc1RgbaUnormBlock, vk::Format::eBc3UnormBlock }) {
+			transcoder.setSimdEnabled(false);
+			const double scalar = measure(vk::Format::eR8G8B8A8Unorm, format, image.rgba.data());
+			transcoder.setSimdEnabled(true);
+			const double simd = measure(vk::Format::eR8G8B8A8Unorm, format, image.rgba.data());
+			spdlog::info("RGBA8 -> {}: scalar {:.1f} MPix/s, {} {:.1f} MPix/s", vk::to_string(format), scalar,
+				transcoder.isSimdEnabled() ? "SSE4.1" : "scalar", simd);
+
+			std::vector<uint8_t> blocks(output.begin(), output.begin() + coldwind::getMipByteSize(format, SIZE, SIZE));
+			const double decode = measure(format, vk::Format::eR8G8B8A8Unorm, blocks.data());
+			spdlog::info("{} -> RGBA8: {:.1f} MPix/s", vk::to_string(format), decode);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string inputPath;
+	std::string outputPath;
+	std::string formatName = "auto";
+	bool srgb = false;
+	bool benchmark = false;
+	uint32_t threadCount = 0;
+
+	bool isValid = true;
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		if (argument == "--format" && i + 1 < argc) formatName = argv[++i];
+		else if (argument == "--threads" && i + 1 < argc) isValid &= parseCount(argv[++i], threadCount);
+		else if (argument == "--srgb") srgb = true;
+		else if (argument == "--benchmark") benchmark = true;
+		else if (inputPath.empty()) inputPath = argument;
+		else outputPath = argument;
+	}
+
+	if (!isValid) {
+		spdlog::error("usage: {} <input> <output.ktx2> [--format auto|bc1|bc3|rgba8] [--srgb] [--threads N] | --benchmark", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	coldwind::JobSystem jobSystem(threadCount);
+	if (benchmark) {
+		runBenchmark(jobSystem);
+		return 0;
+	}
+	if (inputPath.empty() || outputPath.empty()) {
+		spdlog::error("usage: {} <input> <output.ktx2> [--format auto|bc1|bc3|rgba8] [--srgb] [--threads N] | --benchmark", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Image> mips(1);
+	if (!decodeImage(inputPath, mips[0])) return EXIT_FAILURE;
+	while (mips.back().width > 1 || mips.back().height > 1) {
+		mips.push_back(downsample(mips.back(), srgb));
+	}
+
+	const vk::Format sourceFormat = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+	vk::Format targetFormat = sourceFormat;
+	// the loader picks the runtime format of rgba8 files from it, the smallest mip averages cutouts away
+	const bool alpha = coldwind::TextureTranscoder::hasAlpha(mips[0].rgba.data(), mips[0].rgba.size() / 4);
+	if (formatName == "auto") formatName = alpha ? "bc3" : "bc1";
+	if (formatName == "bc1") targetFormat = srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+	else if (formatName == "bc3") targetFormat = srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+	else if (formatName != "rgba8") {
+		spdlog::error("Unknown format {}!", formatName);
+		return EXIT_FAILURE;
+	}
+
+	coldwind::TextureTranscoder transcoder(jobSystem);
+	std::vector<std::vector<uint8_t>> levels(mips.size());
+	const auto begin = std::chrono::steady_clock::now();
+	for (size_t mip = 0; mip < mips.size(); ++mip) {
+		levels[mip].resize(coldwind::getMipByteSize(targetFormat, mips[mip].width, mips[mip].height));
+		if (!transcoder.transcode(mips[mip].rgba.data(), sourceFormat, levels[mip].data(), targetFormat, mips[mip].width, mips[mip].height)) {
+			return EXIT_FAILURE;
+		}
+	}
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+	try {
+		coldwind::Ktx2File::write(outputPath, targetFormat, mips[0].width, mips[0].height, levels, alpha);
+	}
+	catch (const std::exception&) {
+		return EXIT_FAILURE;
+	}
+	spdlog::info("Baked {} ({}x{}, {} mips) to {} as {} in {:.2f} ms", inputPath, mips[0].width, mips[0].height,
+		mips.size(), outputPath, vk::to_string(targetFormat), elapsed.count());
+	return 0;
+}